@@ -0,0 +1,49 @@
+#ifndef BME280_H
+#define BME280_H
+
+#include <Arduino.h>
+
+#define BME280_ADDRESS_PRIMARY 0x76
+#define BME280_ADDRESS_SECONDARY 0x77
+#define BME280_CHIP_ID 0x60
+
+// Oversampling register codes: 0 = skipped, 1..5 = x1, x2, x4, x8, x16
+#define BME280_OVERSAMPLING_SKIP 0
+#define BME280_OVERSAMPLING_X1 1
+#define BME280_OVERSAMPLING_X2 2
+#define BME280_OVERSAMPLING_X4 3
+#define BME280_OVERSAMPLING_X8 4
+#define BME280_OVERSAMPLING_X16 5
+
+// IIR filter register codes: 0 = off, 1..4 = coefficient 2, 4, 8, 16
+#define BME280_FILTER_OFF 0
+#define BME280_FILTER_2 1
+#define BME280_FILTER_4 2
+#define BME280_FILTER_8 3
+#define BME280_FILTER_16 4
+
+// Weather monitoring defaults from the datasheet: x1 everywhere, filter off, forced mode
+#ifndef BME280_OVERSAMPLING_T
+#define BME280_OVERSAMPLING_T BME280_OVERSAMPLING_X1
+#endif
+#ifndef BME280_OVERSAMPLING_P
+#define BME280_OVERSAMPLING_P BME280_OVERSAMPLING_X1
+#endif
+#ifndef BME280_OVERSAMPLING_H
+#define BME280_OVERSAMPLING_H BME280_OVERSAMPLING_X1
+#endif
+#ifndef BME280_FILTER
+#define BME280_FILTER BME280_FILTER_OFF
+#endif
+
+struct BME280Data {
+  float pressure;      // hPa
+  float temperature;   // degC
+  float humidity;      // %RH
+};
+
+// Detects the sensor at 0x76 or 0x77 on the given I2C bus and caches address and calibration
+bool bme280_init(int bus);
+bool bme280_read(int bus, BME280Data* data);
+
+#endif
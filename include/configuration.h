@@ -4,7 +4,11 @@
 
 #include <Arduino.h>  // Include this header for fixed-width integer types
 
-#define CHANNEL_COUNT 16
+// The channel table is sized at runtime: it grows to the highest configured channel
+#ifndef CHANNEL_COUNT_MAX
+#define CHANNEL_COUNT_MAX 128       // largest table, and the range of channel numbers
+#endif
+#define CHANNEL_COUNT_DEFAULT 16    // table of a new or migrated configuration
 
 // size of the SystemConfig struct is 92 bytes.
 struct SystemConfig {
@@ -36,25 +40,82 @@ enum SensorType : uint8_t {
   // geophone - on adc - yes
   // saa - rs232 addressing - no
   // rain gauge - i2c or uart - no
-struct DataCollectionConfig {
+// One channel, packed; the NVS table and every snapshot store these back to back
+struct ChannelConfig {
+  SensorType type;
+  uint8_t pin;             // mux channel, GPIO or ADC pin, depending on the sensor
+  uint8_t bus;             // RS485 bus for Modbus sensors, I2C bus for I2C sensors
+  bool enabled;
+  uint16_t interval;       // seconds between samples
+};
 
-  uint8_t channel_count = CHANNEL_COUNT; // read this byte to process config
-  SensorType type[CHANNEL_COUNT];
-  uint8_t pin[CHANNEL_COUNT];
-  bool enabled[CHANNEL_COUNT];
-  uint16_t interval[CHANNEL_COUNT];
-  uint32_t time[CHANNEL_COUNT];
+struct DataCollectionConfig {
+  uint16_t channel_count;  // records in channels
+  uint16_t enabled_count;  // entries in enabled
+  ChannelConfig* channels;
+  uint16_t* enabled;       // indices of the enabled channels, ascending: what the pollers iterate
+  uint16_t capacity;       // records channels and enabled have room for
+};
 
+// NVS layout ("chtable"): this header, then channelCount records of recordSize bytes.
+// Blobs of the fixed 16-channel struct ("dataconfig") are migrated on the first load.
+#define DATA_CONFIG_VERSION 1
+struct ChannelTableHeader {
+  uint8_t version;
+  uint8_t recordSize;
+  uint16_t channelCount;
 };
+#define DATA_CONFIG_BLOB_MAX (sizeof(ChannelTableHeader) + CHANNEL_COUNT_MAX * sizeof(ChannelConfig))
 
-// Expose structs
+// Header and records of config into buffer; returns the length, 0 if it does not fit
+size_t data_config_serialize(const DataCollectionConfig* config, uint8_t* buffer, size_t size);
+
+// Expose structs. dataConfig is the writers' copy: changed only through transactions
+// (or at boot before data_config_publish()). Its table has room for CHANNEL_COUNT_MAX
+// records and is never reallocated. The acquisition tasks and the sensor drivers only
+// read the snapshots below.
 extern SystemConfig systemConfig;
 extern DataCollectionConfig dataConfig;
 
+// Immutable snapshots of dataConfig for the acquisition tasks, swapped in by each commit.
+// Take one per polling cycle and release it at the end. Neither call blocks, and a commit
+// never waits for readers: superseded snapshots are recycled once they are released.
+const DataCollectionConfig* data_config_acquire();
+void data_config_release(const DataCollectionConfig* config);
+void data_config_publish();       // after changing dataConfig outside a transaction
+
 void load_system_configuration();
 void clear_system_configuration();
-void update_system_configuration(String key, String value);
 void loadDataConfigFromPreferences();
+
+// Configuration transactions: begin() takes a working copy, stage() applies one key to it
+// and validates it, commit() makes the copy live and writes the NVS blob once. After a
+// failed stage the rest are ignored and commit() applies nothing, returning false; it
+// always ends the transaction. Transactions are serialized, so keep them short.
+struct SystemConfigTransaction {
+  SystemConfig working;
+  const char* error;        // first failure, nullptr while none
+  bool wifiChanged;         // reconnect WiFi after the commit
+  bool mqttChanged;         // reinitialize MQTT after the commit
+};
+
+// The working channel table is kept in configuration.cpp; transactions are serialized
+struct DataConfigTransaction {
+  uint16_t channelCount;    // working table size; staging a higher channel grows it
+  const char* error;
+};
+
+void system_config_begin(SystemConfigTransaction* txn);
+bool system_config_stage(SystemConfigTransaction* txn, const String& key, const String& value);
+bool system_config_commit(SystemConfigTransaction* txn);
+
+void data_config_begin(DataConfigTransaction* txn);
+bool data_config_stage(DataConfigTransaction* txn, int channel, const char* key, int value);
+bool data_config_stage_count(DataConfigTransaction* txn, int channelCount);  // grow or shrink the table
+bool data_config_commit(DataConfigTransaction* txn);
+
+// Single-key transactions
+void update_system_configuration(String key, String value);
 void updateDataCollectionConfiguration(int channel, String key, int value);
 
 #endif
\ No newline at end of file
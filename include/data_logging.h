@@ -1,6 +1,8 @@
 #ifndef DATALOGGING_H
 #define DATALOGGING_H
 
+#include <Arduino.h>
+
 enum LogErrorCode {
   LOG_SUCCESS,
   FILE_OPEN_ERROR,
@@ -8,6 +10,14 @@ enum LogErrorCode {
   PAUSED
 };  // Add more error codes as needed
 
+// Samples held while the wall clock is not set yet; the oldest are dropped beyond this
+#ifndef SAMPLE_BACKLOG_LENGTH
+#define SAMPLE_BACKLOG_LENGTH 32
+#endif
+
 void log_data_init();
 
+// Epoch of the channel's last published sample, 0 if none since boot
+uint32_t data_logging_last_logged(int channel);
+
 #endif
\ No newline at end of file
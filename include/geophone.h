@@ -0,0 +1,56 @@
+#ifndef GEOPHONE_H
+#define GEOPHONE_H
+
+#include <Arduino.h>
+#include "spectral.h"
+
+// Continuous geophone acquisition: the built-in ADC1 is clocked by I2S0 and DMA'd into
+// driver buffers, one block per DMA completion lands in an app-side ring, and a
+// processing task hands full blocks to the registered consumers.
+#define GEOPHONE_SAMPLE_RATE 2000       // Hz
+#define GEOPHONE_BLOCK_SAMPLES 512      // samples per DMA buffer and per ring slot
+#define GEOPHONE_DMA_BUFFERS 4          // driver DMA descriptors
+#define GEOPHONE_RING_SLOTS 4           // app ring: one filling, the rest queued for processing
+#define GEOPHONE_MAX_CONSUMERS 4
+#define GEOPHONE_ADC_MIDSCALE 2048      // 12-bit ADC, geophone biased to mid-rail
+
+// Counts to particle velocity: ADC full scale at 11 dB attenuation over the coil sensitivity
+#define GEOPHONE_ADC_FULL_SCALE_V 3.1f
+#define GEOPHONE_SENSITIVITY_V_PER_M_S 28.8f   // typical 4.5 Hz geophone
+#define GEOPHONE_MM_S_PER_COUNT (GEOPHONE_ADC_FULL_SCALE_V / 4096.0f / GEOPHONE_SENSITIVITY_V_PER_M_S * 1000.0f)
+
+// On-device analysis window; a multiple of GEOPHONE_BLOCK_SAMPLES
+#define GEOPHONE_FFT_SIZE 1024
+
+// Both tasks run on the application core, away from the WiFi/LwIP tasks on core 0
+#define GEOPHONE_CORE 1
+#define GEOPHONE_ACQ_PRIORITY 5
+#define GEOPHONE_PROC_PRIORITY 4
+
+struct GeophoneStats {
+  float sampleRate;           // measured over the last second, Hz
+  uint32_t blocks;            // blocks delivered to consumers
+  uint32_t droppedBlocks;     // blocks lost because the ring was full
+  uint32_t dmaOverflows;      // blocks lost inside the I2S driver
+  uint64_t samples;
+};
+
+// Features over the windows analysed since the last call to geophone_take_features()
+struct GeophoneFeatures {
+  float ppv;                 // peak particle velocity, mm/s
+  float dominantFrequency;   // Hz, of the window that held the PPV
+  float bandEnergy[SPECTRAL_OCTAVE_BANDS];  // largest per-window mean square, (mm/s)^2
+  uint32_t windows;
+};
+
+// Called on the processing task with signed samples (midscale removed), in place in the ring.
+// blockUs is esp_timer_get_time() when the block's DMA completed, the end of samples[count - 1].
+typedef void (*GeophoneConsumer)(const int16_t* samples, size_t count, int64_t blockUs, void* context);
+
+// pin must be an ADC1 GPIO (32-39); ADC2 is not usable while WiFi is on
+bool geophone_init(uint8_t pin);
+bool geophone_add_consumer(GeophoneConsumer consumer, void* context);
+void geophone_get_stats(GeophoneStats* stats);
+bool geophone_take_features(GeophoneFeatures* features);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Each I2C bus is owned by a worker task that runs queued jobs one at a time, so a slow
+// device only ever delays its own bus and callers sleep instead of spinning on Wire.
+#define I2C_BUS_COUNT 2
+#define I2C_QUEUE_LENGTH 8
+#define I2C_BUS_FREQUENCY 400000
+
+// Bus 0 - Wire on the default pins, shared with the OLED and the DS1307
+#define I2C_BUS0_SDA 21
+#define I2C_BUS0_SCL 22
+
+// Bus 1 - Wire1, not wired on the standard board; set the pins with build flags to use it
+#ifndef I2C_BUS1_SDA
+#define I2C_BUS1_SDA -1
+#endif
+#ifndef I2C_BUS1_SCL
+#define I2C_BUS1_SCL -1
+#endif
+
+// Runs on the bus worker with exclusive use of the bus; returns success
+typedef bool (*I2CJob)(TwoWire* wire, void* context);
+
+bool i2c_bus_init(int bus);
+
+// Queue a job and sleep until the worker has run it
+bool i2c_bus_run(int bus, I2CJob job, void* context);
+
+// Single-transaction helpers, each one job on the worker
+bool i2c_probe(int bus, uint8_t address);
+bool i2c_write_register(int bus, uint8_t address, uint8_t reg, uint8_t value);
+bool i2c_read_registers(int bus, uint8_t address, uint8_t reg, uint8_t* data, size_t len);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef INCLINOMETER_H
+#define INCLINOMETER_H
+
+#include <Arduino.h>
+
+// ShapeAccelArray (SAA) on an RS232 transceiver. The array answers a poll with one
+// ASCII frame: a header line, then one line per segment, sent as it is sampled:
+//
+//   $SAA,<serial>,<segments>\r\n
+//   <index>,<x>,<y>,<z>,<temperature>\r\n      index 1..segments, x/y/z in g, degC
+//
+// Bytes are parsed as they arrive on the UART event task, straight into a preallocated
+// segment table, so no frame is ever buffered as text.
+#define SAA_UART_NUM 2             // Serial2: RS485 bus 0's UART and pins
+#define SAA_RX_PIN 16
+#define SAA_TX_PIN 17
+#ifndef SAA_BAUD
+#define SAA_BAUD 115200
+#endif
+#define SAA_POLL_COMMAND "$READ\r\n"
+
+#define SAA_MAX_SEGMENTS 128
+#define SAA_MAX_FIELD 16           // longest numeric field
+#define SAA_SEGMENTS_PER_MESSAGE 32  // segments per MQTT message, keeps each payload inside the client buffer
+
+struct SAASegment {
+  float x;             // g
+  float y;             // g
+  float z;             // g
+  float temperature;   // degC
+};
+
+struct SAAFrame {
+  uint32_t serial;
+  uint32_t sequence;          // increments per complete frame
+  uint16_t segmentCount;
+  int64_t completedUs;        // esp_timer_get_time() at the last segment: the frame's acquisition stamp
+  SAASegment segments[SAA_MAX_SEGMENTS];
+};
+
+struct SAAStats {
+  uint32_t frames;            // complete frames
+  uint32_t badFrames;         // dropped on a malformed line, out-of-order segment or truncation
+  uint32_t unreadFrames;      // replaced by a newer frame before anyone took them
+};
+
+bool saa_init();
+
+// Ask the array for a frame; the reply is parsed in the background
+void saa_request_frame();
+
+// Latest complete frame not yet taken, or nullptr. The frame stays valid and unchanged
+// until the next call, while the parser keeps filling another table. A frame not taken
+// waits for the next call (a newer one replaces it).
+const SAAFrame* saa_take_frame();
+
+void saa_get_stats(SAAStats* stats);
+
+#endif
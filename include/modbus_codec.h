@@ -0,0 +1,55 @@
+#ifndef MODBUS_CODEC_H
+#define MODBUS_CODEC_H
+
+// Modbus RTU frame encoding/decoding shared by the RS485 master and the VM501 driver.
+// Plain C/C++ with no Arduino dependency, so it also builds on the host for benchmarks.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Result codes - same values as ModbusMaster so existing log output reads the same
+#define MODBUS_OK 0x00
+#define MODBUS_EX_ILLEGAL_FUNCTION 0x01
+#define MODBUS_EX_ILLEGAL_DATA_ADDRESS 0x02
+#define MODBUS_EX_ILLEGAL_DATA_VALUE 0x03
+#define MODBUS_EX_SLAVE_DEVICE_FAILURE 0x04
+#define MODBUS_ERR_INVALID_SLAVE_ID 0xE0
+#define MODBUS_ERR_INVALID_FUNCTION 0xE1
+#define MODBUS_ERR_RESPONSE_TIMEOUT 0xE2
+#define MODBUS_ERR_INVALID_CRC 0xE3
+
+#define MODBUS_FC_READ_HOLDING_REGISTERS 0x03
+#define MODBUS_FC_READ_INPUT_REGISTERS 0x04
+#define MODBUS_MAX_READ_REGISTERS 125
+
+#define MODBUS_READ_REQUEST_SIZE 8  // slave, function, address, count, crc
+#define MODBUS_EXCEPTION_SIZE 5     // slave, function | 0x80, exception code, crc
+
+// CRC-16/MODBUS (poly 0xA001 reflected, init 0xFFFF), one table lookup per byte
+uint16_t modbus_crc16(const uint8_t* data, size_t len);
+
+// Append the CRC (low byte first) to a frame of len bytes; returns the new length
+size_t modbus_append_crc(uint8_t* frame, size_t len);
+bool modbus_check_crc(const uint8_t* frame, size_t len);
+
+// Read holding/input registers request, MODBUS_READ_REQUEST_SIZE bytes
+size_t modbus_encode_read_request(uint8_t* frame, uint8_t slaveId, uint8_t function,
+                                  uint16_t address, uint16_t count);
+
+// Full length of a response frame once enough of it has arrived, 0 if not known yet
+size_t modbus_response_length(const uint8_t* frame, size_t len);
+
+// Exception responses carry the function code with the high bit set
+bool modbus_is_exception(const uint8_t* frame, size_t len);
+bool modbus_result_is_exception(uint8_t result);
+
+// Check and unpack a complete read response (len as given by modbus_response_length).
+// Returns MODBUS_OK, the device's exception code, or one of the MODBUS_ERR_* codes.
+uint8_t modbus_decode_read_response(const uint8_t* frame, size_t len, uint8_t slaveId,
+                                    uint8_t function, uint16_t count, uint16_t* out);
+
+// Parse whitespace separated hex bytes ("0x01 0x03 00 27 ...") as typed on the console.
+// Returns the number of bytes, or -1 on a malformed token or more than maxLen bytes.
+int modbus_parse_hex_bytes(const char* text, uint8_t* out, size_t maxLen);
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "modbus_codec.h"
+
+// Adaptive response timeout, derived from observed response times
+#define MODBUS_TIMEOUT_INITIAL_MS 1000  // used until the first response is seen
+#define MODBUS_TIMEOUT_MIN_MS 30
+#define MODBUS_TIMEOUT_MAX_MS 2000
+
+// Retry with exponential backoff (timeouts and CRC errors only)
+#define MODBUS_MAX_RETRIES 2
+#define MODBUS_RETRY_BACKOFF_MS 20
+
+// Unsupported-register learning
+#define MODBUS_QUARANTINE_STRIKES 3                          // consecutive failures before quarantine
+#define MODBUS_REPROBE_INITIAL_MS (10UL * 60UL * 1000UL)     // first re-probe after 10 minutes
+#define MODBUS_REPROBE_MAX_MS (24UL * 60UL * 60UL * 1000UL)  // back off to once a day
+
+// RS485 buses: each has its own UART, transceiver and polling task.
+// DE/RE is driven by the UART's RTS line in RS485 half-duplex mode.
+#define RS485_BUS_COUNT 3
+
+// Line speed per bus; every device on a bus must use the same one.
+// Override with e.g. -DRS485_BUS0_BAUD=38400 for devices that support it.
+#ifndef RS485_BUS0_BAUD
+#define RS485_BUS0_BAUD 9600
+#endif
+#ifndef RS485_BUS1_BAUD
+#define RS485_BUS1_BAUD 9600
+#endif
+#ifndef RS485_BUS2_BAUD
+#define RS485_BUS2_BAUD 9600
+#endif
+
+// Bus 0 - Serial2, original wiring shared by the meter and the SRNE inverter
+#define RS485_BUS0_RX 16
+#define RS485_BUS0_TX 17
+#define RS485_BUS0_DE 4
+
+// Bus 1 - Serial1. UART1 is also used by the VM501, so use one or the other
+#define RS485_BUS1_RX 25
+#define RS485_BUS1_TX 26
+#define RS485_BUS1_DE 27
+
+// Bus 2 - UART0 on remapped pins. This takes over the console,
+// so it is only available when built with -DRS485_BUS2_ENABLED
+#define RS485_BUS2_RX 32
+#define RS485_BUS2_TX 33
+#define RS485_BUS2_DE 14
+
+// Asynchronous master: requests are queued per bus and run back to back by an engine task
+// woken by UART RX events and a one-shot timer (response timeout / 3.5 character silence)
+#define MODBUS_QUEUE_LENGTH 64
+#define MODBUS_RX_TIMEOUT_SYMBOLS 2  // UART RX idle time before buffered bytes are delivered
+#define MODBUS_MAX_FRAME 256
+
+struct ModbusRequest;
+typedef void (*ModbusCallback)(ModbusRequest* request);
+
+struct ModbusRequest {
+  uint8_t slaveId;
+  uint8_t function;
+  uint16_t address;
+  uint16_t count;
+  uint16_t* out;                // count registers, written on success
+
+  // Completion: callback runs on the engine task, then notifyTask gets a task notification
+  ModbusCallback onComplete;
+  TaskHandle_t notifyTask;
+  void* context;
+
+  // Filled in by the engine
+  uint8_t result;
+  uint32_t responseTimeUs;
+};
+
+enum ModbusEngineState : uint8_t {
+  MODBUS_IDLE,
+  MODBUS_GUARD,          // waiting out the inter-frame silence before transmitting
+  MODBUS_WAIT_RESPONSE,
+};
+
+// One RS485 bus driven by a HardwareSerial
+struct ModbusPort {
+  HardwareSerial* serial;
+  uart_port_t uartNum;
+  int8_t rePin;                 // RTS, switched by the UART around each frame
+  uint32_t baud;
+  bool initialized;
+
+  // Engine
+  QueueHandle_t queue;
+  TaskHandle_t engineTask;
+  esp_timer_handle_t timer;
+  ModbusEngineState state;
+  ModbusRequest* current;
+  uint8_t rxBuf[MODBUS_MAX_FRAME];
+  size_t rxLen;
+  int64_t responseStartUs;      // end of our request on the wire
+  int64_t lastActivityUs;       // end of the last frame seen on the bus
+  int64_t timerDeadlineUs;
+  uint32_t t35_us;              // 3.5 character inter-frame silence
+
+  // Response time estimator (Jacobson/Karels, microseconds)
+  uint32_t srtt_us;
+  uint32_t rttvar_us;
+  uint32_t timeout_ms;
+
+  // Statistics
+  uint32_t transactions;
+  uint32_t timeouts;
+  uint32_t crcErrors;
+  uint32_t exceptions;
+};
+
+// Per-register learning state, one per polled register
+struct ModbusRegisterHealth {
+  uint8_t strikes;             // consecutive failures
+  uint8_t lastResult;
+  bool quarantined;
+  uint32_t reprobeIntervalMs;
+  unsigned long nextProbeMs;
+};
+
+extern ModbusPort rs485Buses[RS485_BUS_COUNT];
+
+bool rs485_bus_available(int bus);
+ModbusPort* rs485_bus_init(int bus);  // nullptr if the bus is not available
+bool modbus_baud_supported(uint32_t baud);
+void modbus_port_init(ModbusPort* port, HardwareSerial* serial, uart_port_t uartNum, uint32_t baud,
+                      int8_t rxPin, int8_t txPin, int8_t rePin);
+
+// Queue a request without waiting; false if the bus is not initialized or the queue is full
+bool modbus_submit(ModbusPort* port, ModbusRequest* request);
+
+// Run a batch of requests back to back and block the calling task (not the CPU) until all
+// of them completed. Any onComplete/notifyTask set on the requests is replaced.
+void modbus_transact(ModbusPort* port, ModbusRequest* requests, size_t count);
+
+// Single transaction, no retries
+uint8_t modbus_read_holding_registers(ModbusPort* port, uint8_t slaveId, uint16_t address,
+                                      uint16_t count, uint16_t* out);
+
+// Batch of reads with retry/backoff; when health is given (one per request), quarantined
+// registers are skipped (result set to their last error) and results feed the
+// unsupported-register learning. deviceAlive tells whether the slave has answered anything
+// recently, so that a powered-off device does not get all of its registers quarantined.
+// The first request goes out alone as a probe; if it times out the rest are skipped. On a
+// device that was alive, a silent probe is charged to its register and the next one probes.
+// deviceAlive is updated from the probes.
+void modbus_read_batch(ModbusPort* port, ModbusRequest* requests, ModbusRegisterHealth* health,
+                       size_t count, bool* deviceAlive);
+
+// Single read through modbus_read_batch
+uint8_t modbus_read_holding_registers_retry(ModbusPort* port, uint8_t slaveId, uint16_t address,
+                                            uint16_t count, uint16_t* out,
+                                            ModbusRegisterHealth* health, bool deviceAlive);
+
+bool modbus_register_should_poll(const ModbusRegisterHealth* health);
+void modbus_register_record(ModbusRegisterHealth* health, uint8_t result, bool deviceAlive);
+
+#endif
@@ -1,3 +1,7 @@
+struct SensorDriver;
+struct SensorSample;
+struct TriggerEvent;
+
 void mqtt_initialize();
 void mqtt_reinit();
 void mqtt_reconnect();
@@ -7,5 +11,8 @@ int mqtt_process_file(const char* filename);
 bool mqtt_process_folder(String folderPath, String extension);
 void publish_system_status();
 bool publish_sensor_data(int channel, const char* sensorType, float value, const char* timestamp, const char* unit = "");
-bool publish_srne_inverter_data(int channel, const char* timestamp);
-bool publish_single_phase_meter_data(int channel, const char* timestamp);
\ No newline at end of file
+bool publish_sensor_sample(int channel, const SensorDriver* driver, const SensorSample* sample);
+bool publish_inclinometer_data(int channel);
+bool publish_trigger_event(const TriggerEvent* event);
+bool safe_mqtt_publish(const char* topic, const char* payload);
+bool safe_mqtt_publish_binary(const char* topic, const uint8_t* payload, size_t length);
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef RAIN_GAUGE_H
+#define RAIN_GAUGE_H
+
+#include <Arduino.h>
+
+// Tipping-bucket rain gauges counted by the PCNT peripheral: tips never reach the CPU,
+// only a counter overflow (every RAIN_PCNT_LIMIT tips) raises an interrupt.
+#define RAIN_GAUGE_MAX 8                // one PCNT unit per gauge
+#define RAIN_PCNT_LIMIT 32767           // counter wraps to 0 here
+#define RAIN_MM_PER_TIP 0.2f
+
+// PCNT glitch filter in APB cycles (max 1023 = 12.8 us). This rejects spikes, not reed
+// contact bounce; gauges with a bare reed switch still need an RC debounce on the input.
+#define RAIN_PCNT_FILTER 1023
+
+struct RainGaugeReading {
+  uint32_t tips;          // since the previous read
+  float rainfall;         // mm since the previous read
+  float total;            // mm since the total was last cleared, kept across reboots
+};
+
+bool rain_gauge_init(int channel, uint8_t pin);
+
+// Counts since the previous call; no tip is lost between reads
+bool rain_gauge_read(int channel, RainGaugeReading* reading);
+
+void rain_gauge_clear_total(int channel);
+
+#endif
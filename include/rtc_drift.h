@@ -0,0 +1,38 @@
+#ifndef RTC_DRIFT_H
+#define RTC_DRIFT_H
+
+#include <Arduino.h>
+
+// DS1307 drift model. The RTC is set at a reference time and left running; at each
+// later NTP or LoRa time sync its error over the elapsed time gives a rate in ppm,
+// averaged over successive windows and kept in NVS. Reading the RTC while offline
+// removes the accumulated drift: true elapsed = RTC elapsed / (1 + ppm).
+
+#ifndef RTC_DRIFT_MIN_WINDOW_S
+#define RTC_DRIFT_MIN_WINDOW_S 21600     // shortest run between estimates: 0.1 ppm at 2 ms read error
+#endif
+#define RTC_DRIFT_MAX_PPM 500            // beyond any 32 kHz crystal: the RTC was reset or stopped
+#define RTC_DRIFT_SLACK_US 2000000       // allowed disagreement with the model before a forced re-set
+#define RTC_DRIFT_WEIGHT 4               // each new estimate moves the average by 1/4
+
+struct RtcDriftState {
+  bool referenced;             // the RTC was set by this model and has not been disturbed since
+  int64_t setAtUs;             // true wall time, in microseconds, at which the RTC was set
+  float ppm;                   // RTC rate error, positive when it runs fast
+  uint16_t estimates;          // windows averaged into ppm; 0: rate not known yet
+};
+
+void rtc_drift_load();
+void rtc_drift_get(RtcDriftState* state);
+
+// True wall time for an RTC reading, both in microseconds since the epoch
+int64_t rtc_drift_compensate(int64_t rtcUs);
+
+// An RTC reading against true time, from a sync. Updates the estimate once the window
+// is long enough; returns true when the RTC should now be set to true time.
+bool rtc_drift_observe(int64_t rtcUs, int64_t trueUs);
+
+// The RTC was just set to trueUs; starts the next window
+void rtc_drift_reference(int64_t trueUs);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SENSOR_DRIVER_H
+#define SENSOR_DRIVER_H
+
+#include <Arduino.h>
+#include "configuration.h"
+
+// Sensor drivers: everything the logging tasks need to know about a sensor family.
+// The registry in sensor_drivers.cpp maps each SensorType to its driver, so scheduling,
+// batching and encoding in data_logging.cpp stay generic.
+
+#define SENSOR_MAX_POINTS 48   // largest point schema (SRNE inverter)
+#define SENSOR_BATCH_MAX 16    // channels per readBatch() call; more due channels take several
+
+// Which task polls the channel
+enum SensorAffinity : uint8_t {
+  SENSOR_AFFINITY_LOCAL,   // logDataTask
+  SENSOR_AFFINITY_RS485,   // the task of RS485 bus ChannelConfig::bus
+};
+
+// One published value: its name and unit; the value comes from SensorSample at the same index
+struct SensorPoint {
+  const char* name;
+  const char* unit;
+};
+
+struct SensorSample {
+  float values[SENSOR_MAX_POINTS];
+  int count;                 // 0 when the read failed
+  int64_t acquiredUs;        // esp_timer_get_time() at the read; wall time is resolved at encode
+};
+
+struct SensorDriver {
+  const char* name;          // sensorType in payloads
+  SensorAffinity affinity;
+  uint8_t rs485Conflicts;    // bit n: shares pins or UART with RS485 bus n
+  uint16_t costMs;           // estimated time of one read, for load estimates
+  const SensorPoint* points;
+  int pointCount;
+
+  // Each call gets the channel's record from the snapshot its task polls with, never
+  // the live dataConfig, so a commit cannot move a channel under a running read.
+
+  // Called once per enabled channel at startup; false leaves the channel unpolled
+  bool (*init)(int channel, const ChannelConfig* config);
+
+  // Fill sample->values in point order
+  bool (*read)(int channel, const ChannelConfig* config, SensorSample* sample);
+
+  // Optional: read up to SENSOR_BATCH_MAX due channels in one pass; returns the number read successfully
+  size_t (*readBatch)(const int* channels, const ChannelConfig* const* configs, size_t count, SensorSample* samples);
+
+  // Optional: publishes directly, for data that does not fit a flat point schema, stamped
+  // with its own acquisition time. Only called once the wall clock is set; until then the
+  // driver holds its latest acquisition.
+  bool (*publish)(int channel, const ChannelConfig* config);
+};
+
+// nullptr for Unknown and for types without a driver
+const SensorDriver* sensor_driver(SensorType type);
+
+#endif
@@ -2,16 +2,10 @@
 #define SINGLE_PHASE_METER_H
 
 #include <Arduino.h>
-#include <ModbusMaster.h>
-
-// Pin Definitions for RS485
-#define RXD2 16
-#define TXD2 17
-#define RE_DE 4
+#include "modbus_rtu.h"
 
 // Modbus Configuration
 #define MODBUS_SLAVE_ID 1
-#define MODBUS_BAUD_RATE 9600
 
 // Register addresses (Holding Registers)
 #define SINGLE_PHASE_REG_VOLTAGE 0x000B
@@ -27,15 +21,13 @@ struct SinglePhaseMeterData {
 };
 
 // Function declarations
-void single_phase_meter_init();
-float read_voltage_register();    // Read voltage register (multiplier: 0.1)
-float read_current_register();   // Read current register (multiplier: 0.1)
-float read_frequency_register(); // Read frequency register (multiplier: 0.01)
+void single_phase_meter_init(int bus = 0);
+float read_voltage_register(int bus = 0);    // Read voltage register (multiplier: 0.1)
+float read_current_register(int bus = 0);   // Read current register (multiplier: 0.1)
+float read_frequency_register(int bus = 0); // Read frequency register (multiplier: 0.01)
 float read_voltage_from_meter();  // Legacy function for backward compatibility
-bool read_single_phase_meter_data(SinglePhaseMeterData* data);
-bool is_meter_connected();
-
-extern ModbusMaster modbusNode;
+bool read_single_phase_meter_data(int bus, SinglePhaseMeterData* data);
+bool is_meter_connected(int bus = 0);
 
 #endif
 
@@ -0,0 +1,32 @@
+#ifndef SPECTRAL_H
+#define SPECTRAL_H
+
+// Windowed FFT feature extraction for high-rate channels (geophone).
+// Uses the esp-dsp radix-2 kernels on the ESP32 and a portable FFT elsewhere,
+// so the same code runs in the host benchmark.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SPECTRAL_MAX_FFT 2048          // largest window, power of two (sizes the static buffers)
+#define SPECTRAL_OCTAVE_BANDS 10       // 1 Hz .. 500 Hz nominal centre frequencies
+
+struct SpectralFeatures {
+  float peak;                          // largest |x| in the window, input units
+  float dominantFrequency;             // Hz, interpolated between FFT bins
+  float bandEnergy[SPECTRAL_OCTAVE_BANDS];  // mean-square per octave band, input units squared
+};
+
+extern const float spectralOctaveCentres[SPECTRAL_OCTAVE_BANDS];
+
+// Prepare twiddles and the Hann window for windows of n samples (power of two, <= SPECTRAL_MAX_FFT).
+// Not thread safe: one analysis at a time, from one task.
+bool spectral_init(size_t n);
+
+// Analyse one window of n samples (n as passed to spectral_init)
+void spectral_analyze(const float* samples, size_t n, float sampleRate, SpectralFeatures* features);
+
+// Which implementation spectral_analyze() runs on, for logs and benchmarks
+const char* spectral_backend();
+
+#endif
@@ -2,16 +2,10 @@
 #define SRNE_INVERTER_H
 
 #include <Arduino.h>
-#include <ModbusMaster.h>
-
-// Pin Definitions for RS485 (shared with single-phase meter)
-#define RXD2 16
-#define TXD2 17
-#define RE_DE 4
+#include "modbus_rtu.h"
 
 // Modbus Configuration
 #define SRNE_MODBUS_SLAVE_ID 1
-#define SRNE_MODBUS_BAUD_RATE 9600
 
 // Register Addresses (Holding Registers)
 #define SRNE_REG_BATTERY_SOC 0x0100
@@ -111,12 +105,10 @@ struct SRNEInverterData {
 };
 
 // Function declarations
-void srne_inverter_init();
-bool read_srne_inverter_data(SRNEInverterData* data);
-float read_srne_register(uint16_t registerAddress);
-bool is_srne_inverter_connected();
-
-extern ModbusMaster srneModbusNode;
+void srne_inverter_init(int bus = 0);
+bool read_srne_inverter_data(int bus, SRNEInverterData* data);
+float read_srne_register(int bus, uint16_t registerAddress);
+bool is_srne_inverter_connected(int bus = 0);
 
 #endif
 
@@ -0,0 +1,43 @@
+#ifndef TIME_SERVICE_H
+#define TIME_SERVICE_H
+
+#include <Arduino.h>
+
+// NTP time service. A background task queries every configured server at once, keeps
+// the reply with the shortest round trip, and corrects the clock: small offsets are
+// slewed with adjtime() so sample timestamps never run backwards, large ones (and the
+// first sync after boot) are stepped. It resyncs periodically, sooner after a failure.
+
+#ifndef TIME_NTP_SERVERS
+#define TIME_NTP_SERVERS "time.nist.gov", "pool.ntp.org", "time.google.com", "time.windows.com"
+#endif
+#ifndef TIME_NTP_PORT
+#define TIME_NTP_PORT 123
+#endif
+#define TIME_NTP_TIMEOUT_MS 1500         // wait for replies, all servers together
+#ifndef TIME_STEP_THRESHOLD_MS
+#define TIME_STEP_THRESHOLD_MS 500       // larger offsets are stepped, smaller ones slewed
+#endif
+#ifndef TIME_SYNC_INTERVAL_S
+#define TIME_SYNC_INTERVAL_S 3600
+#endif
+#define TIME_SYNC_RETRY_S 15             // first retry after a failure, doubling up to the interval
+
+struct TimeSyncStatus {
+  bool synced;                 // at least one successful sync since boot
+  const char* server;          // server of the last sync
+  int32_t offsetMs;            // correction applied at the last sync
+  uint32_t delayMs;            // its round-trip delay
+  bool stepped;                // the last correction was a step, not a slew
+  int64_t lastSyncUs;          // esp_timer_get_time() of the last sync
+  uint32_t syncs;
+  uint32_t failures;           // rounds in which no server answered
+};
+
+void time_service_start();
+void time_service_get_status(TimeSyncStatus* status);
+
+// Seconds since the last sync, -1 before the first
+long time_service_sync_age();
+
+#endif
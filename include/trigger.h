@@ -0,0 +1,71 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <Arduino.h>
+#include <time.h>
+
+// Event trigger for high-rate channels. Samples stream through a pre-trigger ring;
+// on a trigger the ring plus the following post-trigger samples are frozen into an
+// event record, which a shipping task publishes over MQTT. All buffers are allocated
+// once in trigger_create(), so memory use does not depend on event activity.
+
+#define TRIGGER_EVENT_SLOTS 2           // records in flight per engine; further events are counted as missed
+#define TRIGGER_SHIP_QUEUE_LENGTH 4
+
+enum TriggerMode : uint8_t {
+  TRIGGER_THRESHOLD,   // |x| >= threshold
+  TRIGGER_STA_LTA,     // short-term / long-term average of |x| >= threshold
+  TRIGGER_SLOPE,       // |x[n] - x[n-1]| >= threshold
+};
+
+struct TriggerConfig {
+  TriggerMode mode;
+  float threshold;      // counts for THRESHOLD/SLOPE, ratio for STA_LTA
+  uint16_t staMs;
+  uint16_t ltaMs;
+  uint16_t preMs;       // kept before the trigger sample
+  uint16_t postMs;      // recorded after it
+  uint16_t holdoffMs;   // quiet time after an event before re-arming
+};
+
+// Geophone defaults (blasting): STA/LTA 50 ms / 5 s at 4:1, 0.5 s before to 1.5 s after
+#ifndef GEOPHONE_TRIGGER_RATIO
+#define GEOPHONE_TRIGGER_RATIO 4.0f
+#endif
+#ifndef GEOPHONE_TRIGGER_PRE_MS
+#define GEOPHONE_TRIGGER_PRE_MS 500
+#endif
+#ifndef GEOPHONE_TRIGGER_POST_MS
+#define GEOPHONE_TRIGGER_POST_MS 1500
+#endif
+
+struct TriggerEngine;
+
+struct TriggerEvent {
+  TriggerEngine* engine;
+  uint32_t id;
+  int channel;
+  int64_t triggerUs;       // esp_timer_get_time() of the trigger sample; wall time is resolved when shipped
+  uint32_t sampleRate;
+  TriggerMode mode;
+  float triggerValue;      // sample, ratio or slope that fired
+  int16_t peak;            // largest |x| in the record
+  size_t preSamples;       // samples[preSamples] is the trigger sample
+  size_t count;
+  int16_t* samples;
+};
+
+struct TriggerStats {
+  uint32_t events;
+  uint32_t missed;         // triggers while every record was still being shipped
+};
+
+TriggerEngine* trigger_create(int channel, uint32_t sampleRate, const TriggerConfig* config);
+// blockUs is esp_timer_get_time() at the end of samples[count - 1], e.g. a DMA completion
+void trigger_process(TriggerEngine* engine, const int16_t* samples, size_t count, int64_t blockUs);
+void trigger_get_stats(TriggerEngine* engine, TriggerStats* stats);
+
+// GeophoneConsumer-compatible adapter; context is the TriggerEngine
+void trigger_consumer(const int16_t* samples, size_t count, int64_t blockUs, void* context);
+
+#endif
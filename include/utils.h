@@ -46,9 +46,29 @@ void wifiKeepaliveTask(void *parameter);
 String get_current_time(bool getFilename = false);
 String get_external_rtc_current_time();
 String convertTMtoString(time_t now);
+bool isDST();
+
+/* Timestamps into caller buffers, no String (time_format.cpp) */
+#define TIME_ISO8601_SIZE 26    // 2024-07-01T12:00:00-04:00 and NUL
+#define TIME_FILENAME_SIZE 20   // 2024_07_01_12_00_00 and NUL
+size_t format_iso8601(time_t epoch, char* buffer, size_t size);                      // length, 0 if too small
+bool format_current_time(char* buffer, size_t size, bool getFilename = false);        // false: clock not set
+void time_format_set_zone(int utcOffset);  // TZ and DST cache, both from the TIME_DST_* rule
+
+/* US daylight saving: from the second Sunday in March, 2:00 standard time, to the first
+   Sunday in November, 2:00 daylight time */
+#define TIME_DST_START_MONTH 3
+#define TIME_DST_START_SUNDAY 2
+#define TIME_DST_END_MONTH 11
+#define TIME_DST_END_SUNDAY 1
+#define TIME_DST_HOUR 2
+
+/* Samples are stamped with esp_timer_get_time(); wall time is resolved when they are encoded */
+bool time_wall_valid();                                                   // set by NTP, RTC or LoRa sync
+int64_t time_mono_to_wall_us(int64_t monoUs);                             // with the current offset
+size_t format_mono_iso8601(int64_t monoUs, char* buffer, size_t size);    // 0 and "error." before sync
 void external_rtc_init();
 void external_rtc_sync_ntp();
-void ntp_sync();
 String get_public_ip();
 void spiffs_init();
 void oled_init();
@@ -1,3 +1,87 @@
+#ifndef VIBRATING_WIRE_H
+#define VIBRATING_WIRE_H
+
 #include "utils.h"
+#include "modbus_codec.h"
+
+// VM501 vibrating-wire reader on UART1. GPIO16/17 are also RS485 bus 0's pins and
+// UART1 is RS485 bus 1's UART, so a VM501 rules out both of those buses.
+#define VM501_RX_PIN 16
+#define VM501_TX_PIN 17
+#define VM501_BAUD 9600
+#define VM501_SLAVE_ID 1
+
+// Real-time data block (holding registers), read in one transaction
+#define VM501_REG_DATA_START 0x0000
+#define VM501_REG_DATA_COUNT 10
+#define VM501_OFFSET_FREQUENCY 0     // sensor frequency, 0.1 Hz
+#define VM501_OFFSET_TEMPERATURE 2   // thermistor temperature, signed, 0.1 degC
+#define VM501_FREQUENCY_SCALE 0.1f
+#define VM501_TEMPERATURE_SCALE 0.1f
+
+// Response deadlines; transactions complete as soon as the answer is in, these only bound a silent module
+#define VM501_MODBUS_TIMEOUT_MS 500
+#define VM501_ASCII_TIMEOUT_MS 3000  // $ commands may start a measurement before answering
+#define VM501_MAX_RESPONSE 256
+
+struct VM501Reading {
+  float frequency;     // Hz
+  float temperature;   // degC
+  uint8_t result;      // MODBUS_OK, a device exception or MODBUS_ERR_*
+};
+
+// Runs on the UART event task (or the timer task on a timeout); keep it short
+typedef void (*VM501Callback)(const VM501Reading* reading, void* context);
+
+void vm501_init();
+
+// Start a reading and return immediately; false if the module is busy or not initialized
+bool vm501_read_async(VM501Callback onComplete, void* context);
+
+// Same, but block the calling task (not the CPU) until the answer or the timeout
+bool vm501_read(VM501Reading* reading);
+
+// Send an ASCII command ("$...") and wait for the reply line.
+// Returns the reply length (without the line terminator) or -1 on timeout/busy.
+int vm501_command(const char* command, char* reply, size_t maxLen);
+
+// Send a raw Modbus frame (CRC included) and wait for the complete response.
+// Returns the response length or -1 on timeout/busy.
+int vm501_modbus(const uint8_t* frame, size_t len, uint8_t* reply, size_t maxLen);
+
+// Multiplexed sweep: ChannelConfig::pin is the gauge's mux channel (0-15).
+// The mux select lines reuse RS485 bus 1's pins, which a VM501 rules out anyway.
+#define VW_MUX_S0 25
+#define VW_MUX_S1 26
+#define VW_MUX_S2 27
+#define VW_MUX_S3 13
+#define VW_MUX_EN 15                 // active low
+#define VW_MUX_CHANNELS 16
+
+// The VM501 measures continuously: after switching, allow the analog path to settle,
+// then one full excitation and ring-down before its registers hold the new gauge
+#ifndef VW_MUX_SETTLE_MS
+#define VW_MUX_SETTLE_MS 20
+#endif
+#ifndef VW_EXCITATION_MS
+#define VW_EXCITATION_MS 300
+#endif
+
+struct VWSweepTiming {
+  uint16_t settleMs;
+  uint16_t excitationMs;
+};
+
+void vw_mux_init();
+void vw_mux_select(uint8_t muxChannel);
+void vw_mux_disable();
+
+// Read count gauges in one pass. The readout of each gauge runs while the mux settles on
+// the next one. readings[i] belongs to muxChannels[i]; returns the number of good readings.
+size_t vw_sweep(const uint8_t* muxChannels, size_t count, VM501Reading* readings,
+                const VWSweepTiming* timing = nullptr);
+
+String readVM();
+void sendCommandVM501(void *parameter);
 
-String readVM();
\ No newline at end of file
+#endif
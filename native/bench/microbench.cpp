@@ -0,0 +1,205 @@
+#include "configuration.h"
+#include "modbus_codec.h"
+#include "mqtt_schema.h"
+#include "sensor_driver.h"
+#include "utils.h"
+#include <sys/time.h>
+
+// Micro-benchmarks of the helpers every sample goes through: payload building, time
+// formatting, DST, CRC and topic construction. Builds for the host and for the ESP32:
+//
+//   pio run -e microbench && .pio/build/microbench/program [filter]
+//     ns/op and heap allocations/op (operator new, see hal_heap.h)
+//   pio run -e microbench_esp32 -t upload -t monitor
+//     CPU cycles/op from esp_cpu_get_ccount(), and ns/op at the current CPU frequency
+//
+// generateRandomFloat() is not covered: the Barometric channel was its only caller and
+// it was removed with the BME280 driver.
+
+#ifdef NATIVE_BUILD
+#include "hal_heap.h"
+#include <chrono>
+#else
+#include "esp_cpu.h"
+#endif
+
+#define MICROBENCH_TARGET_US 200000   // measuring time per case
+#define MICROBENCH_FRAME_SIZE 256     // largest Modbus RTU frame
+
+// Keeps results alive so the compiler cannot drop the work
+static volatile uint32_t microbenchSink;
+
+static RegisterDataPoint singlePoint[1];
+static RegisterDataPoint srnePoints[SENSOR_MAX_POINTS];
+static int srnePointCount;
+static uint8_t modbusFrame[MICROBENCH_FRAME_SIZE];
+static time_t sampleEpoch;
+
+/******************************************************************
+ *                                                                *
+ *                            Cases                               *
+ *                                                                *
+ ******************************************************************/
+
+static void bench_json_1_point() {
+  String payload = build_sensor_json_payload(3, "VibratingWire", "2024-07-01T12:00:00-04:00", singlePoint, 1);
+  microbenchSink += payload.length();
+}
+
+static void bench_json_srne() {
+  String payload = build_sensor_json_payload(0, "SRNEInverter", "2024-07-01T12:00:00-04:00", srnePoints,
+                                             srnePointCount);
+  microbenchSink += payload.length();
+}
+
+static void bench_get_current_time() {
+  String timestamp = get_current_time(false);
+  microbenchSink += timestamp.length();
+}
+
+static void bench_convert_tm_to_string() {
+  String timestamp = convertTMtoString(sampleEpoch);
+  microbenchSink += timestamp.length();
+}
+
+static void bench_format_iso8601() {
+  char timestamp[TIME_ISO8601_SIZE];
+  microbenchSink += format_iso8601(sampleEpoch + (microbenchSink & 1023), timestamp, sizeof(timestamp));
+}
+
+static void bench_is_dst() {
+  microbenchSink += isDST() ? 1 : 0;
+}
+
+static void bench_crc_request() {
+  microbenchSink += modbus_crc16(modbusFrame, MODBUS_READ_REQUEST_SIZE - 2);
+}
+
+static void bench_crc_frame() {
+  microbenchSink += modbus_crc16(modbusFrame, MICROBENCH_FRAME_SIZE - 2);
+}
+
+static void bench_topic() {
+  int channel = microbenchSink & 15;
+  String topic = String(systemConfig.DEVICE_NAME) + "/sensor/" + String(channel);
+  microbenchSink += topic.length();
+}
+
+struct MicrobenchCase {
+  const char* name;
+  void (*run)();
+};
+
+static const MicrobenchCase microbenchCases[] = {
+  {"build_sensor_json_payload/1", bench_json_1_point},
+  {"build_sensor_json_payload/srne", bench_json_srne},
+  {"get_current_time", bench_get_current_time},
+  {"convertTMtoString", bench_convert_tm_to_string},
+  {"format_iso8601", bench_format_iso8601},
+  {"isDST", bench_is_dst},
+  {"modbus_crc16/request", bench_crc_request},
+  {"modbus_crc16/256", bench_crc_frame},
+  {"topic String", bench_topic},
+};
+
+/******************************************************************
+ *                                                                *
+ *                            Runner                              *
+ *                                                                *
+ ******************************************************************/
+
+static void microbench_setup() {
+  strncpy(systemConfig.DEVICE_NAME, "logger-01", sizeof(systemConfig.DEVICE_NAME) - 1);
+  systemConfig.utcOffset = -5;
+
+  singlePoint[0] = {"Frequency", 2712.25f, "Hz", "2024-07-01T12:00:00-04:00"};
+  const SensorDriver* srne = sensor_driver(SRNEInverter);
+  srnePointCount = srne->pointCount;
+  for (int i = 0; i < srnePointCount; i++) {
+    srnePoints[i] = {srne->points[i].name, 12.5f + i, srne->points[i].unit, "2024-07-01T12:00:00-04:00"};
+  }
+  for (int i = 0; i < MICROBENCH_FRAME_SIZE; i++) {
+    modbusFrame[i] = (uint8_t)(i * 31 + 7);
+  }
+  sampleEpoch = 1719849600;  // 2024-07-01, inside DST
+}
+
+#ifdef NATIVE_BUILD
+
+static uint64_t microbench_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void microbench_run(const MicrobenchCase* bench) {
+  bench->run();  // warm-up, and first-use allocations out of the count
+  uint64_t iterations = 0;
+  uint64_t allocationsBefore = hal_heap_thread_allocations();
+  uint64_t start = microbench_now_ns();
+  uint64_t elapsed;
+  do {
+    for (int i = 0; i < 64; i++) {
+      bench->run();
+    }
+    iterations += 64;
+    elapsed = microbench_now_ns() - start;
+  } while (elapsed < MICROBENCH_TARGET_US * 1000ULL);
+  uint64_t allocations = hal_heap_thread_allocations() - allocationsBefore;
+  printf("%-32s %10.1f ns/op %8.1f allocs/op\n", bench->name, (double)elapsed / iterations,
+         (double)allocations / iterations);
+}
+
+int main(int argc, char** argv) {
+  const char* filter = argc > 1 ? argv[1] : nullptr;
+  microbench_setup();
+  printf("%-32s %16s %18s\n", "case", "time", "heap");
+  for (const MicrobenchCase& bench : microbenchCases) {
+    if (filter == nullptr || strstr(bench.name, filter) != nullptr) {
+      microbench_run(&bench);
+    }
+  }
+  return 0;
+}
+
+#else
+
+// The cycle counter wraps every 2^32 cycles (18 s at 240 MHz); each batch stays far below
+static void microbench_run(const MicrobenchCase* bench) {
+  bench->run();
+  uint32_t cpuMhz = getCpuFrequencyMhz();
+  uint64_t cycles = 0;
+  uint32_t iterations = 0;
+  int64_t start = esp_timer_get_time();
+  do {
+    uint32_t batchStart = esp_cpu_get_ccount();
+    for (int i = 0; i < 16; i++) {
+      bench->run();
+    }
+    cycles += (uint32_t)(esp_cpu_get_ccount() - batchStart);
+    iterations += 16;
+  } while (esp_timer_get_time() - start < MICROBENCH_TARGET_US);
+  Serial.printf("%-32s %10.0f cycles/op %10.1f ns/op\n", bench->name, (double)cycles / iterations,
+                (double)cycles * 1000.0 / cpuMhz / iterations);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  // No network here: a fixed wall clock so the time helpers take their normal path
+  struct timeval now = {1719849600, 0};
+  settimeofday(&now, NULL);
+
+  microbench_setup();
+  Serial.printf("\n*** Micro-benchmarks at %lu MHz ***\n", (unsigned long)getCpuFrequencyMhz());
+  for (const MicrobenchCase& bench : microbenchCases) {
+    microbench_run(&bench);
+    vTaskDelay(1);  // let the idle task feed the watchdog
+  }
+}
+
+void loop() {
+  vTaskDelay(portMAX_DELAY);
+}
+
+#endif
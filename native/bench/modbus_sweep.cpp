@@ -0,0 +1,136 @@
+#include "srne_inverter.h"
+#include "single_phase_meter.h"
+#include "../sim/modbus_slave.h"
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Polling throughput of the Modbus master against the pty slave simulator: full
+// read_srne_inverter_data() sweeps on RS485 bus 0, optionally with a meter read after
+// each, reporting transactions per second and sweep latency.
+//
+//   pio run -e modbus_sweep && .pio/build/modbus_sweep/program -n 50 -e 0.02 -t 0.01
+
+#define SWEEP_BUS 0
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-n sweeps] [-m] [-b baud] [-l latency-ms] [-j jitter-ms] [-e crc-error-rate]\n"
+          "          [-t timeout-rate] [-x addr,addr,...] [-q addr,addr,...] [-s seed]\n"
+          "  -m  also read the single-phase meter after every sweep\n"
+          "  -b  simulator line pacing (0: none); the master runs at RS485_BUS0_BAUD=%d\n",
+          program, RS485_BUS0_BAUD);
+}
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[index];
+}
+
+int main(int argc, char** argv) {
+  ModbusSlaveConfig config;
+  modbus_slave_default_config(&config);
+  int sweeps = 20;
+  bool withMeter = false;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:mb:l:j:e:t:x:q:s:h")) != -1) {
+    switch (option) {
+      case 'n':
+        sweeps = atoi(optarg);
+        break;
+      case 'm':
+        withMeter = true;
+        break;
+      case 'b':
+        config.baud = (uint32_t)atol(optarg);
+        break;
+      case 'l':
+        config.latencyUs = (uint32_t)(atof(optarg) * 1000);
+        break;
+      case 'j':
+        config.jitterUs = (uint32_t)(atof(optarg) * 1000);
+        break;
+      case 'e':
+        config.crcErrorRate = atof(optarg);
+        break;
+      case 't':
+        config.timeoutRate = atof(optarg);
+        break;
+      case 'x':
+        if (!modbus_slave_parse_addresses(optarg, config.illegal, &config.illegalCount)) {
+          fprintf(stderr, "invalid address list '%s'\n", optarg);
+          return 2;
+        }
+        break;
+      case 'q':
+        if (!modbus_slave_parse_addresses(optarg, config.silent, &config.silentCount)) {
+          fprintf(stderr, "invalid address list '%s'\n", optarg);
+          return 2;
+        }
+        break;
+      case 's':
+        config.seed = (uint32_t)atol(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+
+  static ModbusSlave slave;
+  if (!modbus_slave_open(&slave, &config)) {
+    return 1;
+  }
+  std::thread slaveThread(modbus_slave_run, &slave);
+  setenv("HAL_UART2", slave.slavePath, 1);  // bus 0 is Serial2
+
+  srne_inverter_init(SWEEP_BUS);
+  if (withMeter) {
+    single_phase_meter_init(SWEEP_BUS);
+  }
+  ModbusPort* port = &rs485Buses[SWEEP_BUS];
+
+  std::vector<double> latencies;
+  int good = 0;
+  uint32_t transactionsBefore = port->transactions;
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < sweeps; i++) {
+    int64_t sweepStart = esp_timer_get_time();
+    SRNEInverterData data;
+    bool ok = read_srne_inverter_data(SWEEP_BUS, &data);
+    if (withMeter) {
+      SinglePhaseMeterData meter;
+      ok = read_single_phase_meter_data(SWEEP_BUS, &meter) && ok;
+    }
+    latencies.push_back((esp_timer_get_time() - sweepStart) / 1000.0);
+    good += ok ? 1 : 0;
+  }
+  double elapsed = (esp_timer_get_time() - start) / 1e6;
+  uint32_t transactions = port->transactions - transactionsBefore;
+
+  slave.running = false;
+  slaveThread.join();
+
+  printf("\n*** Modbus sweep: %d sweeps%s, %u baud pacing, %.1f ms turnaround ***\n", sweeps,
+         withMeter ? " + meter" : "", config.baud, config.latencyUs / 1000.0);
+  printf("Sweeps valid:      %d/%d\n", good, sweeps);
+  printf("Transactions:      %u in %.2f s = %.1f/s\n", transactions, elapsed, transactions / elapsed);
+  printf("Sweep latency:     p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", percentile(latencies, 0.50),
+         percentile(latencies, 0.99), percentile(latencies, 1.0));
+  printf("Master:            %lu timeouts, %lu CRC errors, %lu exceptions, timeout now %lu ms\n",
+         (unsigned long)port->timeouts, (unsigned long)port->crcErrors, (unsigned long)port->exceptions,
+         (unsigned long)port->timeout_ms);
+  printf("Slave:             %u requests, %u responses, %u exceptions, %u CRC errors / %u timeouts injected\n",
+         slave.stats.requests.load(), slave.stats.responses.load(), slave.stats.exceptions.load(),
+         slave.stats.crcErrors.load(), slave.stats.timeouts.load());
+  fflush(stdout);
+
+  // The engine task and UART reader never return
+  quick_exit(0);
+}
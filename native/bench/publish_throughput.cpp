@@ -0,0 +1,411 @@
+#include "configuration.h"
+#include "mqtt.h"
+#include "mqtt_schema.h"
+#include "sensor_driver.h"
+#include "utils.h"
+#include "esp_timer.h"
+#include "hal_heap.h"
+#include "hal_mqtt.h"
+#include <algorithm>
+#include <math.h>
+#include <strings.h>
+#include <unistd.h>
+#include <vector>
+
+// End-to-end publish throughput: synthetic channels go through acquisition (values and
+// monotonic stamp), payload encoding (wall-clock timestamp resolved there) and
+// safe_mqtt_publish() into the in-process broker, on producer tasks that share the MQTT
+// mutex the way the RS485 bus tasks do. Reports
+// messages/s, bytes/s, acquisition-to-broker latency and heap allocations per message,
+// for each encoding and batching mode.
+//
+//   pio run -e publish_bench && .pio/build/publish_bench/program -c 16 -d SRNEInverter -b 4
+//
+// Encodings:
+//   json    publish_sensor_sample(), the firmware path; with -b > 1 a JSON array of
+//           build_sensor_json_payload() documents per message
+//   f32le   candidate binary encoding: a 4-byte header (version, channel, points, samples),
+//           then per sample the epoch (uint32) and the values (float32), little-endian
+
+#define BENCH_MAX_CHANNELS CHANNEL_COUNT_MAX
+#define BENCH_MAX_BATCH 64
+#define BENCH_MAX_TASKS 4
+
+enum BenchEncoding {
+  BENCH_JSON,
+  BENCH_F32LE,
+};
+
+struct BenchOptions {
+  int channels;
+  int tasks;
+  int batch;
+  float rate;                  // samples/s per channel; 0: back to back
+  float seconds;
+  BenchEncoding encoding;
+  const SensorDriver* driver;
+};
+
+// One producer task and the channels it owns; the broker sink runs on the same thread
+struct BenchProducer {
+  const BenchOptions* options;
+  int firstChannel;
+  int channelCount;
+
+  // Samples waiting for the next message of each channel
+  SensorSample pending[BENCH_MAX_CHANNELS][BENCH_MAX_BATCH];
+  int pendingCount[BENCH_MAX_CHANNELS];
+  int64_t nextDue[BENCH_MAX_CHANNELS];
+  const SensorSample* publishing;   // the samples of the message being published
+  int publishingCount;
+
+  uint8_t* binary;             // f32le encode buffer, allocated once
+  uint32_t samples;
+  uint32_t messages;
+  uint32_t failed;
+  uint64_t bytes;
+  uint64_t allocations;
+  std::vector<double> latencies;   // us, one per sample
+};
+
+static BenchProducer* producers[BENCH_MAX_TASKS];
+static SemaphoreHandle_t producersDone;
+static thread_local BenchProducer* currentProducer = nullptr;
+
+// Point schema for the synthetic driver
+static SensorPoint syntheticPoints[SENSOR_MAX_POINTS];
+static char syntheticNames[SENSOR_MAX_POINTS][16];
+static SensorDriver syntheticDriver = {"Synthetic", SENSOR_AFFINITY_LOCAL, 0, 0, syntheticPoints, 1};
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-c channels] [-k tasks] [-d type | -p points] [-e json|f32le] [-b batch]\n"
+          "          [-r rate] [-s seconds] [-v]\n"
+          "  -c  synthetic channels (default 16, max %d), spread over -k producer tasks (max %d)\n"
+          "  -d  use the point schema of a sensor type (SinglePhaseMeter, SRNEInverter)\n"
+          "  -p  points per sample of the synthetic schema (default 1, max %d)\n"
+          "  -b  samples per message (default 1, max %d)\n"
+          "  -r  samples per second per channel (default 0: back to back)\n"
+          "  -s  run time in seconds (default 5)\n"
+          "  -v  keep the firmware's Serial log on stdout (default: HAL_UART0=/dev/null)\n",
+          program, BENCH_MAX_CHANNELS, BENCH_MAX_TASKS, SENSOR_MAX_POINTS, BENCH_MAX_BATCH);
+}
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[index];
+}
+
+/******************************************************************
+ *                                                                *
+ *                            Broker                              *
+ *                                                                *
+ ******************************************************************/
+
+// Runs inside publish() on the producer's thread; the status and keepalive tasks have
+// no producer and are not counted
+static void bench_sink(const char* topic, const uint8_t* payload, size_t length, void* context) {
+  BenchProducer* producer = currentProducer;
+  if (producer == nullptr) {
+    return;
+  }
+  int64_t now = esp_timer_get_time();
+  for (int i = 0; i < producer->publishingCount; i++) {
+    producer->latencies.push_back((double)(now - producer->publishing[i].acquiredUs));
+  }
+  producer->messages++;
+  producer->bytes += length;
+}
+
+/******************************************************************
+ *                                                                *
+ *                       Encode and publish                       *
+ *                                                                *
+ ******************************************************************/
+
+static bool publish_json_batch(int channel, const SensorDriver* driver, const SensorSample* samples, int count) {
+  String topic = String(systemConfig.DEVICE_NAME) + "/sensor/" + String(channel);
+  String payload = "[";
+  for (int s = 0; s < count; s++) {
+    char timestamp[TIME_ISO8601_SIZE];
+    format_mono_iso8601(samples[s].acquiredUs, timestamp, sizeof(timestamp));
+    RegisterDataPoint dataPoints[SENSOR_MAX_POINTS];
+    for (int i = 0; i < driver->pointCount; i++) {
+      dataPoints[i] = {driver->points[i].name, samples[s].values[i], driver->points[i].unit, timestamp};
+    }
+    if (s > 0) payload += ",";
+    payload += build_sensor_json_payload(channel, driver->name, timestamp, dataPoints, driver->pointCount);
+  }
+  payload += "]";
+  return safe_mqtt_publish(topic.c_str(), payload.c_str());
+}
+
+static bool publish_f32le(BenchProducer* producer, int channel, const SensorDriver* driver,
+                          const SensorSample* samples, int count) {
+  uint8_t* out = producer->binary;
+  *out++ = 1;
+  *out++ = (uint8_t)channel;
+  *out++ = (uint8_t)driver->pointCount;
+  *out++ = (uint8_t)count;
+  for (int s = 0; s < count; s++) {
+    uint32_t epoch = (uint32_t)(time_mono_to_wall_us(samples[s].acquiredUs) / 1000000);
+    memcpy(out, &epoch, sizeof(epoch));   // host and ESP32 are both little-endian
+    out += sizeof(epoch);
+    memcpy(out, samples[s].values, driver->pointCount * sizeof(float));
+    out += driver->pointCount * sizeof(float);
+  }
+  String topic = String(systemConfig.DEVICE_NAME) + "/sensor/" + String(channel) + "/f32le";
+  return safe_mqtt_publish_binary(topic.c_str(), producer->binary, out - producer->binary);
+}
+
+static void bench_publish(BenchProducer* producer, int channel) {
+  int slot = channel - producer->firstChannel;
+  int count = producer->pendingCount[slot];
+  if (count == 0) {
+    return;
+  }
+  const SensorDriver* driver = producer->options->driver;
+  producer->publishing = producer->pending[slot];
+  producer->publishingCount = count;
+
+  bool ok;
+  if (producer->options->encoding == BENCH_F32LE) {
+    ok = publish_f32le(producer, channel, driver, producer->pending[slot], count);
+  } else if (producer->options->batch == 1) {
+    ok = publish_sensor_sample(channel, driver, &producer->pending[slot][0]);
+  } else {
+    ok = publish_json_batch(channel, driver, producer->pending[slot], count);
+  }
+  producer->failed += ok ? 0 : 1;
+  producer->pendingCount[slot] = 0;
+}
+
+/******************************************************************
+ *                                                                *
+ *                          Acquisition                           *
+ *                                                                *
+ ******************************************************************/
+
+static void bench_acquire(BenchProducer* producer, int channel) {
+  int slot = channel - producer->firstChannel;
+  int index = producer->pendingCount[slot]++;
+  SensorSample* sample = &producer->pending[slot][index];
+  const SensorDriver* driver = producer->options->driver;
+
+  sample->acquiredUs = esp_timer_get_time();
+  float phase = producer->samples * 0.01f;
+  for (int i = 0; i < driver->pointCount; i++) {
+    sample->values[i] = 100.0f * sinf(phase + i) + (esp_random() % 1000) / 1000.0f;
+  }
+  sample->count = driver->pointCount;
+  producer->samples++;
+}
+
+void benchProducerTask(void* parameter) {
+  BenchProducer* producer = (BenchProducer*)parameter;
+  const BenchOptions* options = producer->options;
+  currentProducer = producer;
+  int64_t period = options->rate > 0 ? (int64_t)(1e6f / options->rate) : 0;
+  int64_t start = esp_timer_get_time();
+  int64_t end = start + (int64_t)(options->seconds * 1e6f);
+  for (int slot = 0; slot < producer->channelCount; slot++) {
+    producer->nextDue[slot] = start + period * slot / producer->channelCount;  // staggered
+  }
+
+  while (true) {
+    // Earliest due channel of this task
+    int slot = 0;
+    for (int i = 1; i < producer->channelCount; i++) {
+      if (producer->nextDue[i] < producer->nextDue[slot]) {
+        slot = i;
+      }
+    }
+    int64_t due = producer->nextDue[slot];
+    if (due >= end) {
+      break;
+    }
+    int64_t now = esp_timer_get_time();
+    if (due > now) {
+      usleep((useconds_t)(due - now));
+    }
+    int channel = producer->firstChannel + slot;
+
+    uint64_t allocationsBefore = hal_heap_thread_allocations();
+    bench_acquire(producer, channel);
+    if (producer->pendingCount[slot] >= options->batch) {
+      bench_publish(producer, channel);
+    }
+    producer->allocations += hal_heap_thread_allocations() - allocationsBefore;
+    producer->nextDue[slot] = period > 0 ? due + period : esp_timer_get_time();
+  }
+
+  // Partial batches left at the end are published, not dropped
+  uint64_t allocationsBefore = hal_heap_thread_allocations();
+  for (int slot = 0; slot < producer->channelCount; slot++) {
+    bench_publish(producer, producer->firstChannel + slot);
+  }
+  producer->allocations += hal_heap_thread_allocations() - allocationsBefore;
+
+  xSemaphoreGive(producersDone);
+  vTaskDelete(NULL);
+}
+
+/******************************************************************
+ *                                                                *
+ *                             Main                               *
+ *                                                                *
+ ******************************************************************/
+
+static bool parse_driver(const char* text, const SensorDriver** driver) {
+  static const SensorType types[] = {SinglePhaseMeter, SRNEInverter};
+  for (SensorType type : types) {
+    const SensorDriver* candidate = sensor_driver(type);
+    if (candidate != nullptr && strcasecmp(text, candidate->name) == 0) {
+      *driver = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options = {16, 1, 1, 0, 5, BENCH_JSON, &syntheticDriver};
+  bool verbose = false;
+  int option;
+  while ((option = getopt(argc, argv, "c:k:d:p:e:b:r:s:vh")) != -1) {
+    switch (option) {
+      case 'c':
+        options.channels = atoi(optarg);
+        break;
+      case 'k':
+        options.tasks = atoi(optarg);
+        break;
+      case 'd':
+        if (!parse_driver(optarg, &options.driver)) {
+          fprintf(stderr, "no point schema for '%s'\n", optarg);
+          return 2;
+        }
+        break;
+      case 'p':
+        syntheticDriver.pointCount = atoi(optarg);
+        break;
+      case 'e':
+        if (strcmp(optarg, "json") == 0) {
+          options.encoding = BENCH_JSON;
+        } else if (strcmp(optarg, "f32le") == 0) {
+          options.encoding = BENCH_F32LE;
+        } else {
+          usage(argv[0]);
+          return 2;
+        }
+        break;
+      case 'b':
+        options.batch = atoi(optarg);
+        break;
+      case 'r':
+        options.rate = atof(optarg);
+        break;
+      case 's':
+        options.seconds = atof(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+  if (options.channels < 1 || options.channels > BENCH_MAX_CHANNELS || options.tasks < 1 ||
+      options.tasks > BENCH_MAX_TASKS || options.tasks > options.channels || options.batch < 1 ||
+      options.batch > BENCH_MAX_BATCH || syntheticDriver.pointCount < 1 ||
+      syntheticDriver.pointCount > SENSOR_MAX_POINTS || options.seconds <= 0) {
+    usage(argv[0]);
+    return 2;
+  }
+  for (int i = 0; i < SENSOR_MAX_POINTS; i++) {
+    snprintf(syntheticNames[i], sizeof(syntheticNames[i]), "Point %d", i);
+    syntheticPoints[i] = {syntheticNames[i], "V"};
+  }
+
+  // The per-message Serial log is part of the path; by default it goes nowhere
+  if (!verbose && getenv("HAL_UART0") == nullptr) {
+    setenv("HAL_UART0", "/dev/null", 1);
+  }
+  Serial.begin(115200);
+  load_system_configuration();
+  hal_mqtt_set_sink(bench_sink, nullptr);
+  mqtt_initialize();
+  HalMqttStats brokerBefore;
+  hal_mqtt_get_stats(&brokerBefore);
+
+  producersDone = xSemaphoreCreateCounting(BENCH_MAX_TASKS, 0);
+  size_t binarySize = 4 + BENCH_MAX_BATCH * (sizeof(uint32_t) + SENSOR_MAX_POINTS * sizeof(float));
+  int firstChannel = 0;
+  for (int t = 0; t < options.tasks; t++) {
+    BenchProducer* producer = new BenchProducer();
+    producer->options = &options;
+    producer->firstChannel = firstChannel;
+    producer->channelCount = options.channels / options.tasks + (t < options.channels % options.tasks ? 1 : 0);
+    producer->binary = (uint8_t*)malloc(binarySize);
+    firstChannel += producer->channelCount;
+    producers[t] = producer;
+  }
+  int64_t start = esp_timer_get_time();
+  for (int t = 0; t < options.tasks; t++) {
+    xTaskCreate(
+      benchProducerTask,    // Task function
+      "Bench Producer",     // Name of the task (for debugging)
+      8192,                 // Stack size (in words, not bytes)
+      producers[t],         // Task input parameter
+      1,                    // Priority of the task
+      NULL                  // Task handle
+    );
+  }
+  for (int t = 0; t < options.tasks; t++) {
+    xSemaphoreTake(producersDone, portMAX_DELAY);
+  }
+  double elapsed = (esp_timer_get_time() - start) / 1e6;
+
+  uint32_t samples = 0, messages = 0, failed = 0;
+  uint64_t bytes = 0, allocations = 0;
+  std::vector<double> latencies;
+  for (int t = 0; t < options.tasks; t++) {
+    BenchProducer* producer = producers[t];
+    samples += producer->samples;
+    messages += producer->messages;
+    failed += producer->failed;
+    bytes += producer->bytes;
+    allocations += producer->allocations;
+    latencies.insert(latencies.end(), producer->latencies.begin(), producer->latencies.end());
+  }
+  HalMqttStats broker;
+  hal_mqtt_get_stats(&broker);
+
+  printf("\n*** Publish throughput: %d channels on %d task%s, %s x%d points, %s, batch %d, ", options.channels,
+         options.tasks, options.tasks > 1 ? "s" : "", options.driver->name, options.driver->pointCount,
+         options.encoding == BENCH_F32LE ? "f32le" : "json", options.batch);
+  if (options.rate > 0) {
+    printf("%.1f samples/s per channel ***\n", options.rate);
+  } else {
+    printf("back to back ***\n");
+  }
+  printf("Samples:           %u in %.2f s = %.0f/s\n", samples, elapsed, samples / elapsed);
+  printf("Messages:          %u = %.0f/s, %u failed (%u oversize)\n", messages, messages / elapsed, failed,
+         broker.oversize - brokerBefore.oversize);
+  printf("Payload:           %.0f bytes/s, %.0f bytes/message, %.1f bytes/sample\n", bytes / elapsed,
+         messages > 0 ? (double)bytes / messages : 0.0, latencies.empty() ? 0.0 : (double)bytes / latencies.size());
+  printf("Latency:           p50 %.1f us, p99 %.1f us, max %.1f us (acquisition to broker)\n",
+         percentile(latencies, 0.50), percentile(latencies, 0.99), percentile(latencies, 1.0));
+  printf("Heap:              %.1f allocations/message, %.1f allocations/sample\n",
+         messages + failed > 0 ? (double)allocations / (messages + failed) : 0.0,
+         samples > 0 ? (double)allocations / samples : 0.0);
+  fflush(stdout);
+
+  // The MQTT tasks never return
+  quick_exit(0);
+}
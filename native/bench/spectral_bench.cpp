@@ -0,0 +1,62 @@
+// Host benchmark for the geophone feature kernels (window, FFT, band energies) on
+// synthetic signals, to size the analysis window against the CPU budget.
+//
+//   pio run -e spectral_bench && .pio/build/spectral_bench/program [sample rate Hz]
+//
+// Host timings are for relative sizing only; the ESP32 build uses the esp-dsp kernels.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "spectral.h"
+
+int main(int argc, char** argv) {
+  float sampleRate = (argc > 1) ? atof(argv[1]) : 2000.0f;
+  printf("backend: %s, sample rate %.0f Hz\n\n", spectral_backend(), sampleRate);
+  printf("%6s %10s %12s %10s %12s %10s\n", "window", "span ms", "us/window", "budget %", "dominant Hz", "peak");
+
+  srand(1);
+  for (size_t n = 256; n <= SPECTRAL_MAX_FFT; n <<= 1) {
+    // 37.3 Hz blast-like tone plus a weaker 210 Hz component and noise
+    std::vector<float> signal(n);
+    for (size_t i = 0; i < n; i++) {
+      float t = i / sampleRate;
+      signal[i] = 12.0f * sinf(2 * M_PI * 37.3f * t) + 3.0f * sinf(2 * M_PI * 210.0f * t) +
+                  ((rand() / (float)RAND_MAX) - 0.5f);
+    }
+
+    if (!spectral_init(n)) {
+      printf("spectral_init(%zu) failed\n", n);
+      return 1;
+    }
+
+    SpectralFeatures features;
+    const int rounds = 2000;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      spectral_analyze(signal.data(), n, sampleRate, &features);
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+    double spanMs = 1000.0 * n / sampleRate;
+
+    printf("%6zu %10.1f %12.1f %10.3f %12.2f %10.2f\n", n, spanMs, us, 100.0 * us / (spanMs * 1000.0),
+           features.dominantFrequency, features.peak);
+  }
+
+  // Band energies of the last window: expect the 31.5 Hz and 250 Hz bands to dominate
+  SpectralFeatures features;
+  std::vector<float> signal(SPECTRAL_MAX_FFT);
+  for (size_t i = 0; i < signal.size(); i++) {
+    float t = i / sampleRate;
+    signal[i] = 12.0f * sinf(2 * M_PI * 37.3f * t) + 3.0f * sinf(2 * M_PI * 210.0f * t);
+  }
+  spectral_analyze(signal.data(), signal.size(), sampleRate, &features);
+  printf("\noctave band mean-square (expect ~72 at 31.5 Hz, ~4.5 at 250 Hz):\n");
+  for (int b = 0; b < SPECTRAL_OCTAVE_BANDS; b++) {
+    printf("  %6.1f Hz  %10.4f\n", spectralOctaveCentres[b], features.bandEnergy[b]);
+  }
+  return 0;
+}
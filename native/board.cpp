@@ -0,0 +1,17 @@
+#include "utils.h"
+
+// Native stand-ins for the parts of utils.cpp the configuration code and the time
+// service call; the rest
+// of utils.cpp drives WiFi, the RTC, the SD card and the OLED and is not built here.
+
+uint32_t generateRandomNumber() {
+  return esp_random();
+}
+
+void wifi_reconnect() {
+  Serial.println("WiFi: host network, nothing to reconnect");
+}
+
+void external_rtc_sync_ntp() {
+  Serial.println("Skip RTC sync, external RTC not mounted.");
+}
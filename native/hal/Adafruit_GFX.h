@@ -0,0 +1,16 @@
+#ifndef HAL_ADAFRUIT_GFX_H
+#define HAL_ADAFRUIT_GFX_H
+
+// Declarations only, for utils.h: the OLED code is not part of the native build
+
+#include "Arduino.h"
+
+class Adafruit_GFX : public Print {
+ public:
+  size_t write(uint8_t c) override { return 1; }
+  void setCursor(int16_t x, int16_t y) {}
+  void setTextSize(uint8_t size) {}
+  void setTextColor(uint16_t color) {}
+};
+
+#endif
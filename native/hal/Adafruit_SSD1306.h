@@ -0,0 +1,18 @@
+#ifndef HAL_ADAFRUIT_SSD1306_H
+#define HAL_ADAFRUIT_SSD1306_H
+
+#include "Adafruit_GFX.h"
+#include "Wire.h"
+
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_WHITE 1
+
+class Adafruit_SSD1306 : public Adafruit_GFX {
+ public:
+  Adafruit_SSD1306(uint8_t width, uint8_t height, TwoWire* wire, int8_t resetPin) {}
+  bool begin(uint8_t vcs, uint8_t address) { return false; }
+  void clearDisplay() {}
+  void display() {}
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "Arduino.h"
+#include "esp_timer.h"
+#include "hal_heap.h"
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+unsigned long millis() {
+  return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)esp_timer_get_time();
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+bool getLocalTime(struct tm* info, uint32_t ms) {
+  time_t now;
+  time(&now);
+  localtime_r(&now, info);
+  return info->tm_year > (2016 - 1900);
+}
+
+// The host clock is already synchronized; the offsets are left to the TZ environment
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1, const char* server2,
+                const char* server3) {}
+
+/* Random */
+
+static std::mutex randomLock;
+static std::mt19937 randomEngine(std::random_device{}());
+
+long random(long max) {
+  return random(0, max);
+}
+
+long random(long min, long max) {
+  if (min >= max) {
+    return min;
+  }
+  std::lock_guard<std::mutex> guard(randomLock);
+  return min + (long)(randomEngine() % (unsigned long)(max - min));
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed != 0) {
+    std::lock_guard<std::mutex> guard(randomLock);
+    randomEngine.seed(seed);
+  }
+}
+
+uint32_t esp_random() {
+  static std::random_device device;
+  std::lock_guard<std::mutex> guard(randomLock);
+  return device();
+}
+
+/* System */
+
+uint32_t getCpuFrequencyMhz() {
+  return 240;
+}
+
+uint32_t esp_get_free_heap_size() {
+  HalHeapStats stats;
+  hal_heap_get_stats(&stats);
+  return stats.inUse < HAL_HEAP_SIZE ? (uint32_t)(HAL_HEAP_SIZE - stats.inUse) : 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size() {
+  HalHeapStats stats;
+  hal_heap_get_stats(&stats);
+  return stats.peak < HAL_HEAP_SIZE ? (uint32_t)(HAL_HEAP_SIZE - stats.peak) : 0;
+}
@@ -0,0 +1,77 @@
+#ifndef HAL_ARDUINO_H
+#define HAL_ARDUINO_H
+
+// Host stand-in for the Arduino-ESP32 core, enough for the firmware modules in the
+// native build (README.md, Native Build). GPIO is a no-op; time, tasks, UARTs, NVS and
+// MQTT are emulated on the host.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <algorithm>
+
+#include "esp_err.h"
+#include "hal_freertos.h"
+#include "esp_timer.h"
+#include "WString.h"
+#include "Print.h"
+#include "HardwareSerial.h"
+
+using std::min;
+using std::max;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+
+#define ESP32 1
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+/* Time */
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// True once the clock is past 2016, as the core treats an unset RTC
+bool getLocalTime(struct tm* info, uint32_t ms = 5000);
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+
+/* GPIO */
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) {}
+inline int digitalRead(uint8_t pin) { return LOW; }
+inline int8_t digitalPinToAnalogChannel(uint8_t pin) { return -1; }
+
+/* Random */
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+uint32_t esp_random();
+
+/* System */
+
+uint32_t getCpuFrequencyMhz();
+uint32_t esp_get_free_heap_size();
+uint32_t esp_get_minimum_free_heap_size();
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef HAL_ESP_FTP_SERVER_LIB_H
+#define HAL_ESP_FTP_SERVER_LIB_H
+
+// Declarations only, for utils.h
+
+#include "FS.h"
+
+class FTPServer {
+ public:
+  void addUser(const String& user, const String& password);
+  void addFilesystem(const String& name, fs::FS* const fs);
+  bool begin();
+  void handle();
+};
+
+#endif
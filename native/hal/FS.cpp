@@ -0,0 +1,193 @@
+#include "FS.h"
+#include "SD.h"
+#include "SPIFFS.h"
+#include <dirent.h>
+#include <errno.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SPIFFSFS SPIFFS;
+SDFS SD;
+SPIClass SPI;
+
+namespace fs {
+
+struct FileImpl {
+  FILE* stream = nullptr;
+  DIR* dir = nullptr;
+  std::string hostPath;
+  std::string path;   // as the firmware named it
+  std::string name;
+
+  ~FileImpl() {
+    if (stream != nullptr) {
+      fclose(stream);
+    }
+    if (dir != nullptr) {
+      closedir(dir);
+    }
+  }
+};
+
+static std::shared_ptr<FileImpl> hal_file_open(const std::string& hostPath, const std::string& path,
+                                               const char* mode) {
+  auto impl = std::make_shared<FileImpl>();
+  impl->hostPath = hostPath;
+  impl->path = path;
+  size_t slash = path.find_last_of('/');
+  impl->name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+
+  struct stat info;
+  if (stat(hostPath.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+    impl->dir = opendir(hostPath.c_str());
+    return impl->dir != nullptr ? impl : nullptr;
+  }
+  std::string stdioMode = (strcmp(mode, FILE_WRITE) == 0) ? "w+b" : (strcmp(mode, FILE_APPEND) == 0) ? "a+b" : "rb";
+  impl->stream = fopen(hostPath.c_str(), stdioMode.c_str());
+  return impl->stream != nullptr ? impl : nullptr;
+}
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  return (impl && impl->stream) ? fwrite(buffer, 1, size, impl->stream) : 0;
+}
+
+int File::available() {
+  if (!impl || !impl->stream) {
+    return 0;
+  }
+  return (int)(size() - position());
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+  return (impl && impl->stream) ? fread(buffer, 1, size, impl->stream) : 0;
+}
+
+int File::peek() {
+  if (!impl || !impl->stream) {
+    return -1;
+  }
+  int c = fgetc(impl->stream);
+  if (c != EOF) {
+    ungetc(c, impl->stream);
+  }
+  return c == EOF ? -1 : c;
+}
+
+void File::flush() {
+  if (impl && impl->stream) {
+    fflush(impl->stream);
+  }
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  static const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+  return impl && impl->stream && fseek(impl->stream, pos, whence[mode]) == 0;
+}
+
+size_t File::position() const {
+  return (impl && impl->stream) ? (size_t)ftell(impl->stream) : 0;
+}
+
+size_t File::size() const {
+  if (!impl || !impl->stream) {
+    return 0;
+  }
+  fflush(impl->stream);
+  struct stat info;
+  return fstat(fileno(impl->stream), &info) == 0 ? (size_t)info.st_size : 0;
+}
+
+void File::close() {
+  impl.reset();
+}
+
+const char* File::name() const {
+  return impl ? impl->name.c_str() : "";
+}
+
+const char* File::path() const {
+  return impl ? impl->path.c_str() : "";
+}
+
+bool File::isDirectory() const {
+  return impl && impl->dir != nullptr;
+}
+
+File File::openNextFile(const char* mode) {
+  if (!impl || !impl->dir) {
+    return File();
+  }
+  struct dirent* entry;
+  while ((entry = readdir(impl->dir)) != nullptr) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+      std::string parent = (impl->path == "/") ? "" : impl->path;
+      return File(hal_file_open(impl->hostPath + "/" + entry->d_name, parent + "/" + entry->d_name, mode));
+    }
+  }
+  return File();
+}
+
+String File::readStringUntil(char terminator) {
+  String result;
+  int c;
+  while ((c = read()) >= 0 && c != terminator) {
+    result += (char)c;
+  }
+  return result;
+}
+
+long File::parseInt() {
+  return readStringUntil('\n').toInt();
+}
+
+File::operator bool() const {
+  return impl != nullptr;
+}
+
+String FS::hostPath(const char* path) const {
+  const char* dir = getenv("HAL_FS_DIR");
+  String base = (dir != nullptr && dir[0] != '\0') ? dir : "fs";
+  ::mkdir(base.c_str(), 0755);
+  base += "/";
+  base += subdir;
+  ::mkdir(base.c_str(), 0755);
+  return base + (path[0] == '/' ? "" : "/") + path;
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+  return File(hal_file_open(hostPath(path).c_str(), path, mode));
+}
+
+bool FS::exists(const char* path) {
+  struct stat info;
+  return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool FS::remove(const char* path) {
+  return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+  return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+  String host = hostPath(path);
+  return ::mkdir(host.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool FS::rmdir(const char* path) {
+  return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+}  // namespace fs
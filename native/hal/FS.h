@@ -0,0 +1,77 @@
+#ifndef HAL_FS_H
+#define HAL_FS_H
+
+// Filesystems on a host directory: SPIFFS under $HAL_FS_DIR/spiffs, SD under
+// $HAL_FS_DIR/sd (default ./fs). Files are stdio streams; directories can be listed
+// with openNextFile().
+
+#include <memory>
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FileImpl;
+
+class File : public Print {
+ public:
+  File() {}
+  explicit File(std::shared_ptr<FileImpl> impl) : impl(impl) {}
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  int available();
+  int read();
+  size_t read(uint8_t* buffer, size_t size);
+  int peek();
+  void flush() override;
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  const char* name() const;
+  const char* path() const;
+  bool isDirectory() const;
+  File openNextFile(const char* mode = FILE_READ);
+  String readStringUntil(char terminator);
+  long parseInt();
+  operator bool() const;
+
+ private:
+  std::shared_ptr<FileImpl> impl;
+};
+
+class FS {
+ public:
+  explicit FS(const char* subdir) : subdir(subdir) {}
+  File open(const char* path, const char* mode = FILE_READ, bool create = false);
+  File open(const String& path, const char* mode = FILE_READ, bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool rename(const char* from, const char* to);
+  bool mkdir(const char* path);
+  bool rmdir(const char* path);
+
+ protected:
+  String hostPath(const char* path) const;
+  const char* subdir;
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
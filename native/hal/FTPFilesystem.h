@@ -0,0 +1,6 @@
+#ifndef HAL_FTP_FILESYSTEM_H
+#define HAL_FTP_FILESYSTEM_H
+
+#include "FS.h"
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef HAL_HTTPCLIENT_H
+#define HAL_HTTPCLIENT_H
+
+// Declarations only, for utils.h
+
+#include "Arduino.h"
+
+class HTTPClient {
+ public:
+  bool begin(const String& url);
+  int GET();
+  String getString();
+  void end();
+};
+
+#endif
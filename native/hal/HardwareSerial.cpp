@@ -0,0 +1,208 @@
+#include "HardwareSerial.h"
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+
+HardwareSerial::HardwareSerial(int uartNum) : uart(uartNum) {
+  console = (uart == 0);
+}
+
+HardwareSerial::~HardwareSerial() {
+  end();
+}
+
+static speed_t hal_baud_constant(unsigned long baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return B115200;
+  }
+}
+
+void HardwareSerial::begin(unsigned long baudRate, uint32_t config, int8_t rxPin, int8_t txPin, bool invert,
+                           unsigned long timeoutMs, uint8_t rxfifoFullThrhd) {
+  end();
+  baud = baudRate;
+
+  char name[16];
+  snprintf(name, sizeof(name), "HAL_UART%d", uart);
+  const char* path = getenv(name);
+  if (path == nullptr || path[0] == '\0') {
+    return;
+  }
+
+  fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) {
+    fprintf(stderr, "[hal] UART%d: cannot open %s: %s\n", uart, path, strerror(errno));
+    return;
+  }
+  if (isatty(fd)) {
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, hal_baud_constant(baud));
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  console = false;
+  running = true;
+  reader = std::thread(&HardwareSerial::rxLoop, this);
+}
+
+void HardwareSerial::end() {
+  if (running) {
+    running = false;
+    reader.join();
+  }
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+  console = (uart == 0);
+  std::lock_guard<std::mutex> guard(rxLock);
+  rxBuffer.clear();
+}
+
+// Reader thread: plays the RX FIFO, the RX timeout interrupt and the UART event task
+void HardwareSerial::rxLoop() {
+  using Clock = std::chrono::steady_clock;
+  size_t unreported = 0;
+  Clock::time_point lastByte;
+
+  while (running) {
+    // One symbol is 11 bits (start, 8 data, parity or second stop, stop)
+    auto idle = std::chrono::microseconds((uint64_t)rxTimeoutSymbols * 11 * 1000000 / baud);
+    int waitMs = 20;
+    if (unreported > 0) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(lastByte + idle - Clock::now()).count();
+      waitMs = (int)std::max((long long)0, std::min((long long)waitMs, (long long)left + 1));
+    }
+
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, waitMs);
+    if (ready > 0 && (pfd.revents & POLLIN)) {
+      uint8_t chunk[256];
+      ssize_t n = ::read(fd, chunk, sizeof(chunk));
+      if (n > 0) {
+        std::lock_guard<std::mutex> guard(rxLock);
+        for (ssize_t i = 0; i < n; i++) {
+          if (rxBuffer.size() < rxBufferSize) {
+            rxBuffer.push_back(chunk[i]);
+          } else {
+            overflows++;
+          }
+        }
+        unreported += n;
+        lastByte = Clock::now();
+      }
+    } else if (ready > 0 && (pfd.revents & (POLLHUP | POLLERR))) {
+      // Peer closed (pty master gone): behave like a disconnected line
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    if (unreported == 0) {
+      continue;
+    }
+    OnReceiveCb callback;
+    bool onlyOnTimeout;
+    {
+      std::lock_guard<std::mutex> guard(rxLock);
+      callback = rxCallback;
+      onlyOnTimeout = rxOnlyOnTimeout;
+    }
+    bool timedOut = Clock::now() - lastByte >= idle;
+    bool fifoFull = !onlyOnTimeout && unreported >= HAL_UART_FIFO_FULL;
+    if (timedOut || fifoFull) {
+      unreported = 0;
+      if (callback) {
+        callback();
+      }
+    }
+  }
+}
+
+int HardwareSerial::available() {
+  std::lock_guard<std::mutex> guard(rxLock);
+  return (int)rxBuffer.size();
+}
+
+int HardwareSerial::peek() {
+  std::lock_guard<std::mutex> guard(rxLock);
+  return rxBuffer.empty() ? -1 : rxBuffer.front();
+}
+
+int HardwareSerial::read() {
+  std::lock_guard<std::mutex> guard(rxLock);
+  if (rxBuffer.empty()) {
+    return -1;
+  }
+  uint8_t c = rxBuffer.front();
+  rxBuffer.pop_front();
+  return c;
+}
+
+size_t HardwareSerial::read(uint8_t* buffer, size_t size) {
+  std::lock_guard<std::mutex> guard(rxLock);
+  size_t n = std::min(size, rxBuffer.size());
+  for (size_t i = 0; i < n; i++) {
+    buffer[i] = rxBuffer.front();
+    rxBuffer.pop_front();
+  }
+  return n;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  std::lock_guard<std::mutex> guard(txLock);
+  int target = console ? STDOUT_FILENO : fd;
+  if (target < 0) {
+    return size;  // nothing attached: the bytes go nowhere, as on an open line
+  }
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = ::write(target, buffer + done, size - done);
+    if (n > 0) {
+      done += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+      struct pollfd pfd = {target, POLLOUT, 0};
+      poll(&pfd, 1, 10);
+    } else {
+      break;
+    }
+  }
+  return done;
+}
+
+bool HardwareSerial::setRxTimeout(uint8_t symbols) {
+  rxTimeoutSymbols = std::max((uint8_t)1, symbols);
+  return true;
+}
+
+size_t HardwareSerial::setRxBufferSize(size_t size) {
+  std::lock_guard<std::mutex> guard(rxLock);
+  rxBufferSize = size;
+  return size;
+}
+
+void HardwareSerial::onReceive(OnReceiveCb callback, bool onlyOnTimeout) {
+  std::lock_guard<std::mutex> guard(rxLock);
+  rxCallback = callback;
+  rxOnlyOnTimeout = onlyOnTimeout;
+}
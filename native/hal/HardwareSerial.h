@@ -0,0 +1,83 @@
+#ifndef HAL_HARDWARE_SERIAL_H
+#define HAL_HARDWARE_SERIAL_H
+
+// UARTs on host file descriptors. UART n is backed by the device or pty named in the
+// environment variable HAL_UART<n> (e.g. HAL_UART2=/dev/pts/5). UART0 without one
+// writes to stdout; other UARTs without one discard writes and never receive.
+//
+// A reader thread per open UART stands in for the RX FIFO and the UART event task:
+// onReceive() callbacks run on it after the line has been idle for the configured
+// number of symbols, or once HAL_UART_FIFO_FULL bytes are waiting, as on the ESP32.
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "Print.h"
+
+#define SERIAL_8N1 0x800001c
+#define SERIAL_8E1 0x800001e
+#define SERIAL_8N2 0x800003c
+
+#define HAL_UART_FIFO_FULL 120   // default rxfifo_full_thrhd of the Arduino core
+
+typedef std::function<void(void)> OnReceiveCb;
+
+class HardwareSerial : public Print {
+ public:
+  explicit HardwareSerial(int uartNum);
+  ~HardwareSerial();
+
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1,
+             bool invert = false, unsigned long timeoutMs = 20000UL, uint8_t rxfifoFullThrhd = 112);
+  void end();
+
+  int available();
+  int peek();
+  int read();
+  size_t read(uint8_t* buffer, size_t size);
+  size_t read(char* buffer, size_t size) { return read((uint8_t*)buffer, size); }
+  size_t readBytes(uint8_t* buffer, size_t size) { return read(buffer, size); }
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  void flush() override {}
+
+  bool setPins(int8_t rxPin, int8_t txPin, int8_t ctsPin = -1, int8_t rtsPin = -1) { return true; }
+  bool setMode(uint8_t mode) { return true; }
+  bool setHwFlowCtrlMode(uint8_t mode = 0, uint8_t threshold = 64) { return true; }
+  bool setRxTimeout(uint8_t symbols);
+  size_t setRxBufferSize(size_t size);
+  void onReceive(OnReceiveCb callback, bool onlyOnTimeout = false);
+
+  operator bool() const { return true; }
+
+  // Bytes dropped because the RX buffer was full
+  uint32_t rxOverflows() const { return overflows; }
+
+ private:
+  void rxLoop();
+
+  int uart;
+  int fd = -1;
+  bool console = false;          // UART0 without a device: stdout
+  unsigned long baud = 115200;
+  std::mutex txLock;
+  std::mutex rxLock;
+  std::deque<uint8_t> rxBuffer;
+  size_t rxBufferSize = 256;
+  uint8_t rxTimeoutSymbols = 2;
+  OnReceiveCb rxCallback;
+  bool rxOnlyOnTimeout = false;
+  std::atomic<bool> running{false};
+  std::thread reader;
+  std::atomic<uint32_t> overflows{0};
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+
+#endif
@@ -0,0 +1,156 @@
+#include "Preferences.h"
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t>> HalNamespace;
+
+// Namespaces are loaded once and shared by every Preferences object, like the NVS cache
+static std::mutex nvsLock;
+static std::map<std::string, HalNamespace> nvsCache;
+
+static std::string hal_nvs_path(const std::string& name) {
+  const char* dir = getenv("HAL_NVS_DIR");
+  std::string base = (dir != nullptr && dir[0] != '\0') ? dir : "nvs";
+  mkdir(base.c_str(), 0755);
+  return base + "/" + name;
+}
+
+static HalNamespace& hal_nvs_load(const std::string& name) {
+  auto found = nvsCache.find(name);
+  if (found != nvsCache.end()) {
+    return found->second;
+  }
+  HalNamespace& entries = nvsCache[name];
+  std::ifstream file(hal_nvs_path(name));
+  std::string line;
+  while (std::getline(file, line)) {
+    size_t tab = line.find('\t');
+    if (tab == std::string::npos) {
+      continue;
+    }
+    std::vector<uint8_t> value;
+    for (size_t i = tab + 1; i + 1 < line.size(); i += 2) {
+      value.push_back((uint8_t)strtoul(line.substr(i, 2).c_str(), nullptr, 16));
+    }
+    entries[line.substr(0, tab)] = value;
+  }
+  return entries;
+}
+
+static bool hal_nvs_store(const std::string& name) {
+  std::string path = hal_nvs_path(name);
+  std::string temp = path + ".tmp";
+  {
+    std::ofstream file(temp, std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    for (const auto& entry : nvsCache[name]) {
+      file << entry.first << '\t';
+      char hex[3];
+      for (uint8_t b : entry.second) {
+        snprintf(hex, sizeof(hex), "%02x", b);
+        file << hex;
+      }
+      file << '\n';
+    }
+  }
+  return rename(temp.c_str(), path.c_str()) == 0;  // a crash leaves the old file, as NVS would
+}
+
+bool Preferences::begin(const char* name, bool readOnlyMode, const char* partitionLabel) {
+  if (opened || name == nullptr || strlen(name) > 15) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(nvsLock);
+  hal_nvs_load(name);
+  nameSpace = name;
+  readOnly = readOnlyMode;
+  opened = true;
+  return true;
+}
+
+void Preferences::end() {
+  opened = false;
+}
+
+bool Preferences::clear() {
+  if (!opened || readOnly) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(nvsLock);
+  nvsCache[nameSpace.c_str()].clear();
+  return hal_nvs_store(nameSpace.c_str());
+}
+
+bool Preferences::remove(const char* key) {
+  if (!opened || readOnly) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(nvsLock);
+  if (nvsCache[nameSpace.c_str()].erase(key) == 0) {
+    return false;
+  }
+  return hal_nvs_store(nameSpace.c_str());
+}
+
+bool Preferences::isKey(const char* key) {
+  if (!opened) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(nvsLock);
+  const HalNamespace& entries = nvsCache[nameSpace.c_str()];
+  return entries.find(key) != entries.end();
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  if (!opened || readOnly || key == nullptr || strlen(key) > 15 || (value == nullptr && len > 0)) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> guard(nvsLock);
+  const uint8_t* bytes = (const uint8_t*)value;
+  nvsCache[nameSpace.c_str()][key] = std::vector<uint8_t>(bytes, bytes + len);
+  return hal_nvs_store(nameSpace.c_str()) ? len : 0;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (!opened) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> guard(nvsLock);
+  const HalNamespace& entries = nvsCache[nameSpace.c_str()];
+  auto found = entries.find(key);
+  return found == entries.end() ? 0 : found->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLen) {
+  if (!opened) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> guard(nvsLock);
+  const HalNamespace& entries = nvsCache[nameSpace.c_str()];
+  auto found = entries.find(key);
+  if (found == entries.end() || found->second.size() > maxLen) {
+    return 0;  // NVS refuses a buffer that is too small
+  }
+  memcpy(buffer, found->second.data(), found->second.size());
+  return found->second.size();
+}
+
+size_t Preferences::putString(const char* key, const String& value) {
+  return putBytes(key, value.c_str(), value.length() + 1) > 0 ? value.length() : 0;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+  size_t len = getBytesLength(key);
+  if (len == 0) {
+    return defaultValue;
+  }
+  std::vector<char> buffer(len + 1, 0);
+  getBytes(key, buffer.data(), len);
+  return String(buffer.data());
+}
@@ -0,0 +1,60 @@
+#ifndef HAL_PREFERENCES_H
+#define HAL_PREFERENCES_H
+
+// NVS on host files: one file per namespace in $HAL_NVS_DIR (default ./nvs), one
+// "key<TAB>hex bytes" line per entry. Every put writes the namespace file through,
+// so a restarted process sees what the previous one committed.
+
+#include "Arduino.h"
+
+class Preferences {
+ public:
+  bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+  void end();
+
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+  size_t putBytes(const char* key, const void* value, size_t len);
+  size_t getBytesLength(const char* key);
+  size_t getBytes(const char* key, void* buffer, size_t maxLen);
+
+  size_t putChar(const char* key, int8_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUChar(const char* key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putShort(const char* key, int16_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUShort(const char* key, uint16_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putInt(const char* key, int32_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putLong64(const char* key, int64_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putULong64(const char* key, uint64_t value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putFloat(const char* key, float value) { return putBytes(key, &value, sizeof(value)); }
+  size_t putBool(const char* key, bool value) { return putUChar(key, value ? 1 : 0); }
+  size_t putString(const char* key, const String& value);
+
+  int8_t getChar(const char* key, int8_t defaultValue = 0) { return getValue(key, defaultValue); }
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return getValue(key, defaultValue); }
+  int16_t getShort(const char* key, int16_t defaultValue = 0) { return getValue(key, defaultValue); }
+  uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return getValue(key, defaultValue); }
+  int32_t getInt(const char* key, int32_t defaultValue = 0) { return getValue(key, defaultValue); }
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return getValue(key, defaultValue); }
+  int64_t getLong64(const char* key, int64_t defaultValue = 0) { return getValue(key, defaultValue); }
+  uint64_t getULong64(const char* key, uint64_t defaultValue = 0) { return getValue(key, defaultValue); }
+  float getFloat(const char* key, float defaultValue = 0) { return getValue(key, defaultValue); }
+  bool getBool(const char* key, bool defaultValue = false) { return getUChar(key, defaultValue ? 1 : 0) != 0; }
+  String getString(const char* key, const String& defaultValue = String());
+
+ private:
+  template <typename T>
+  T getValue(const char* key, T defaultValue) {
+    T value;
+    return (getBytesLength(key) == sizeof(T) && getBytes(key, &value, sizeof(T)) == sizeof(T)) ? value
+                                                                                              : defaultValue;
+  }
+
+  String nameSpace;
+  bool opened = false;
+  bool readOnly = false;
+};
+
+#endif
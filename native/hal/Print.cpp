@@ -0,0 +1,89 @@
+#include "Print.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::write(const char* text) {
+  return (text != nullptr) ? write((const uint8_t*)text, strlen(text)) : 0;
+}
+
+size_t Print::vprintf(const char* format, va_list args) {
+  char local[256];
+  va_list copy;
+  va_copy(copy, args);
+  int len = vsnprintf(local, sizeof(local), format, copy);
+  va_end(copy);
+  if (len < 0) {
+    return 0;
+  }
+  if ((size_t)len < sizeof(local)) {
+    return write((const uint8_t*)local, len);
+  }
+  std::vector<char> buffer(len + 1);
+  vsnprintf(buffer.data(), buffer.size(), format, args);
+  return write((const uint8_t*)buffer.data(), len);
+}
+
+size_t Print::printf(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  size_t n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
+
+size_t Print::print(const String& value) {
+  return write((const uint8_t*)value.c_str(), value.length());
+}
+
+size_t Print::print(const char* value) {
+  return write(value);
+}
+
+size_t Print::print(char value) {
+  return write((uint8_t)value);
+}
+
+size_t Print::print(unsigned char value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(int value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(long value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(long long value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long long value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(double value, int digits) {
+  return print(String(value, (unsigned int)digits));
+}
+
+size_t Print::println() {
+  return write((const uint8_t*)"\r\n", 2);
+}
@@ -0,0 +1,122 @@
+#include "PubSubClient.h"
+#include <mutex>
+
+static std::mutex brokerLock;
+static HalMqttSink brokerSink = nullptr;
+static void* brokerSinkContext = nullptr;
+static HalMqttStats brokerStats;
+static bool brokerAvailable = true;
+static uint32_t brokerSession = 1;   // bumped when the broker goes away, dropping clients
+static int brokerLog = -1;
+
+void hal_mqtt_set_sink(HalMqttSink sink, void* context) {
+  std::lock_guard<std::mutex> guard(brokerLock);
+  brokerSink = sink;
+  brokerSinkContext = context;
+}
+
+void hal_mqtt_get_stats(HalMqttStats* stats) {
+  std::lock_guard<std::mutex> guard(brokerLock);
+  *stats = brokerStats;
+}
+
+void hal_mqtt_set_broker_available(bool available) {
+  std::lock_guard<std::mutex> guard(brokerLock);
+  if (brokerAvailable && !available) {
+    brokerSession++;
+  }
+  brokerAvailable = available;
+}
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  if (size == 0) {
+    return false;
+  }
+  bufferSize = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char* id) {
+  return connect(id, nullptr, nullptr);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* password) {
+  if (WiFi.status() != WL_CONNECTED) {
+    status = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(brokerLock);
+  if (!brokerAvailable) {
+    status = MQTT_CONNECTION_TIMEOUT;
+    return false;
+  }
+  status = MQTT_CONNECTED;
+  session = brokerSession;
+  brokerStats.connects++;
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  status = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected() {
+  if (status != MQTT_CONNECTED) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(brokerLock);
+  if (session != brokerSession || WiFi.status() != WL_CONNECTED) {
+    status = MQTT_CONNECTION_LOST;
+    return false;
+  }
+  return true;
+}
+
+int PubSubClient::state() {
+  return status;
+}
+
+bool PubSubClient::loop() {
+  return connected();
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload != nullptr ? strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  if (!connected()) {
+    std::lock_guard<std::mutex> guard(brokerLock);
+    brokerStats.disconnected++;
+    return false;
+  }
+  size_t topicLength = strlen(topic);
+  HalMqttSink sink;
+  void* context;
+  {
+    std::lock_guard<std::mutex> guard(brokerLock);
+    if (MQTT_MAX_HEADER_SIZE + 2 + topicLength + length > bufferSize) {
+      brokerStats.oversize++;
+      return false;
+    }
+    brokerStats.published++;
+    brokerStats.payloadBytes += length;
+    sink = brokerSink;
+    context = brokerSinkContext;
+    if (brokerLog < 0) {
+      const char* log = getenv("HAL_MQTT_LOG");
+      brokerLog = (log != nullptr && log[0] == '1') ? 1 : 0;
+    }
+  }
+  if (brokerLog > 0) {
+    Serial.printf("[mqtt] %s (%u bytes) %.*s\n", topic, length, (int)min(length, 200u), (const char*)payload);
+  }
+  if (sink != nullptr) {
+    sink(topic, payload, length, context);
+  }
+  return true;
+}
@@ -0,0 +1,45 @@
+#ifndef HAL_PUBSUBCLIENT_H
+#define HAL_PUBSUBCLIENT_H
+
+// PubSubClient against the in-process broker in hal_mqtt.h, with the library's
+// buffer-size rule: a message must fit 5 header bytes + 2 + topic + payload.
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "hal_mqtt.h"
+
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+class PubSubClient {
+ public:
+  PubSubClient() {}
+  explicit PubSubClient(WiFiClient& client) {}
+
+  PubSubClient& setServer(const char* domain, uint16_t port);
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() const { return bufferSize; }
+
+  bool connect(const char* id);
+  bool connect(const char* id, const char* user, const char* password);
+  void disconnect();
+  bool connected();
+  int state();
+  bool loop();
+  bool subscribe(const char* topic, uint8_t qos = 0) { return connected(); }
+
+  bool publish(const char* topic, const char* payload, bool retained = false);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained = false);
+
+ private:
+  uint16_t bufferSize = 256;
+  int status = MQTT_DISCONNECTED;
+  uint32_t session = 0;    // broker session this client joined
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef HAL_RTCLIB_H
+#define HAL_RTCLIB_H
+
+// Declarations only: the DS1307 code in utils.cpp is not part of the native build
+
+#include "Arduino.h"
+#include "Wire.h"
+
+class DateTime {
+ public:
+  DateTime(uint32_t unixTime = 0);
+  DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+  uint16_t year() const;
+  uint8_t month() const;
+  uint8_t day() const;
+  uint8_t hour() const;
+  uint8_t minute() const;
+  uint8_t second() const;
+  uint32_t unixtime() const;
+};
+
+class RTC_DS1307 {
+ public:
+  bool begin(TwoWire* wire = nullptr);
+  void adjust(const DateTime& dt);
+  DateTime now();
+  bool isrunning();
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef HAL_SD_H
+#define HAL_SD_H
+
+#include "FS.h"
+#include "SPI.h"
+
+class SDFS : public fs::FS {
+ public:
+  SDFS() : FS("sd") {}
+  bool begin(uint8_t ssPin = 5, SPIClass& spi = SPI, uint32_t frequency = 4000000, const char* mountpoint = "/sd",
+             uint8_t maxFiles = 5, bool formatIfEmpty = false) {
+    return mkdir("/");
+  }
+  void end() {}
+  uint64_t totalBytes() { return 4ULL << 30; }
+  uint64_t usedBytes() { return 0; }
+};
+
+extern SDFS SD;
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef HAL_SPIFFS_H
+#define HAL_SPIFFS_H
+
+#include "FS.h"
+
+class SPIFFSFS : public fs::FS {
+ public:
+  SPIFFSFS() : FS("spiffs") {}
+  bool begin(bool formatOnFail = false, const char* basePath = "/spiffs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = nullptr) {
+    return mkdir("/");
+  }
+  void end() {}
+  size_t totalBytes() { return 1441792; }
+  size_t usedBytes() { return 0; }
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif
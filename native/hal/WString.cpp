@@ -0,0 +1,161 @@
+#include "WString.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static std::string hal_format_integer(unsigned long long value, bool negative, unsigned char base) {
+  if (base < 2 || base > 36) {
+    base = 10;
+  }
+  char digits[70];
+  int pos = sizeof(digits) - 1;
+  digits[pos] = '\0';
+  do {
+    int digit = (int)(value % base);
+    digits[--pos] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    value /= base;
+  } while (value > 0);
+  if (negative) {
+    digits[--pos] = '-';
+  }
+  return std::string(&digits[pos]);
+}
+
+// Signed values are only printed with a sign in base 10, as in the Arduino core
+static std::string hal_format_signed(long long value, unsigned char base) {
+  if (base == 10 && value < 0) {
+    return hal_format_integer(0ULL - (unsigned long long)value, true, base);
+  }
+  return hal_format_integer((unsigned long long)value, false, base);
+}
+
+String::String(unsigned char value, unsigned char base) : s(hal_format_integer(value, false, base)) {}
+String::String(int value, unsigned char base)
+    : s(base == 10 ? hal_format_signed(value, base) : hal_format_integer((unsigned int)value, false, base)) {}
+String::String(unsigned int value, unsigned char base) : s(hal_format_integer(value, false, base)) {}
+String::String(long value, unsigned char base)
+    : s(base == 10 ? hal_format_signed(value, base) : hal_format_integer((unsigned long)value, false, base)) {}
+String::String(unsigned long value, unsigned char base) : s(hal_format_integer(value, false, base)) {}
+String::String(long long value, unsigned char base) : s(hal_format_signed(value, base)) {}
+String::String(unsigned long long value, unsigned char base) : s(hal_format_integer(value, false, base)) {}
+
+String::String(float value, unsigned int decimals) : String((double)value, decimals) {}
+
+String::String(double value, unsigned int decimals) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+  s = buffer;
+}
+
+bool String::equalsIgnoreCase(const String& other) const {
+  if (s.size() != other.s.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < s.size(); i++) {
+    if (tolower((unsigned char)s[i]) != tolower((unsigned char)other.s[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t pos = s.find(c, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String& text, unsigned int from) const {
+  size_t pos = s.find(text.s, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char c) const {
+  size_t pos = s.rfind(c);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(const String& text) const {
+  size_t pos = s.rfind(text.s);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int from) const {
+  return substring(from, length());
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    std::swap(from, to);
+  }
+  if (from >= s.size()) {
+    return String();
+  }
+  to = std::min(to, (unsigned int)s.size());
+  return String(s.substr(from, to - from).c_str());
+}
+
+void String::replace(const String& find, const String& with) {
+  if (find.s.empty()) {
+    return;
+  }
+  size_t pos = 0;
+  while ((pos = s.find(find.s, pos)) != std::string::npos) {
+    s.replace(pos, find.s.size(), with.s);
+    pos += with.s.size();
+  }
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index < s.size()) {
+    s.erase(index, count);
+  }
+}
+
+void String::toLowerCase() {
+  for (char& c : s) {
+    c = (char)tolower((unsigned char)c);
+  }
+}
+
+void String::toUpperCase() {
+  for (char& c : s) {
+    c = (char)toupper((unsigned char)c);
+  }
+}
+
+void String::trim() {
+  size_t first = s.find_first_not_of(" \t\r\n\f\v");
+  if (first == std::string::npos) {
+    s.clear();
+    return;
+  }
+  size_t last = s.find_last_not_of(" \t\r\n\f\v");
+  s = s.substr(first, last - first + 1);
+}
+
+long String::toInt() const {
+  return atol(s.c_str());
+}
+
+float String::toFloat() const {
+  return (float)atof(s.c_str());
+}
+
+double String::toDouble() const {
+  return atof(s.c_str());
+}
+
+void String::getBytes(unsigned char* buffer, unsigned int size, unsigned int index) const {
+  if (size == 0 || buffer == nullptr) {
+    return;
+  }
+  if (index >= s.size()) {
+    buffer[0] = 0;
+    return;
+  }
+  size_t n = std::min((size_t)size - 1, s.size() - index);
+  memcpy(buffer, s.data() + index, n);
+  buffer[n] = 0;
+}
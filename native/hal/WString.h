@@ -0,0 +1,135 @@
+#ifndef HAL_WSTRING_H
+#define HAL_WSTRING_H
+
+// Arduino String over std::string; covers the subset the firmware uses
+
+#include <string>
+#include <type_traits>
+#include <stddef.h>
+
+class String {
+ public:
+  String() {}
+  String(const char* text) : s(text != nullptr ? text : "") {}
+  String(const String& other) = default;
+  String(String&& other) = default;
+  explicit String(char c) : s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimals = 2);
+  explicit String(double value, unsigned int decimals = 2);
+
+  String& operator=(const String& other) = default;
+  String& operator=(String&& other) = default;
+  String& operator=(const char* text) {
+    s = (text != nullptr) ? text : "";
+    return *this;
+  }
+
+  const char* c_str() const { return s.c_str(); }
+  unsigned int length() const { return (unsigned int)s.size(); }
+  bool isEmpty() const { return s.empty(); }
+  bool reserve(unsigned int size) {
+    s.reserve(size);
+    return true;
+  }
+
+  bool concat(const String& other) {
+    s += other.s;
+    return true;
+  }
+  bool concat(const char* text) {
+    s += (text != nullptr) ? text : "";
+    return true;
+  }
+  bool concat(char c) {
+    s += c;
+    return true;
+  }
+  template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+  bool concat(T value) {
+    return concat(String(value));
+  }
+
+  template <typename T>
+  String& operator+=(const T& value) {
+    concat(value);
+    return *this;
+  }
+
+  bool equals(const String& other) const { return s == other.s; }
+  bool equals(const char* text) const { return s == (text != nullptr ? text : ""); }
+  bool equalsIgnoreCase(const String& other) const;
+  bool operator==(const String& other) const { return equals(other); }
+  bool operator==(const char* text) const { return equals(text); }
+  bool operator!=(const String& other) const { return !equals(other); }
+  bool operator!=(const char* text) const { return !equals(text); }
+  bool operator<(const String& other) const { return s < other.s; }
+
+  char charAt(unsigned int index) const { return index < s.size() ? s[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char& operator[](unsigned int index) { return s[index]; }
+
+  bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+  bool endsWith(const String& suffix) const {
+    return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+  }
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String& text, unsigned int from = 0) const;
+  int lastIndexOf(char c) const;
+  int lastIndexOf(const String& text) const;
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+
+  void replace(const String& find, const String& with);
+  void remove(unsigned int index, unsigned int count = (unsigned int)-1);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+  void getBytes(unsigned char* buffer, unsigned int size, unsigned int index = 0) const;
+  void toCharArray(char* buffer, unsigned int size, unsigned int index = 0) const {
+    getBytes((unsigned char*)buffer, size, index);
+  }
+
+ private:
+  std::string s;
+};
+
+inline String operator+(const String& lhs, const String& rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+inline String operator+(const String& lhs, const char* rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+inline String operator+(const char* lhs, const String& rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+inline String operator+(const String& lhs, char rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+inline String operator+(const String& lhs, T rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#include "WiFi.h"
+#include <atomic>
+
+WiFiClass WiFi;
+
+static std::atomic<bool> wifiConnected{true};
+
+void hal_wifi_set_connected(bool connected) {
+  wifiConnected = connected;
+}
+
+wl_status_t WiFiClass::status() {
+  return wifiConnected ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* password) {
+  return status();
+}
+
+String IPAddress::toString() const {
+  char text[16];
+  snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+  return String(text);
+}
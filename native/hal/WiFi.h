@@ -0,0 +1,56 @@
+#ifndef HAL_WIFI_H
+#define HAL_WIFI_H
+
+// The host network is always up; hal_wifi_set_connected(false) simulates a dropped link
+
+#include "Arduino.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3,
+} wifi_mode_t;
+
+typedef enum {
+  WIFI_POWER_19_5dBm = 78,
+} wifi_power_t;
+
+class IPAddress {
+ public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : octets{a, b, c, d} {}
+  String toString() const;
+  uint8_t octets[4];
+};
+
+class WiFiClass {
+ public:
+  wl_status_t status();
+  wl_status_t begin(const char* ssid, const char* password = nullptr);
+  bool disconnect(bool wifiOff = false) { return true; }
+  bool mode(wifi_mode_t mode) { return true; }
+  bool setTxPower(wifi_power_t power) { return true; }
+  bool softAP(const char* ssid, const char* password = nullptr, int channel = 1, int hidden = 0, int maxConnections = 4) {
+    return true;
+  }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+  int8_t RSSI() { return -50; }
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient {};
+
+void hal_wifi_set_connected(bool connected);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef HAL_WIRE_H
+#define HAL_WIRE_H
+
+// No I2C devices on the host: every transfer is NACKed
+
+#include "Arduino.h"
+
+class TwoWire {
+ public:
+  explicit TwoWire(uint8_t bus) {}
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { return true; }
+  bool setClock(uint32_t frequency) { return true; }
+  void beginTransmission(uint8_t address) {}
+  uint8_t endTransmission(bool sendStop = true) { return 2; }
+  size_t write(uint8_t data) { return 1; }
+  size_t write(const uint8_t* data, size_t length) { return length; }
+  uint8_t requestFrom(uint8_t address, size_t length, bool sendStop = true) { return 0; }
+  int available() { return 0; }
+  int read() { return -1; }
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
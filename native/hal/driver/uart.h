@@ -0,0 +1,31 @@
+#ifndef HAL_DRIVER_UART_H
+#define HAL_DRIVER_UART_H
+
+#include "esp_err.h"
+
+typedef enum {
+  UART_NUM_0,
+  UART_NUM_1,
+  UART_NUM_2,
+  UART_NUM_MAX,
+} uart_port_t;
+
+typedef enum {
+  UART_MODE_UART = 0x00,
+  UART_MODE_RS485_HALF_DUPLEX = 0x01,
+  UART_MODE_IRDA = 0x02,
+  UART_MODE_RS485_COLLISION_DETECT = 0x03,
+  UART_MODE_RS485_APP_CTRL = 0x04,
+} uart_mode_t;
+
+#define HW_FLOWCTRL_DISABLE 0x0
+#define HW_FLOWCTRL_RTS 0x1
+#define HW_FLOWCTRL_CTS 0x2
+#define HW_FLOWCTRL_CTS_RTS 0x3
+
+// Inter-frame idle is a property of the wire; the host line has none to configure
+inline esp_err_t uart_set_tx_idle_num(uart_port_t uartNum, uint16_t idleNum) {
+  return ESP_OK;
+}
+
+#endif
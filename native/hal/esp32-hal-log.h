@@ -0,0 +1,12 @@
+#ifndef HAL_ESP32_HAL_LOG_H
+#define HAL_ESP32_HAL_LOG_H
+
+#include "esp_log.h"
+
+#define log_e(format, ...) ESP_LOGE("hal", format, ##__VA_ARGS__)
+#define log_w(format, ...) ESP_LOGW("hal", format, ##__VA_ARGS__)
+#define log_i(format, ...) ESP_LOGI("hal", format, ##__VA_ARGS__)
+#define log_d(format, ...) ((void)0)
+#define log_v(format, ...) ((void)0)
+
+#endif
@@ -0,0 +1,123 @@
+#include "esp_timer.h"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using HalClock = std::chrono::steady_clock;
+
+struct esp_timer {
+  esp_timer_cb_t callback;
+  void* arg;
+  bool active;
+  uint64_t periodUs;     // 0 for one-shot
+  int64_t deadlineUs;
+};
+
+static const HalClock::time_point timerEpoch = HalClock::now();
+static std::mutex timerLock;
+static std::condition_variable timerWake;
+static std::multimap<int64_t, esp_timer*> timerSchedule;
+static bool timerServiceStarted = false;
+
+int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(HalClock::now() - timerEpoch).count();
+}
+
+static void timer_unschedule(esp_timer* timer) {
+  auto range = timerSchedule.equal_range(timer->deadlineUs);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == timer) {
+      timerSchedule.erase(it);
+      return;
+    }
+  }
+}
+
+static void timer_service() {
+  std::unique_lock<std::mutex> guard(timerLock);
+  while (true) {
+    if (timerSchedule.empty()) {
+      timerWake.wait(guard);
+      continue;
+    }
+    auto next = timerSchedule.begin();
+    int64_t now = esp_timer_get_time();
+    if (next->first > now) {
+      timerWake.wait_for(guard, std::chrono::microseconds(next->first - now));
+      continue;
+    }
+
+    esp_timer* timer = next->second;
+    timerSchedule.erase(next);
+    if (timer->periodUs > 0) {
+      timer->deadlineUs += timer->periodUs;
+      timerSchedule.emplace(timer->deadlineUs, timer);
+    } else {
+      timer->active = false;
+    }
+    // Callbacks may stop or re-arm timers, including their own
+    guard.unlock();
+    timer->callback(timer->arg);
+    guard.lock();
+  }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+  if (args == nullptr || args->callback == nullptr || handle == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> guard(timerLock);
+  if (!timerServiceStarted) {
+    std::thread(timer_service).detach();
+    timerServiceStarted = true;
+  }
+  *handle = new esp_timer{args->callback, args->arg, false, 0, 0};
+  return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t us, uint64_t periodUs) {
+  std::lock_guard<std::mutex> guard(timerLock);
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->active = true;
+  timer->periodUs = periodUs;
+  timer->deadlineUs = esp_timer_get_time() + (int64_t)us;
+  timerSchedule.emplace(timer->deadlineUs, timer);
+  timerWake.notify_one();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+  return timer_start(timer, timeoutUs, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+  return timer_start(timer, periodUs, periodUs);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> guard(timerLock);
+  if (!timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer_unschedule(timer);
+  timer->active = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> guard(timerLock);
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  delete timer;
+  return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+  std::lock_guard<std::mutex> guard(timerLock);
+  return timer->active;
+}
@@ -0,0 +1,6 @@
+#ifndef HAL_ESP_WIFI_H
+#define HAL_ESP_WIFI_H
+
+#include "esp_err.h"
+
+#endif
@@ -0,0 +1,111 @@
+#include "hal_clock.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <mutex>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+static std::atomic<int64_t> clockOffsetUs(0);   // firmware clock minus host clock
+static std::atomic<int64_t> clockSyncAtUs(-1);  // uptime of the pending HAL_CLOCK_SYNC_AFTER step
+static std::atomic<bool> clockStarted(false);
+
+// adjtime() slews as ESP-IDF's newlib does: the correction is applied at 1/64 of real time
+#define HAL_CLOCK_SLEW_SHIFT 6
+static std::mutex slewMutex;
+static int64_t slewStartUs;       // uptime the current adjustment began
+static int64_t slewDeltaUs;       // its full size; 0 when none is pending
+
+static int64_t host_now_us() {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Part of the pending adjustment applied by uptime nowUs; a finished one moves into the offset
+static int64_t slew_applied_us(int64_t nowUs) {
+  std::lock_guard<std::mutex> lock(slewMutex);
+  if (slewDeltaUs == 0) {
+    return 0;
+  }
+  int64_t elapsed = (nowUs - slewStartUs) >> HAL_CLOCK_SLEW_SHIFT;
+  if (elapsed < llabs(slewDeltaUs)) {
+    return slewDeltaUs < 0 ? -elapsed : elapsed;
+  }
+  clockOffsetUs += slewDeltaUs;
+  slewDeltaUs = 0;
+  return 0;
+}
+
+static int64_t clock_now_us() {
+  if (!clockStarted.exchange(true)) {
+    const char* syncAfter = getenv("HAL_CLOCK_SYNC_AFTER");
+    if (syncAfter != nullptr) {
+      clockOffsetUs = esp_timer_get_time() - host_now_us();
+      clockSyncAtUs = (int64_t)(atof(syncAfter) * 1e6);
+    }
+  }
+  int64_t syncAt = clockSyncAtUs.load();
+  if (syncAt >= 0 && esp_timer_get_time() >= syncAt && clockSyncAtUs.compare_exchange_strong(syncAt, -1)) {
+    clockOffsetUs = 0;
+  }
+  return host_now_us() + clockOffsetUs.load() + slew_applied_us(esp_timer_get_time());
+}
+
+static void slew_cancel() {
+  std::lock_guard<std::mutex> lock(slewMutex);
+  slewDeltaUs = 0;
+}
+
+void hal_clock_sync() {
+  slew_cancel();
+  clockStarted = true;
+  clockSyncAtUs = -1;
+  clockOffsetUs = 0;
+}
+
+extern "C" {
+
+time_t time(time_t* result) noexcept {
+  time_t now = (time_t)(clock_now_us() / 1000000);
+  if (result != nullptr) {
+    *result = now;
+  }
+  return now;
+}
+
+int gettimeofday(struct timeval* tv, void* tz) noexcept {
+  int64_t now = clock_now_us();
+  tv->tv_sec = (time_t)(now / 1000000);
+  tv->tv_usec = (suseconds_t)(now % 1000000);
+  return 0;
+}
+
+int settimeofday(const struct timeval* tv, const struct timezone* tz) noexcept {
+  if (tv != nullptr) {
+    clock_now_us();  // a set clock is not stepped again by HAL_CLOCK_SYNC_AFTER
+    clockSyncAtUs = -1;
+    slew_cancel();
+    clockOffsetUs = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - host_now_us();
+  }
+  return 0;
+}
+
+int adjtime(const struct timeval* delta, struct timeval* olddelta) noexcept {
+  int64_t nowUs = esp_timer_get_time();
+  int64_t applied = slew_applied_us(nowUs);
+  std::lock_guard<std::mutex> lock(slewMutex);
+  int64_t remaining = slewDeltaUs - applied;
+  if (olddelta != nullptr) {
+    olddelta->tv_sec = (time_t)(remaining / 1000000);
+    olddelta->tv_usec = (suseconds_t)(remaining % 1000000);
+  }
+  if (delta != nullptr) {
+    clockOffsetUs += applied;
+    slewStartUs = nowUs;
+    slewDeltaUs = (int64_t)delta->tv_sec * 1000000 + delta->tv_usec;
+  }
+  return 0;
+}
+
+}
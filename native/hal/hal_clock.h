@@ -0,0 +1,16 @@
+#ifndef HAL_CLOCK_H
+#define HAL_CLOCK_H
+
+// Wall clock of the native build: time(), gettimeofday() and settimeofday() are
+// replaced so the firmware sees its own clock, offset from the host's. adjtime() slews
+// it at 1/64 of real time, as on the ESP32.
+//   HAL_CLOCK_SYNC_AFTER=<s>  the clock starts unset (1970 + uptime, as on an ESP32 before
+//                             NTP or the RTC) and steps to host time after s seconds
+// settimeofday() and adjtime() move the firmware clock only; the host clock is never touched.
+
+#include <stdint.h>
+
+// Step to host time now, as a completed NTP sync would
+void hal_clock_sync();
+
+#endif
@@ -0,0 +1,269 @@
+#include "hal_freertos.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using HalClock = std::chrono::steady_clock;
+
+/******************************************************************
+ *                                                                *
+ *                            Tasks                               *
+ *                                                                *
+ ******************************************************************/
+
+struct HalTask {
+  std::string name;
+  std::mutex lock;
+  std::condition_variable wake;
+  uint32_t notifyValue = 0;
+  bool notifyPending = false;
+};
+
+// Thrown by vTaskDelete(NULL) to unwind the calling task's thread
+struct HalTaskExit {};
+
+static thread_local HalTask* halCurrentTask = nullptr;
+static const HalClock::time_point halEpoch = HalClock::now();
+
+// Deadline for a tick timeout; portMAX_DELAY waits forever
+static bool hal_wait_until(std::condition_variable& cv, std::unique_lock<std::mutex>& guard, TickType_t ticks,
+                           const std::function<bool()>& ready) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(guard, ready);
+    return true;
+  }
+  return cv.wait_for(guard, std::chrono::milliseconds(ticks), ready);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stackDepth, void* parameter,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+  HalTask* created = new HalTask();
+  created->name = (name != nullptr) ? name : "";
+  if (handle != nullptr) {
+    *handle = created;  // set before the task runs, as FreeRTOS does
+  }
+  std::thread([task, parameter, created]() {
+    halCurrentTask = created;
+    try {
+      task(parameter);
+    } catch (const HalTaskExit&) {
+    }
+    // The handle stays valid: other tasks may still hold it
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+  return xTaskCreate(task, name, stackDepth, parameter, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == nullptr || task == halCurrentTask) {
+    throw HalTaskExit();
+  }
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(HalClock::now() - halEpoch).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  // Threads not created by xTaskCreate (main, UART readers, the timer service) get a handle on first use
+  if (halCurrentTask == nullptr) {
+    halCurrentTask = new HalTask();
+  }
+  return halCurrentTask;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+  if (task == nullptr) {
+    return pdFAIL;
+  }
+  BaseType_t result = pdPASS;
+  {
+    std::lock_guard<std::mutex> guard(task->lock);
+    switch (action) {
+      case eNoAction:
+        break;
+      case eSetBits:
+        task->notifyValue |= value;
+        break;
+      case eIncrement:
+        task->notifyValue++;
+        break;
+      case eSetValueWithOverwrite:
+        task->notifyValue = value;
+        break;
+      case eSetValueWithoutOverwrite:
+        if (task->notifyPending) {
+          result = pdFAIL;
+        } else {
+          task->notifyValue = value;
+        }
+        break;
+    }
+    task->notifyPending = true;
+  }
+  task->wake.notify_all();
+  return result;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  return xTaskNotify(task, 0, eIncrement);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t* value, TickType_t ticks) {
+  HalTask* self = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> guard(self->lock);
+  if (!self->notifyPending) {
+    self->notifyValue &= ~clearOnEntry;
+  }
+  bool notified = hal_wait_until(self->wake, guard, ticks, [self]() { return self->notifyPending; });
+  if (value != nullptr) {
+    *value = self->notifyValue;
+  }
+  if (!notified) {
+    return pdFALSE;
+  }
+  self->notifyValue &= ~clearOnExit;
+  self->notifyPending = false;
+  return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  HalTask* self = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> guard(self->lock);
+  hal_wait_until(self->wake, guard, ticks, [self]() { return self->notifyValue != 0; });
+  uint32_t value = self->notifyValue;
+  if (value != 0) {
+    self->notifyValue = clearOnExit ? 0 : value - 1;
+  }
+  self->notifyPending = false;
+  return value;
+}
+
+/******************************************************************
+ *                                                                *
+ *                    Queues and semaphores                       *
+ *                                                                *
+ ******************************************************************/
+
+// Semaphores are queues with zero-sized items, as in FreeRTOS
+struct HalQueue {
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+  std::mutex lock;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HalQueue* queue = new HalQueue();
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete queue;
+}
+
+static BaseType_t hal_queue_send(QueueHandle_t queue, const void* item, TickType_t ticks, bool front) {
+  std::unique_lock<std::mutex> guard(queue->lock);
+  if (!hal_wait_until(queue->notFull, guard, ticks, [queue]() { return queue->items.size() < queue->length; })) {
+    return pdFAIL;
+  }
+  std::vector<uint8_t> copy(queue->itemSize);
+  if (queue->itemSize > 0) {
+    memcpy(copy.data(), item, queue->itemSize);
+  }
+  if (front) {
+    queue->items.push_front(std::move(copy));
+  } else {
+    queue->items.push_back(std::move(copy));
+  }
+  guard.unlock();
+  queue->notEmpty.notify_one();
+  return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+  return hal_queue_send(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticks) {
+  return hal_queue_send(queue, item, ticks, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+  std::unique_lock<std::mutex> guard(queue->lock);
+  if (!hal_wait_until(queue->notEmpty, guard, ticks, [queue]() { return !queue->items.empty(); })) {
+    return pdFALSE;
+  }
+  if (queue->itemSize > 0 && item != nullptr) {
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+  }
+  queue->items.pop_front();
+  guard.unlock();
+  queue->notFull.notify_one();
+  return pdTRUE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks) {
+  std::unique_lock<std::mutex> guard(queue->lock);
+  if (!hal_wait_until(queue->notEmpty, guard, ticks, [queue]() { return !queue->items.empty(); })) {
+    return pdFALSE;
+  }
+  if (queue->itemSize > 0 && item != nullptr) {
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+  }
+  return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->items.clear();
+  }
+  queue->notFull.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> guard(queue->lock);
+  return (UBaseType_t)queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> guard(queue->lock);
+  return queue->length - (UBaseType_t)queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+  xSemaphoreGive(mutex);  // a mutex starts available
+  return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+  SemaphoreHandle_t semaphore = xQueueCreate(maxCount, 0);
+  for (UBaseType_t i = 0; i < initialCount; i++) {
+    xSemaphoreGive(semaphore);
+  }
+  return semaphore;
+}
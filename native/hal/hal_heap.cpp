@@ -0,0 +1,60 @@
+#include "hal_heap.h"
+#include <atomic>
+#include <malloc.h>
+#include <new>
+#include <stdlib.h>
+
+static std::atomic<uint64_t> heapAllocations{0};
+static std::atomic<uint64_t> heapFrees{0};
+static std::atomic<size_t> heapInUse{0};
+static std::atomic<size_t> heapPeak{0};
+static thread_local uint64_t heapThreadAllocations = 0;
+
+static void* hal_heap_alloc(size_t size) {
+  void* p = malloc(size > 0 ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  size_t used = heapInUse += malloc_usable_size(p);
+  size_t peak = heapPeak.load();
+  while (used > peak && !heapPeak.compare_exchange_weak(peak, used)) {
+  }
+  heapAllocations++;
+  heapThreadAllocations++;
+  return p;
+}
+
+static void hal_heap_free(void* p) {
+  if (p == nullptr) {
+    return;
+  }
+  heapInUse -= malloc_usable_size(p);
+  heapFrees++;
+  free(p);
+}
+
+void* operator new(size_t size) { return hal_heap_alloc(size); }
+void* operator new[](size_t size) { return hal_heap_alloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return hal_heap_alloc(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* p) noexcept { hal_heap_free(p); }
+void operator delete[](void* p) noexcept { hal_heap_free(p); }
+void operator delete(void* p, size_t) noexcept { hal_heap_free(p); }
+void operator delete[](void* p, size_t) noexcept { hal_heap_free(p); }
+
+void hal_heap_get_stats(HalHeapStats* stats) {
+  stats->allocations = heapAllocations;
+  stats->frees = heapFrees;
+  stats->inUse = heapInUse;
+  stats->peak = heapPeak;
+}
+
+uint64_t hal_heap_thread_allocations() {
+  return heapThreadAllocations;
+}
@@ -0,0 +1,26 @@
+#ifndef HAL_HEAP_H
+#define HAL_HEAP_H
+
+// Heap accounting for operator new/delete (String, std containers, new'd objects).
+// malloc/calloc from C-style code is not counted.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef HAL_HEAP_SIZE
+#define HAL_HEAP_SIZE (320 * 1024)   // what esp_get_free_heap_size() counts down from
+#endif
+
+struct HalHeapStats {
+  uint64_t allocations;
+  uint64_t frees;
+  size_t inUse;
+  size_t peak;
+};
+
+void hal_heap_get_stats(HalHeapStats* stats);
+
+// Allocations made by the calling thread; differences give allocations per operation
+uint64_t hal_heap_thread_allocations();
+
+#endif
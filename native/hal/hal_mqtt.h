@@ -0,0 +1,27 @@
+#ifndef HAL_MQTT_H
+#define HAL_MQTT_H
+
+// In-process MQTT broker behind PubSubClient. Every accepted publish is handed to the
+// sink synchronously, on the publishing task, before publish() returns; harnesses use
+// it to count, time or capture traffic. Set HAL_MQTT_LOG=1 to print each message.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*HalMqttSink)(const char* topic, const uint8_t* payload, size_t length, void* context);
+
+struct HalMqttStats {
+  uint32_t connects;
+  uint32_t published;       // accepted by the broker
+  uint64_t payloadBytes;
+  uint32_t oversize;        // rejected: larger than the client buffer
+  uint32_t disconnected;    // rejected: client not connected
+};
+
+void hal_mqtt_set_sink(HalMqttSink sink, void* context);
+void hal_mqtt_get_stats(HalMqttStats* stats);
+
+// An unavailable broker refuses connections and drops connected clients
+void hal_mqtt_set_broker_available(bool available);
+
+#endif
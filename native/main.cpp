@@ -0,0 +1,143 @@
+#include "configuration.h"
+#include "data_logging.h"
+#include "modbus_rtu.h"
+#include "mqtt.h"
+#include "time_service.h"
+#include "hal_heap.h"
+#include "hal_mqtt.h"
+#include <strings.h>
+#include <unistd.h>
+#include <vector>
+
+// Native firmware: the configuration, logging and MQTT modules running against the
+// host HAL in native/hal. Channels come from NVS ($HAL_NVS_DIR) and from -c options;
+// Modbus devices are reached through the UARTs named by HAL_UART<n>.
+// Left out of unit test builds, which bring their own main().
+
+#ifndef PIO_UNIT_TESTING
+
+static const char* sensorTypeNames[] = {
+  "Unknown", "VibratingWire", "Barometric", "GeoPhone", "Inclinometer", "RainGauege",
+  "SinglePhaseMeter", "SRNEInverter",
+};
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-c channel:type:bus:interval]... [-t seconds]\n"
+          "  -c  enable a channel for this run; type is a SensorType name or number,\n"
+          "      interval is in seconds\n"
+          "  -t  stop after this many seconds and print statistics (default: run forever)\n",
+          program);
+}
+
+static bool parse_sensor_type(const char* text, SensorType* type) {
+  for (size_t i = 0; i < sizeof(sensorTypeNames) / sizeof(sensorTypeNames[0]); i++) {
+    if (strcasecmp(text, sensorTypeNames[i]) == 0) {
+      *type = (SensorType)i;
+      return true;
+    }
+  }
+  char* end;
+  long value = strtol(text, &end, 10);
+  if (*end != '\0' || value <= Unknown || value > SRNEInverter) {
+    return false;
+  }
+  *type = (SensorType)value;
+  return true;
+}
+
+// channel:type:bus:interval; applied to dataConfig in memory only, NVS is left as it was
+static bool apply_channel_option(const char* option) {
+  char type[24];
+  int channel, bus, interval;
+  if (sscanf(option, "%d:%23[^:]:%d:%d", &channel, type, &bus, &interval) != 4) {
+    return false;
+  }
+  SensorType sensorType;
+  if (channel < 0 || channel >= CHANNEL_COUNT_MAX || bus < 0 || bus >= RS485_BUS_COUNT || interval <= 0 ||
+      !parse_sensor_type(type, &sensorType)) {
+    return false;
+  }
+  for (int i = dataConfig.channel_count; i < channel; i++) {
+    dataConfig.channels[i] = {Unknown, 0, 0, false, 60};
+  }
+  dataConfig.channel_count = max((int)dataConfig.channel_count, channel + 1);
+  dataConfig.channels[channel] = {sensorType, 0, (uint8_t)bus, true, (uint16_t)interval};
+  return true;
+}
+
+static void print_statistics(unsigned long seconds) {
+  Serial.printf("\n*** Native run: %lu s ***\n", seconds);
+  for (int bus = 0; bus < RS485_BUS_COUNT; bus++) {
+    const ModbusPort* port = &rs485Buses[bus];
+    if (!port->initialized) {
+      continue;
+    }
+    Serial.printf("RS485 bus %d: %lu transactions, %lu timeouts, %lu CRC errors, %lu exceptions, timeout %lu ms\n",
+                  bus, (unsigned long)port->transactions, (unsigned long)port->timeouts,
+                  (unsigned long)port->crcErrors, (unsigned long)port->exceptions, (unsigned long)port->timeout_ms);
+  }
+
+  HalMqttStats mqtt;
+  hal_mqtt_get_stats(&mqtt);
+  Serial.printf("MQTT: %lu published (%llu payload bytes), %lu oversize, %lu while disconnected\n",
+                (unsigned long)mqtt.published, (unsigned long long)mqtt.payloadBytes, (unsigned long)mqtt.oversize,
+                (unsigned long)mqtt.disconnected);
+
+  HalHeapStats heap;
+  hal_heap_get_stats(&heap);
+  Serial.printf("Heap: %llu allocations, %zu bytes in use, %zu peak\n", (unsigned long long)heap.allocations,
+                heap.inUse, heap.peak);
+}
+
+int main(int argc, char** argv) {
+  long runSeconds = 0;
+  int option;
+  std::vector<const char*> channelOptions;
+  while ((option = getopt(argc, argv, "c:t:h")) != -1) {
+    switch (option) {
+      case 'c':
+        channelOptions.push_back(optarg);
+        break;
+      case 't':
+        runSeconds = atol(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+
+  // Same order as setup(), minus the hardware the host does not have
+  Serial.begin(115200);
+  Serial.println("\n------------------Booting (native)-------------------\n");
+
+  load_system_configuration();
+  loadDataConfigFromPreferences();
+  for (const char* channelOption : channelOptions) {
+    if (!apply_channel_option(channelOption)) {
+      fprintf(stderr, "invalid channel option '%s'\n", channelOption);
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  data_config_publish();
+
+  time_service_start();
+  log_data_init();
+  mqtt_initialize();
+
+  Serial.println("\n------------------Boot Completed----------------\n");
+
+  unsigned long start = millis();
+  while (runSeconds == 0 || millis() - start < (unsigned long)runSeconds * 1000) {
+    delay(100);
+  }
+  print_statistics((millis() - start) / 1000);
+  fflush(stdout);
+
+  // Tasks never return; leave without running static destructors under them
+  quick_exit(0);
+}
+
+#endif
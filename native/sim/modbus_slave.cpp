@@ -0,0 +1,325 @@
+#include "modbus_slave.h"
+#include "modbus_codec.h"
+#include "srne_inverter.h"
+#include "single_phase_meter.h"
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+struct SimRegister {
+  uint16_t address;
+  uint16_t value;
+};
+
+// Raw register values of a daytime SRNE inverter: battery charging from PV, load on the inverter
+static const SimRegister srneRegisterMap[] = {
+  {SRNE_REG_BATTERY_SOC, 85},
+  {SRNE_REG_BATTERY_VOLTAGE, 264},
+  {SRNE_REG_BATTERY_CURRENT, 52},
+  {SRNE_REG_PV_VOLTAGE, 1450},
+  {SRNE_REG_PV_CURRENT, 38},
+  {SRNE_REG_PV_POWER, 551},
+  {SRNE_REG_BATTERY_CHARGE_POWER, 540},
+  {SRNE_REG_BATTERY_TYPE, 2},
+  {SRNE_REG_BATTERY_OVER_VOLTAGE, 155},
+  {SRNE_REG_BATTERY_EQUALIZING_CHARGE_VOLTAGE, 146},
+  {SRNE_REG_BATTERY_BOOST_CHARGE_VOLTAGE, 144},
+  {SRNE_REG_BATTERY_FLOAT_CHARGE_VOLTAGE, 138},
+  {SRNE_REG_OVER_DISCHARGE_DELAY_TIME, 5},
+  {SRNE_REG_BATTERY_EQUALIZING_CHARGE_TIME, 120},
+  {SRNE_REG_BATTERY_EQUALIZING_INTERVAL, 30},
+  {SRNE_REG_BATTERY_UNDER_VOLTAGE_WARNING, 120},
+  {SRNE_REG_BATTERY_OVER_DISCHARGE_VOLTAGE, 110},
+  {SRNE_REG_BATTERY_LIMITED_DISCHARGE_VOLTAGE, 105},
+  {SRNE_REG_BATTERY_BOOST_CHARGE_TIME, 120},
+  {SRNE_REG_BATTERY_MAINS_SWITCHING_VOLTAGE, 115},
+  {SRNE_REG_BATTERY_STOP_CHARGING_CURRENT, 2},
+  {SRNE_REG_BATTERY_NUMBER_IN_SERIES, 2},
+  {SRNE_REG_INVERTER_SWITCH_VOLTAGE, 126},
+  {SRNE_REG_BATTERY_MAX_CHARGE_CURRENT, 600},
+  {SRNE_REG_INVERTER_OUTPUT_PRIORITY, 1},
+  {SRNE_REG_INVERTER_CHARGE_PRIORITY, 3},
+  {SRNE_REG_GRID_BATTERY_CHARGE_MAX_CURRENT, 300},
+  {SRNE_REG_INVERTER_ALARM_CONTROL, 1},
+  {SRNE_REG_MACHINE_STATE, 5},
+  {SRNE_REG_TOTAL_RUNNING_DAYS, 412},
+  {SRNE_REG_GRID_VOLTAGE, 2302},
+  {SRNE_REG_GRID_INPUT_CURRENT, 12},
+  {SRNE_REG_GRID_FREQUENCY, 5000},
+  {SRNE_REG_INVERTER_VOLTAGE, 2300},
+  {SRNE_REG_INVERTER_CURRENT, 31},
+  {SRNE_REG_INVERTER_FREQUENCY, 5000},
+  {SRNE_REG_LOAD_CURRENT, 29},
+  {SRNE_REG_INVERTER_POWER, 690},
+  {SRNE_REG_INVERTER_APPARENT_POWER, 712},
+  {SRNE_REG_GRID_BATTERY_CHARGE_CURRENT, 0},
+  {SRNE_REG_TEMP_DC, 352},
+  {SRNE_REG_TEMP_AC, 368},
+  {SRNE_REG_TEMP_TR, 401},
+  {SRNE_REG_PV_BATTERY_CHARGE_CURRENT, 210},
+};
+
+// 230.1 V, 5.2 A, 50.00 Hz at the meter's multipliers
+static const SimRegister meterRegisterMap[] = {
+  {SINGLE_PHASE_REG_VOLTAGE, 2301},
+  {SINGLE_PHASE_REG_CURRENT, 52},
+  {SINGLE_PHASE_REG_FREQUENCY, 5000},
+};
+
+/******************************************************************
+ *                                                                *
+ *                          Register map                          *
+ *                                                                *
+ ******************************************************************/
+
+static bool sim_address_illegal(const ModbusSlaveConfig* config, uint16_t address) {
+  for (size_t i = 0; i < config->illegalCount; i++) {
+    if (config->illegal[i] == address) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Firmware that ignores reads of an unimplemented register instead of raising an exception
+static bool sim_request_silent(const ModbusSlaveConfig* config, const uint8_t* request) {
+  uint16_t address = (request[2] << 8) | request[3];
+  uint16_t count = (request[4] << 8) | request[5];
+  for (size_t i = 0; i < config->silentCount; i++) {
+    if (config->silent[i] >= address && config->silent[i] - address < count) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool sim_lookup(const SimRegister* map, size_t count, uint16_t address, uint16_t* value) {
+  for (size_t i = 0; i < count; i++) {
+    if (map[i].address == address) {
+      *value = map[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool sim_read_register(const ModbusSlaveConfig* config, uint16_t address, uint16_t* value) {
+  if (sim_address_illegal(config, address)) {
+    return false;
+  }
+  return (config->srne && sim_lookup(srneRegisterMap, sizeof(srneRegisterMap) / sizeof(srneRegisterMap[0]),
+                                     address, value)) ||
+         (config->meter && sim_lookup(meterRegisterMap, sizeof(meterRegisterMap) / sizeof(meterRegisterMap[0]),
+                                      address, value));
+}
+
+// Builds the response to a valid request frame; returns its length
+static size_t sim_build_response(const ModbusSlaveConfig* config, const uint8_t* request, uint8_t* response) {
+  uint8_t function = request[1];
+  uint16_t address = (request[2] << 8) | request[3];
+  uint16_t count = (request[4] << 8) | request[5];
+  uint8_t exception = 0;
+
+  if (function != MODBUS_FC_READ_HOLDING_REGISTERS && function != MODBUS_FC_READ_INPUT_REGISTERS) {
+    exception = MODBUS_EX_ILLEGAL_FUNCTION;
+  } else if (count == 0 || count > MODBUS_MAX_READ_REGISTERS) {
+    exception = MODBUS_EX_ILLEGAL_DATA_VALUE;
+  }
+
+  size_t len = 0;
+  response[len++] = config->slaveId;
+  if (exception == 0) {
+    response[len++] = function;
+    response[len++] = (uint8_t)(count * 2);
+    for (uint16_t i = 0; i < count; i++) {
+      uint16_t value;
+      if (!sim_read_register(config, address + i, &value)) {
+        exception = MODBUS_EX_ILLEGAL_DATA_ADDRESS;
+        break;
+      }
+      response[len++] = value >> 8;
+      response[len++] = value & 0xFF;
+    }
+  }
+  if (exception != 0) {
+    len = 1;
+    response[len++] = function | 0x80;
+    response[len++] = exception;
+  }
+  return modbus_append_crc(response, len);
+}
+
+/******************************************************************
+ *                                                                *
+ *                              Line                              *
+ *                                                                *
+ ******************************************************************/
+
+// Time a frame occupies the line: 11 bits per character (start, 8 data, parity/stop, stop)
+static std::chrono::microseconds sim_frame_time(const ModbusSlaveConfig* config, size_t len) {
+  if (config->baud == 0) {
+    return std::chrono::microseconds(0);
+  }
+  return std::chrono::microseconds((uint64_t)len * 11 * 1000000 / config->baud);
+}
+
+static void sim_write(ModbusSlave* slave, const uint8_t* frame, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = write(slave->masterFd, frame + done, len - done);
+    if (n > 0) {
+      done += n;
+    } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+      return;
+    }
+  }
+}
+
+void modbus_slave_default_config(ModbusSlaveConfig* config) {
+  memset(config, 0, sizeof(*config));
+  config->slaveId = SRNE_MODBUS_SLAVE_ID;
+  config->srne = true;
+  config->meter = true;
+  config->baud = RS485_BUS0_BAUD;
+  config->latencyUs = 5000;
+  config->seed = 1;
+}
+
+bool modbus_slave_parse_addresses(const char* text, uint16_t* addresses, size_t* count) {
+  *count = 0;
+  const char* p = text;
+  while (*p != '\0') {
+    char* end;
+    unsigned long address = strtoul(p, &end, 0);
+    if (end == p || address > 0xFFFF || *count >= MODBUS_SLAVE_MAX_ILLEGAL) {
+      return false;
+    }
+    addresses[(*count)++] = (uint16_t)address;
+    p = (*end == ',') ? end + 1 : end;
+    if (*end != ',' && *end != '\0') {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool modbus_slave_open(ModbusSlave* slave, const ModbusSlaveConfig* config) {
+  slave->config = *config;
+  slave->masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (slave->masterFd < 0 || grantpt(slave->masterFd) != 0 || unlockpt(slave->masterFd) != 0) {
+    perror("modbus slave: posix_openpt");
+    return false;
+  }
+  const char* name = ptsname(slave->masterFd);
+  if (name == nullptr) {
+    return false;
+  }
+  snprintf(slave->slavePath, sizeof(slave->slavePath), "%s", name);
+
+  // Raw line from the start, so nothing the master writes is echoed back before it opens
+  slave->slaveFd = open(slave->slavePath, O_RDWR | O_NOCTTY);
+  if (slave->slaveFd < 0) {
+    return false;
+  }
+  struct termios tio;
+  tcgetattr(slave->slaveFd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave->slaveFd, TCSANOW, &tio);
+  slave->running = true;
+  return true;
+}
+
+void modbus_slave_close(ModbusSlave* slave) {
+  slave->running = false;
+  if (slave->slaveFd >= 0) {
+    close(slave->slaveFd);
+    slave->slaveFd = -1;
+  }
+  if (slave->masterFd >= 0) {
+    close(slave->masterFd);
+    slave->masterFd = -1;
+  }
+}
+
+void modbus_slave_run(ModbusSlave* slave) {
+  using Clock = std::chrono::steady_clock;
+  const ModbusSlaveConfig* config = &slave->config;
+  std::mt19937 rng(config->seed);
+  std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+  // Inter-frame silence that resynchronises a partial frame (3.5 characters, at least 2 ms)
+  auto t35 = std::max(std::chrono::microseconds(2000), sim_frame_time(config, 7) / 2);
+  uint8_t buffer[MODBUS_MAX_FRAME];
+  size_t len = 0;
+  Clock::time_point lastByte = Clock::now();
+
+  while (slave->running) {
+    struct pollfd pfd = {slave->masterFd, POLLIN, 0};
+    if (poll(&pfd, 1, 20) > 0 && (pfd.revents & POLLIN)) {
+      if (len > 0 && Clock::now() - lastByte > t35) {
+        len = 0;  // the rest of that frame never came
+      }
+      ssize_t n = read(slave->masterFd, buffer + len, sizeof(buffer) - len);
+      if (n <= 0) {
+        continue;
+      }
+      len += n;
+      lastByte = Clock::now();
+    }
+
+    // Requests are fixed 8-byte frames: slave, function, two 16-bit fields, CRC
+    while (len >= MODBUS_READ_REQUEST_SIZE) {
+      uint8_t request[MODBUS_READ_REQUEST_SIZE];
+      memcpy(request, buffer, sizeof(request));
+      memmove(buffer, buffer + sizeof(request), len - sizeof(request));
+      len -= sizeof(request);
+
+      if (!modbus_check_crc(request, sizeof(request))) {
+        slave->stats.badRequests++;
+        len = 0;
+        break;
+      }
+      if (request[0] != config->slaveId) {
+        slave->stats.badRequests++;
+        continue;
+      }
+      slave->stats.requests++;
+
+      // The last request byte arrives one frame time after the first
+      std::this_thread::sleep_for(sim_frame_time(config, sizeof(request)));
+
+      if (chance(rng) < config->timeoutRate || sim_request_silent(config, request)) {
+        slave->stats.timeouts++;
+        continue;
+      }
+
+      uint8_t response[MODBUS_MAX_FRAME];
+      size_t responseLen = sim_build_response(config, request, response);
+      if (response[1] & 0x80) {
+        slave->stats.exceptions++;
+      }
+      if (chance(rng) < config->crcErrorRate) {
+        response[responseLen - 1] ^= 0x5A;
+        slave->stats.crcErrors++;
+      }
+
+      uint32_t turnaround = config->latencyUs;
+      if (config->jitterUs > 0) {
+        turnaround += rng() % (config->jitterUs + 1);
+      }
+      // Deliver the response when its last byte would have arrived
+      std::this_thread::sleep_for(std::chrono::microseconds(turnaround) + sim_frame_time(config, responseLen));
+      sim_write(slave, response, responseLen);
+      slave->stats.responses++;
+    }
+  }
+}
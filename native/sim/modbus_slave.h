@@ -0,0 +1,62 @@
+#ifndef MODBUS_SLAVE_H
+#define MODBUS_SLAVE_H
+
+// Modbus RTU slave on a pseudo-terminal, serving the register maps of the devices in
+// srne_inverter.h and single_phase_meter.h. The firmware's master reaches it by opening
+// the pty's slave side (HAL_UART<n> in the native build). Faults are injected per request.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define MODBUS_SLAVE_MAX_ILLEGAL 32
+
+struct ModbusSlaveConfig {
+  uint8_t slaveId;
+  bool srne;                   // serve the SRNE inverter map
+  bool meter;                  // serve the single-phase meter map
+  uint32_t baud;               // pace frames at this line speed; 0 answers instantly
+  uint32_t latencyUs;          // device turnaround after the request has been received
+  uint32_t jitterUs;           // uniform extra turnaround, 0..jitterUs
+  float crcErrorRate;          // fraction of responses sent with a corrupted CRC
+  float timeoutRate;           // fraction of requests left unanswered
+  uint16_t illegal[MODBUS_SLAVE_MAX_ILLEGAL];  // addresses answered with ILLEGAL DATA ADDRESS
+  size_t illegalCount;
+  uint16_t silent[MODBUS_SLAVE_MAX_ILLEGAL];   // addresses whose reads are never answered
+  size_t silentCount;
+  uint32_t seed;
+};
+
+struct ModbusSlaveStats {
+  std::atomic<uint32_t> requests{0};
+  std::atomic<uint32_t> responses{0};
+  std::atomic<uint32_t> exceptions{0};
+  std::atomic<uint32_t> crcErrors{0};     // injected
+  std::atomic<uint32_t> timeouts{0};      // injected
+  std::atomic<uint32_t> badRequests{0};   // CRC errors and other slaves' frames on our side
+};
+
+struct ModbusSlave {
+  ModbusSlaveConfig config;
+  ModbusSlaveStats stats;
+  int masterFd;
+  int slaveFd;                 // kept open so the line does not hang up between opens
+  char slavePath[64];
+  std::atomic<bool> running;
+};
+
+void modbus_slave_default_config(ModbusSlaveConfig* config);
+
+// Parses "0xE004,0xE005,..." into addresses (room for MODBUS_SLAVE_MAX_ILLEGAL); false on
+// a malformed list
+bool modbus_slave_parse_addresses(const char* text, uint16_t* addresses, size_t* count);
+
+// Creates the pty; slave->slavePath is the device the master opens
+bool modbus_slave_open(ModbusSlave* slave, const ModbusSlaveConfig* config);
+
+// Serves requests until slave->running is cleared
+void modbus_slave_run(ModbusSlave* slave);
+
+void modbus_slave_close(ModbusSlave* slave);
+
+#endif
@@ -0,0 +1,96 @@
+#include "modbus_slave.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Standalone simulator: prints the pty to point the native firmware at, e.g.
+//   modbus_sim -l 20 -e 0.01 &
+//   HAL_UART2=/dev/pts/N .pio/build/native/program -c 0:SRNEInverter:0:10
+
+static ModbusSlave slave;
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-d srne|meter|both] [-i slave-id] [-b baud] [-l latency-ms] [-j jitter-ms]\n"
+          "          [-e crc-error-rate] [-t timeout-rate] [-x addr,addr,...] [-q addr,addr,...] [-s seed]\n"
+          "  -b 0 answers without line pacing; rates are fractions (0.01 = 1%%);\n"
+          "  -x answers reads of these addresses with ILLEGAL DATA ADDRESS, -q never answers them\n",
+          program);
+}
+
+static void on_signal(int signal) {
+  slave.running = false;
+}
+
+int main(int argc, char** argv) {
+  ModbusSlaveConfig config;
+  modbus_slave_default_config(&config);
+
+  int option;
+  while ((option = getopt(argc, argv, "d:i:b:l:j:e:t:x:q:s:h")) != -1) {
+    switch (option) {
+      case 'd':
+        config.srne = strcmp(optarg, "meter") != 0;
+        config.meter = strcmp(optarg, "srne") != 0;
+        break;
+      case 'i':
+        config.slaveId = (uint8_t)atoi(optarg);
+        break;
+      case 'b':
+        config.baud = (uint32_t)atol(optarg);
+        break;
+      case 'l':
+        config.latencyUs = (uint32_t)(atof(optarg) * 1000);
+        break;
+      case 'j':
+        config.jitterUs = (uint32_t)(atof(optarg) * 1000);
+        break;
+      case 'e':
+        config.crcErrorRate = atof(optarg);
+        break;
+      case 't':
+        config.timeoutRate = atof(optarg);
+        break;
+      case 'x':
+        if (!modbus_slave_parse_addresses(optarg, config.illegal, &config.illegalCount)) {
+          fprintf(stderr, "invalid address list '%s'\n", optarg);
+          return 2;
+        }
+        break;
+      case 'q':
+        if (!modbus_slave_parse_addresses(optarg, config.silent, &config.silentCount)) {
+          fprintf(stderr, "invalid address list '%s'\n", optarg);
+          return 2;
+        }
+        break;
+      case 's':
+        config.seed = (uint32_t)atol(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+
+  if (!modbus_slave_open(&slave, &config)) {
+    return 1;
+  }
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  printf("%s\n", slave.slavePath);
+  fflush(stdout);
+  fprintf(stderr, "Modbus slave %u (%s%s%s) at %u baud, %.1f ms turnaround\n", config.slaveId,
+          config.srne ? "SRNE inverter" : "", config.srne && config.meter ? " + " : "",
+          config.meter ? "single-phase meter" : "", config.baud, config.latencyUs / 1000.0);
+
+  modbus_slave_run(&slave);
+
+  fprintf(stderr, "%u requests, %u responses, %u exceptions, %u CRC errors and %u timeouts injected, %u bad frames\n",
+          slave.stats.requests.load(), slave.stats.responses.load(), slave.stats.exceptions.load(),
+          slave.stats.crcErrors.load(), slave.stats.timeouts.load(), slave.stats.badRequests.load());
+  modbus_slave_close(&slave);
+  return 0;
+}
@@ -2,6 +2,7 @@
 #include "utils.h"
 #include "AsyncJson.h"
 #include "configuration.h"
+#include "data_logging.h"
 #include "fileserver.h"
 #include "LoRaLite.h"
 #include "lora_network.h"
@@ -250,7 +251,7 @@ void getCollectionConfig(AsyncWebServerRequest *request) {
   
   // Serial.println("Received request for data collection configuring, ");
   
-  DataCollectionConfig config;
+  const DataCollectionConfig* config;
 
   if (!request->hasParam("device")){
     request->send(400, "application/json", "{\"error\":\"Device query parameter is missing\"}");
@@ -260,7 +261,7 @@ void getCollectionConfig(AsyncWebServerRequest *request) {
   String deviceName = request->getParam("device")->value();
     
   if (deviceName == "gateway") {
-    config = dataConfig;
+    config = data_config_acquire();
   }
   else if(isDeviceNameValid(deviceName)){
     // SD card access disabled - return error
@@ -277,15 +278,18 @@ void getCollectionConfig(AsyncWebServerRequest *request) {
 
   // Adding ADC configurations
   JsonArray adcArray = doc.to<JsonArray>();
-  for (int i = 0; i < config.channel_count; i++) {
+  for (int i = 0; i < config->channel_count; i++) {
+    const ChannelConfig* channel = &config->channels[i];
     JsonObject adcObj = adcArray.add<JsonObject>();
     adcObj["channel"] = i;
-    adcObj["pin"] = config.pin[i];
-    adcObj["sensor"] = config.type[i];
-    adcObj["enabled"] = config.enabled[i];
-    adcObj["interval"] = config.interval[i];
-    adcObj["time"] = convertTMtoString(config.time[i]);
+    adcObj["pin"] = channel->pin;
+    adcObj["sensor"] = channel->type;
+    adcObj["enabled"] = channel->enabled;
+    adcObj["interval"] = channel->interval;
+    adcObj["bus"] = channel->bus;
+    adcObj["time"] = convertTMtoString(data_logging_last_logged(i));
   }
+  data_config_release(config);
 
   // Serve the JSON document
   serveJson(request, doc, 200, false);
@@ -386,11 +390,24 @@ AsyncCallbackJsonWebHandler* updateCollectionConfig() {
     // Handle different device types
     if (deviceName == "gateway") {
 
-      // Error checking inside the function below
-      updateDataCollectionConfiguration(channel, "pin", pin);
-      updateDataCollectionConfiguration(channel, "sensor", sensor);
-      updateDataCollectionConfiguration(channel, "enabled", enabled);
-      updateDataCollectionConfiguration(channel, "interval", interval);
+      // All fields validated together and saved with one NVS write
+      DataConfigTransaction txn;
+      data_config_begin(&txn);
+      if (json.containsKey("channel_count")) {
+        data_config_stage_count(&txn, json["channel_count"].as<int>());
+      }
+      data_config_stage(&txn, channel, "pin", pin);
+      data_config_stage(&txn, channel, "sensor", sensor);
+      data_config_stage(&txn, channel, "enabled", enabled);
+      data_config_stage(&txn, channel, "interval", interval);
+      if (json.containsKey("bus")) {
+        data_config_stage(&txn, channel, "bus", json["bus"].as<int>());
+      }
+      const char* error = txn.error;
+      if (!data_config_commit(&txn)) {
+        request->send(400, "application/json", String("{\"error\":\"") + error + "\"}");
+        return;
+      }
       request->send(200); // Send an empty response with HTTP status code 200
 
     }
@@ -435,6 +452,22 @@ AsyncCallbackJsonWebHandler* updateSysConfig() {
     Serial.printf("Device: %s\n", deviceName.c_str());
     JsonObject jsonObj = json.as<JsonObject>();
 
+    // The gateway applies every key as one transaction: validated together, one NVS write
+    if (deviceName == "gateway") {
+      SystemConfigTransaction txn;
+      system_config_begin(&txn);
+      for (JsonPair kv : jsonObj) {
+        system_config_stage(&txn, kv.key().c_str(), kv.value().as<String>());
+      }
+      const char* error = txn.error;
+      if (!system_config_commit(&txn)) {
+        request->send(400, "application/json", String("{\"error\":\"") + error + "\"}");
+        return;
+      }
+      request->send(200);
+      return;
+    }
+
     // Iterate through the key-value pairs in the JSON object
     String key, value;
     for (JsonPair kv : jsonObj) {
@@ -442,11 +475,7 @@ AsyncCallbackJsonWebHandler* updateSysConfig() {
       key = kv.key().c_str();
       value = kv.value().as<String>();
 
-      if (deviceName == "gateway") {
-        // Call the update function with the extracted key and value
-        update_system_configuration(key, value);
-      }
-      else if(isDeviceNameValid(deviceName)){
+      if(isDeviceNameValid(deviceName)){
         
         // Implementation to send the configuration update to remote stations
         sysconfig_message msg;
@@ -0,0 +1,204 @@
+#include "bme280.h"
+#include "i2c_bus.h"
+
+// Registers
+#define BME280_REG_CALIB_TP 0x88     // 26 bytes: T1..T3, P1..P9, (reserved), H1
+#define BME280_REG_CHIP_ID 0xD0
+#define BME280_REG_RESET 0xE0
+#define BME280_REG_CALIB_H 0xE1      // 7 bytes: H2..H6
+#define BME280_REG_CTRL_HUM 0xF2
+#define BME280_REG_STATUS 0xF3
+#define BME280_REG_CTRL_MEAS 0xF4
+#define BME280_REG_CONFIG 0xF5
+#define BME280_REG_DATA 0xF7         // 8 bytes: pressure, temperature, humidity
+
+#define BME280_MODE_FORCED 0x01
+#define BME280_STATUS_MEASURING 0x08
+
+struct BME280Calibration {
+  uint16_t T1;
+  int16_t T2, T3;
+  uint16_t P1;
+  int16_t P2, P3, P4, P5, P6, P7, P8, P9;
+  uint8_t H1, H3;
+  int16_t H2, H4, H5;
+  int8_t H6;
+};
+
+// Cached per I2C bus at init
+static struct {
+  uint8_t address;     // 0 when no sensor was found
+  BME280Calibration calib;
+} bme280Sensors[I2C_BUS_COUNT];
+
+/******************************************************************
+ *                                                                *
+ *              Compensation (datasheet integer forms)            *
+ *                                                                *
+ ******************************************************************/
+
+static int32_t bme280_compensate_t(const BME280Calibration* c, int32_t adcT, int32_t* tFine) {
+  int32_t var1 = ((((adcT >> 3) - ((int32_t)c->T1 << 1))) * ((int32_t)c->T2)) >> 11;
+  int32_t var2 = (((((adcT >> 4) - ((int32_t)c->T1)) * ((adcT >> 4) - ((int32_t)c->T1))) >> 12) *
+                  ((int32_t)c->T3)) >> 14;
+  *tFine = var1 + var2;
+  return (*tFine * 5 + 128) >> 8;  // 0.01 degC
+}
+
+static uint32_t bme280_compensate_p(const BME280Calibration* c, int32_t adcP, int32_t tFine) {
+  int64_t var1 = ((int64_t)tFine) - 128000;
+  int64_t var2 = var1 * var1 * (int64_t)c->P6;
+  var2 = var2 + ((var1 * (int64_t)c->P5) << 17);
+  var2 = var2 + (((int64_t)c->P4) << 35);
+  var1 = ((var1 * var1 * (int64_t)c->P3) >> 8) + ((var1 * (int64_t)c->P2) << 12);
+  var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)c->P1) >> 33;
+  if (var1 == 0) {
+    return 0;  // avoid division by zero
+  }
+  int64_t p = 1048576 - adcP;
+  p = (((p << 31) - var2) * 3125) / var1;
+  var1 = (((int64_t)c->P9) * (p >> 13) * (p >> 13)) >> 25;
+  var2 = (((int64_t)c->P8) * p) >> 19;
+  p = ((p + var1 + var2) >> 8) + (((int64_t)c->P7) << 4);
+  return (uint32_t)p;  // Pa in Q24.8
+}
+
+static uint32_t bme280_compensate_h(const BME280Calibration* c, int32_t adcH, int32_t tFine) {
+  int32_t v = tFine - ((int32_t)76800);
+  v = (((((adcH << 14) - (((int32_t)c->H4) << 20) - (((int32_t)c->H5) * v)) + ((int32_t)16384)) >> 15) *
+       (((((((v * ((int32_t)c->H6)) >> 10) * (((v * ((int32_t)c->H3)) >> 11) + ((int32_t)32768))) >> 10) +
+          ((int32_t)2097152)) * ((int32_t)c->H2) + 8192) >> 14));
+  v = (v - (((((v >> 15) * (v >> 15)) >> 7) * ((int32_t)c->H1)) >> 4));
+  v = (v < 0) ? 0 : v;
+  v = (v > 419430400) ? 419430400 : v;
+  return (uint32_t)(v >> 12);  // %RH in Q22.10
+}
+
+/******************************************************************
+ *                                                                *
+ *                            Driver                              *
+ *                                                                *
+ ******************************************************************/
+
+static bool bme280_read_calibration(int bus, uint8_t address, BME280Calibration* c) {
+  uint8_t tp[26];
+  uint8_t h[7];
+  if (!i2c_read_registers(bus, address, BME280_REG_CALIB_TP, tp, sizeof(tp)) ||
+      !i2c_read_registers(bus, address, BME280_REG_CALIB_H, h, sizeof(h))) {
+    return false;
+  }
+  c->T1 = tp[0] | (tp[1] << 8);
+  c->T2 = (int16_t)(tp[2] | (tp[3] << 8));
+  c->T3 = (int16_t)(tp[4] | (tp[5] << 8));
+  c->P1 = tp[6] | (tp[7] << 8);
+  c->P2 = (int16_t)(tp[8] | (tp[9] << 8));
+  c->P3 = (int16_t)(tp[10] | (tp[11] << 8));
+  c->P4 = (int16_t)(tp[12] | (tp[13] << 8));
+  c->P5 = (int16_t)(tp[14] | (tp[15] << 8));
+  c->P6 = (int16_t)(tp[16] | (tp[17] << 8));
+  c->P7 = (int16_t)(tp[18] | (tp[19] << 8));
+  c->P8 = (int16_t)(tp[20] | (tp[21] << 8));
+  c->P9 = (int16_t)(tp[22] | (tp[23] << 8));
+  c->H1 = tp[25];
+  c->H2 = (int16_t)(h[0] | (h[1] << 8));
+  c->H3 = h[2];
+  c->H4 = (int16_t)(((int8_t)h[3] << 4) | (h[4] & 0x0F));
+  c->H5 = (int16_t)(((int8_t)h[5] << 4) | (h[4] >> 4));
+  c->H6 = (int8_t)h[6];
+  return true;
+}
+
+// Worst-case conversion time for the configured oversampling, in microseconds (datasheet 9.1)
+static uint32_t bme280_measurement_time_us() {
+  static const uint8_t samples[6] = {0, 1, 2, 4, 8, 16};
+  uint32_t us = 1250 + 2300 * samples[BME280_OVERSAMPLING_T];
+  if (BME280_OVERSAMPLING_P != BME280_OVERSAMPLING_SKIP) {
+    us += 2300 * samples[BME280_OVERSAMPLING_P] + 575;
+  }
+  if (BME280_OVERSAMPLING_H != BME280_OVERSAMPLING_SKIP) {
+    us += 2300 * samples[BME280_OVERSAMPLING_H] + 575;
+  }
+  return us;
+}
+
+bool bme280_init(int bus) {
+  if (!i2c_bus_init(bus)) {
+    return false;
+  }
+
+  const uint8_t candidates[2] = {BME280_ADDRESS_PRIMARY, BME280_ADDRESS_SECONDARY};
+  uint8_t address = 0;
+  for (int i = 0; i < 2 && address == 0; i++) {
+    uint8_t id = 0;
+    if (i2c_read_registers(bus, candidates[i], BME280_REG_CHIP_ID, &id, 1) && id == BME280_CHIP_ID) {
+      address = candidates[i];
+    }
+  }
+  if (address == 0) {
+    Serial.printf("BME280 not found on I2C bus %d\n", bus);
+    return false;
+  }
+
+  BME280Calibration calib;
+  if (!bme280_read_calibration(bus, address, &calib)) {
+    Serial.println("BME280: failed to read calibration");
+    return false;
+  }
+
+  // Sleep mode while configuring; config is only writable outside normal mode
+  i2c_write_register(bus, address, BME280_REG_CTRL_MEAS, 0x00);
+  i2c_write_register(bus, address, BME280_REG_CONFIG, BME280_FILTER << 2);
+  i2c_write_register(bus, address, BME280_REG_CTRL_HUM, BME280_OVERSAMPLING_H);
+
+  bme280Sensors[bus].address = address;
+  bme280Sensors[bus].calib = calib;
+  Serial.printf("BME280 found at 0x%02X on I2C bus %d\n", address, bus);
+  return true;
+}
+
+bool bme280_read(int bus, BME280Data* data) {
+  if (bus < 0 || bus >= I2C_BUS_COUNT || bme280Sensors[bus].address == 0) {
+    return false;
+  }
+  uint8_t address = bme280Sensors[bus].address;
+  const BME280Calibration* calib = &bme280Sensors[bus].calib;
+
+  // Start one forced conversion (ctrl_hum only latches on a ctrl_meas write)
+  uint8_t ctrlMeas = (BME280_OVERSAMPLING_T << 5) | (BME280_OVERSAMPLING_P << 2) | BME280_MODE_FORCED;
+  if (!i2c_write_register(bus, address, BME280_REG_CTRL_HUM, BME280_OVERSAMPLING_H) ||
+      !i2c_write_register(bus, address, BME280_REG_CTRL_MEAS, ctrlMeas)) {
+    return false;
+  }
+
+  // The bus stays free for other jobs while the sensor converts
+  vTaskDelay(pdMS_TO_TICKS((bme280_measurement_time_us() + 999) / 1000) + 1);
+
+  uint8_t status = 0;
+  for (int attempt = 0; attempt < 5; attempt++) {
+    if (!i2c_read_registers(bus, address, BME280_REG_STATUS, &status, 1)) {
+      return false;
+    }
+    if (!(status & BME280_STATUS_MEASURING)) {
+      break;
+    }
+    vTaskDelay(pdMS_TO_TICKS(2));
+  }
+
+  // Pressure, temperature and humidity in one burst read
+  uint8_t raw[8];
+  if (!i2c_read_registers(bus, address, BME280_REG_DATA, raw, sizeof(raw))) {
+    return false;
+  }
+  int32_t adcP = ((int32_t)raw[0] << 12) | ((int32_t)raw[1] << 4) | (raw[2] >> 4);
+  int32_t adcT = ((int32_t)raw[3] << 12) | ((int32_t)raw[4] << 4) | (raw[5] >> 4);
+  int32_t adcH = ((int32_t)raw[6] << 8) | raw[7];
+  if (adcT == 0x80000) {
+    return false;  // temperature skipped or no conversion yet
+  }
+
+  int32_t tFine;
+  data->temperature = bme280_compensate_t(calib, adcT, &tFine) / 100.0f;
+  data->pressure = (adcP == 0x80000) ? -9999.0f : bme280_compensate_p(calib, adcP, tFine) / 256.0f / 100.0f;
+  data->humidity = (adcH == 0x8000) ? -9999.0f : bme280_compensate_h(calib, adcH, tFine) / 1024.0f;
+  return true;
+}
@@ -1,15 +1,32 @@
 #include <Preferences.h>
+#include <atomic>
 #include <SD.h>
 #include <ArduinoJson.h>
 #include "configuration.h"
 #include "LoRaLite.h"
 #include "utils.h"
+#include "modbus_rtu.h"
+#include "i2c_bus.h"
 
 // Forward declaration
 void wifi_reconnect();
 
 Preferences preferences;
 
+// Serializes configuration transactions (HTTP handlers, LoRa handlers)
+static SemaphoreHandle_t configMutex = NULL;
+
+static void config_lock() {
+  if (configMutex == NULL) {
+    configMutex = xSemaphoreCreateMutex();
+  }
+  xSemaphoreTake(configMutex, portMAX_DELAY);
+}
+
+static void config_unlock() {
+  xSemaphoreGive(configMutex);
+}
+
 /******************************************************************
  *                                                                *
  *                          Save to SD Card                       *
@@ -103,68 +120,97 @@ void load_system_configuration() {
 
 }
 
-void update_system_configuration(String key, String value) {
-  Serial.println("Updating system configuration...");
+static void copy_config_string(char* field, size_t size, const String& value) {
+  strncpy(field, value.c_str(), size - 1);
+  field[size - 1] = '\0';
+}
 
-  preferences.begin("configurations", false);
+void system_config_begin(SystemConfigTransaction* txn) {
+  config_lock();
+  txn->working = systemConfig;
+  txn->error = nullptr;
+  txn->wifiChanged = false;
+  txn->mqttChanged = false;
+}
 
-  // Load existing configuration
-  if (preferences.isKey("sysconfig")) {
-    preferences.getBytes("sysconfig", &systemConfig, sizeof(systemConfig));
-  } else {
-    Serial.println("No existing configuration found.");
+bool system_config_stage(SystemConfigTransaction* txn, const String& key, const String& value) {
+  if (txn->error != nullptr) {
+    return false;
   }
-
-  // Update configuration based on key
+  SystemConfig* config = &txn->working;
   if (key.equals("WIFI_SSID")) {
-    strncpy(systemConfig.WIFI_SSID, value.c_str(), sizeof(systemConfig.WIFI_SSID) - 1);
-    systemConfig.WIFI_SSID[sizeof(systemConfig.WIFI_SSID) - 1] = '\0';
+    copy_config_string(config->WIFI_SSID, sizeof(config->WIFI_SSID), value);
+    txn->wifiChanged = true;
   } else if (key.equals("WIFI_PASSWORD")) {
-    strncpy(systemConfig.WIFI_PASSWORD, value.c_str(), sizeof(systemConfig.WIFI_PASSWORD) - 1);
-    systemConfig.WIFI_PASSWORD[sizeof(systemConfig.WIFI_PASSWORD) - 1] = '\0';
+    copy_config_string(config->WIFI_PASSWORD, sizeof(config->WIFI_PASSWORD), value);
+    txn->wifiChanged = true;
   } else if (key.equals("DEVICE_NAME")) {
-    if (value.length() > sizeof(systemConfig.DEVICE_NAME) - 1) {
-      Serial.println("Error: DEVICE_NAME should be shorter than 16 characters.");
-      preferences.end();
-      return;
+    if (value.length() > sizeof(config->DEVICE_NAME) - 1) {
+      txn->error = "DEVICE_NAME should be shorter than 16 characters";
+      return false;
     }
-    strncpy(systemConfig.DEVICE_NAME, value.c_str(), sizeof(systemConfig.DEVICE_NAME) - 1);
-    systemConfig.DEVICE_NAME[sizeof(systemConfig.DEVICE_NAME) - 1] = '\0';
+    copy_config_string(config->DEVICE_NAME, sizeof(config->DEVICE_NAME), value);
   } else if (key.equals("MQTT_SERVER")) {
-    strncpy(systemConfig.MQTT_SERVER, value.c_str(), sizeof(systemConfig.MQTT_SERVER) - 1);
-    systemConfig.MQTT_SERVER[sizeof(systemConfig.MQTT_SERVER) - 1] = '\0';
-    // Reinitialize MQTT with new server
-    extern void mqtt_reinit();
-    mqtt_reinit();
+    copy_config_string(config->MQTT_SERVER, sizeof(config->MQTT_SERVER), value);
+    txn->mqttChanged = true;
   } else if (key.equals("MQTT_USER")) {
-    strncpy(systemConfig.MQTT_USER, value.c_str(), sizeof(systemConfig.MQTT_USER) - 1);
-    systemConfig.MQTT_USER[sizeof(systemConfig.MQTT_USER) - 1] = '\0';
+    copy_config_string(config->MQTT_USER, sizeof(config->MQTT_USER), value);
+    txn->mqttChanged = true;
   } else if (key.equals("MQTT_PASSWORD")) {
-    strncpy(systemConfig.MQTT_PASSWORD, value.c_str(), sizeof(systemConfig.MQTT_PASSWORD) - 1);
-    systemConfig.MQTT_PASSWORD[sizeof(systemConfig.MQTT_PASSWORD) - 1] = '\0';
+    copy_config_string(config->MQTT_PASSWORD, sizeof(config->MQTT_PASSWORD), value);
+    txn->mqttChanged = true;
   } else if (key.equals("UTC_OFFSET")) {
-    systemConfig.utcOffset = value.toInt();
+    long offset = value.toInt();
+    if (offset < -12 || offset > 14) {
+      txn->error = "UTC_OFFSET out of range";
+      return false;
+    }
+    config->utcOffset = offset;
   } else if (key.equals("LORA_MODE")) {
-    systemConfig.LORA_MODE = value.toInt();
+    config->LORA_MODE = value.toInt();
   } else if (key.equals("PAIRING_KEY")) {
-    systemConfig.PAIRING_KEY = static_cast<uint32_t>(strtoul(value.c_str(), NULL, 10));
+    config->PAIRING_KEY = static_cast<uint32_t>(strtoul(value.c_str(), NULL, 10));
   } else {
-    Serial.println("Invalid key");
+    txn->error = "Invalid key";
+    return false;
   }
+  return true;
+}
 
-  // Save updated configuration
-  preferences.putBytes("sysconfig", &systemConfig, sizeof(systemConfig));
+bool system_config_commit(SystemConfigTransaction* txn) {
+  if (txn->error != nullptr) {
+    Serial.printf("System configuration not updated: %s.\n", txn->error);
+    config_unlock();
+    return false;
+  }
 
-  preferences.end();
+  // One blob write for the whole transaction, none if nothing changed
+  if (memcmp(&txn->working, &systemConfig, sizeof(systemConfig)) != 0) {
+    systemConfig = txn->working;
+    preferences.begin("configurations", false);
+    preferences.putBytes("sysconfig", &systemConfig, sizeof(systemConfig));
+    preferences.end();
+    Serial.println("System configuration updated.");
+  }
+  config_unlock();
 
-  // If WiFi credentials were updated, reconnect WiFi
-  if (key.equals("WIFI_SSID") || key.equals("WIFI_PASSWORD")) {
+  if (txn->mqttChanged) {
+    // Reinitialize MQTT with the new server or credentials
+    extern void mqtt_reinit();
+    mqtt_reinit();
+  }
+  if (txn->wifiChanged) {
     Serial.println("WiFi credentials updated. Reconnecting...");
     wifi_reconnect();
   }
+  return true;
+}
 
-  // load_system_configuration(); // reload configuration
-  // saveSystemConfigToSD();
+void update_system_configuration(String key, String value) {
+  SystemConfigTransaction txn;
+  system_config_begin(&txn);
+  system_config_stage(&txn, key, value);
+  system_config_commit(&txn);
 }
 
 
@@ -174,83 +220,329 @@ void update_system_configuration(String key, String value) {
  *                                                                *
  ******************************************************************/
 
-DataCollectionConfig dataConfig;
+// The writers' table: room for every channel number, so it is never reallocated
+static ChannelConfig dataConfigChannels[CHANNEL_COUNT_MAX];
+static uint16_t dataConfigEnabled[CHANNEL_COUNT_MAX];
+DataCollectionConfig dataConfig = {0, 0, dataConfigChannels, dataConfigEnabled, CHANNEL_COUNT_MAX};
+
+// Staged table of the open transaction; one at a time under the configuration lock
+static ChannelConfig workingChannels[CHANNEL_COUNT_MAX];
+
+// NVS blob of the 16 fixed channels, before the channel table (bus was appended last;
+// blobs without it load as bus 0)
+#define LEGACY_CHANNEL_COUNT 16
+struct LegacyDataCollectionConfig {
+  uint8_t channel_count;
+  SensorType type[LEGACY_CHANNEL_COUNT];
+  uint8_t pin[LEGACY_CHANNEL_COUNT];
+  bool enabled[LEGACY_CHANNEL_COUNT];
+  uint16_t interval[LEGACY_CHANNEL_COUNT];
+  uint32_t time[LEGACY_CHANNEL_COUNT];
+  uint8_t bus[LEGACY_CHANNEL_COUNT];
+};
+
+static_assert(sizeof(ChannelConfig) == 6, "ChannelConfig is the NVS record layout");
+
+static const ChannelConfig defaultChannel = {Unknown, 0, 0, false, 60};
+
+// Rebuild the list of enabled channels the pollers iterate
+static void data_config_index(DataCollectionConfig* config) {
+  config->enabled_count = 0;
+  for (uint16_t i = 0; i < config->channel_count; i++) {
+    if (config->channels[i].enabled) {
+      config->enabled[config->enabled_count++] = i;
+    }
+  }
+}
+
+size_t data_config_serialize(const DataCollectionConfig* config, uint8_t* buffer, size_t size) {
+  ChannelTableHeader header = {DATA_CONFIG_VERSION, sizeof(ChannelConfig), config->channel_count};
+  size_t length = sizeof(header) + config->channel_count * sizeof(ChannelConfig);
+  if (length > size) {
+    return 0;
+  }
+  memcpy(buffer, &header, sizeof(header));
+  memcpy(buffer + sizeof(header), config->channels, config->channel_count * sizeof(ChannelConfig));
+  return length;
+}
+
+// Caller holds the configuration lock, or is booting
+static void data_config_save() {
+  static uint8_t blob[DATA_CONFIG_BLOB_MAX];
+  size_t length = data_config_serialize(&dataConfig, blob, sizeof(blob));
+  preferences.begin("configurations", false);
+  preferences.putBytes("chtable", blob, length);
+  preferences.end();
+}
+
+/******************************************************************
+ *                                                                *
+ *                          Snapshots                             *
+ *                                                                *
+ ******************************************************************/
+
+// Published copies of dataConfig for the acquisition tasks, each sized to its table. A
+// commit fills a spare snapshot (or allocates one) and swaps it in; the one it replaces
+// is retired and turns spare once nobody holds it. Neither readers nor writers wait.
+struct DataConfigSnapshot {
+  DataCollectionConfig config;   // first: release() maps the pointer back to its snapshot
+  std::atomic<int> readers;
+  DataConfigSnapshot* next;      // on the retired or the spare list
+};
+static DataConfigSnapshot initialDataConfig;
+static std::atomic<DataConfigSnapshot*> currentDataConfig(&initialDataConfig);
+static std::atomic<int> dataConfigAcquiring(0);  // readers between loading current and counting in
+static DataConfigSnapshot* retiredDataConfigs = nullptr;  // lists under the configuration lock
+static DataConfigSnapshot* spareDataConfigs = nullptr;
+
+const DataCollectionConfig* data_config_acquire() {
+  // No retired snapshot is recycled while acquiring is nonzero, so the one loaded here is
+  // still valid when its count goes up, even if a commit retired it in between
+  dataConfigAcquiring++;
+  DataConfigSnapshot* snapshot = currentDataConfig.load();
+  snapshot->readers++;
+  dataConfigAcquiring--;
+  return &snapshot->config;
+}
+
+void data_config_release(const DataCollectionConfig* config) {
+  reinterpret_cast<DataConfigSnapshot*>(const_cast<DataCollectionConfig*>(config))->readers--;
+}
+
+// Copy dataConfig into a spare snapshot, growing its arrays if the table did
+static void data_config_snapshot_fill(DataCollectionConfig* snapshot) {
+  if (snapshot->capacity < dataConfig.channel_count) {
+    delete[] snapshot->channels;
+    delete[] snapshot->enabled;
+    snapshot->channels = new ChannelConfig[dataConfig.channel_count];
+    snapshot->enabled = new uint16_t[dataConfig.channel_count];
+    snapshot->capacity = dataConfig.channel_count;
+  }
+  snapshot->channel_count = dataConfig.channel_count;
+  snapshot->enabled_count = dataConfig.enabled_count;
+  memcpy(snapshot->channels, dataConfig.channels, dataConfig.channel_count * sizeof(ChannelConfig));
+  memcpy(snapshot->enabled, dataConfig.enabled, dataConfig.enabled_count * sizeof(uint16_t));
+}
+
+// Caller holds the configuration lock. Never waits: with every older snapshot still read
+// (logDataTask keeps one across a whole sweep) it allocates another.
+static void data_config_publish_locked() {
+  DataConfigSnapshot* snapshot = spareDataConfigs;
+  if (snapshot != nullptr) {
+    spareDataConfigs = snapshot->next;
+  } else {
+    snapshot = new DataConfigSnapshot();
+  }
+  data_config_snapshot_fill(&snapshot->config);
+  DataConfigSnapshot* previous = currentDataConfig.exchange(snapshot);
+  previous->next = retiredDataConfigs;
+  retiredDataConfigs = previous;
+
+  // A reader that loaded a retired snapshot is still inside acquire; try again next commit
+  if (dataConfigAcquiring.load() != 0) {
+    return;
+  }
+  DataConfigSnapshot** link = &retiredDataConfigs;
+  while (*link != nullptr) {
+    DataConfigSnapshot* retired = *link;
+    if (retired->readers.load() == 0) {
+      *link = retired->next;
+      retired->next = spareDataConfigs;
+      spareDataConfigs = retired;
+    } else {
+      link = &retired->next;
+    }
+  }
+}
+
+void data_config_publish() {
+  config_lock();
+  data_config_index(&dataConfig);
+  data_config_publish_locked();
+  config_unlock();
+}
+
+/******************************************************************
+ *                                                                *
+ *                        Load and migrate                        *
+ *                                                                *
+ ******************************************************************/
 
 void printDataConfig() {
   Serial.println("\n*** Data Collection Configuration ***");
+  Serial.printf("%d channels, %d enabled\n", dataConfig.channel_count, dataConfig.enabled_count);
 
-  // Print ADC configuration
-  for (int i = 0; i < CHANNEL_COUNT; i++) {
-    Serial.printf("Sensor %d pin %d: Enabled=%s, interval=%d, SensorType=%d\n",
-                  i, dataConfig.pin[i],dataConfig.enabled[i] ? "true" : "false",
-                  dataConfig.interval[i], dataConfig.type[i]);
+  for (uint16_t k = 0; k < dataConfig.enabled_count; k++) {
+    int i = dataConfig.enabled[k];
+    const ChannelConfig* channel = &dataConfig.channels[i];
+    Serial.printf("Sensor %d pin %d: interval=%d, SensorType=%d, bus=%d\n",
+                  i, channel->pin, channel->interval, channel->type, channel->bus);
   }
 
 }
 
+// Channel table of the current layout; false if missing or not readable
+static bool data_config_load_table() {
+  static uint8_t blob[DATA_CONFIG_BLOB_MAX];
+  if (!preferences.isKey("chtable")) {
+    return false;
+  }
+  size_t length = preferences.getBytesLength("chtable");
+  ChannelTableHeader header;
+  if (length < sizeof(header) || length > sizeof(blob) ||
+      preferences.getBytes("chtable", blob, sizeof(blob)) != length) {
+    Serial.println("Channel table unreadable.");
+    return false;
+  }
+  memcpy(&header, blob, sizeof(header));
+  if (header.version != DATA_CONFIG_VERSION || header.recordSize != sizeof(ChannelConfig) ||
+      header.channelCount > CHANNEL_COUNT_MAX || length != sizeof(header) + header.channelCount * sizeof(ChannelConfig)) {
+    Serial.printf("Channel table version %d (record %d bytes) not supported.\n", header.version, header.recordSize);
+    return false;
+  }
+  memcpy(dataConfig.channels, blob + sizeof(header), header.channelCount * sizeof(ChannelConfig));
+  dataConfig.channel_count = header.channelCount;
+  return true;
+}
+
+static bool data_config_migrate_legacy() {
+  if (!preferences.isKey("dataconfig")) {
+    return false;
+  }
+  LegacyDataCollectionConfig legacy = {};
+  preferences.getBytes("dataconfig", &legacy, sizeof(legacy));
+  for (int i = 0; i < LEGACY_CHANNEL_COUNT; i++) {
+    dataConfig.channels[i] = {legacy.type[i], legacy.pin[i], legacy.bus[i], legacy.enabled[i], legacy.interval[i]};
+  }
+  dataConfig.channel_count = LEGACY_CHANNEL_COUNT;
+  preferences.remove("dataconfig");
+  Serial.println("Data collection configuration migrated to the channel table.");
+  return true;
+}
+
 void loadDataConfigFromPreferences() {
   preferences.begin("configurations", false);
-  if (preferences.isKey("dataconfig")) {
-    preferences.getBytes("dataconfig", &dataConfig, sizeof(dataConfig));
-  } else {
-    Serial.println("Data collection configuration not found. Using default values.");
-
-    int channel_count = CHANNEL_COUNT;
+  bool loaded = data_config_load_table();
+  bool migrated = !loaded && data_config_migrate_legacy();
+  preferences.end();
 
-    // Initialize with default values
-    for (int i = 0; i < CHANNEL_COUNT; i++) {
-      dataConfig.pin[i] = 0;
-      dataConfig.type[i] = Unknown;
-      dataConfig.enabled[i] = false;
-      dataConfig.interval[i] = 60;
+  if (!loaded && !migrated) {
+    Serial.println("Data collection configuration not found. Using default values.");
+    for (int i = 0; i < CHANNEL_COUNT_DEFAULT; i++) {
+      dataConfig.channels[i] = defaultChannel;
     }
-
-    // Save default configuration to preferences
-    preferences.putBytes("dataconfig", &dataConfig, sizeof(dataConfig));
+    dataConfig.channel_count = CHANNEL_COUNT_DEFAULT;
   }
-  preferences.end();
+  if (!loaded) {
+    // Save the migrated or default table
+    data_config_save();
+  }
+  data_config_publish();
   
   // saveDataConfigToSD();
 
   printDataConfig();
 }
 
-void updateDataCollectionConfiguration(int channel, String key, int value) {
-  // Serial.println("Updating data collection configuration,");
-  Serial.print("key:");Serial.print(key);
-  Serial.print("; value:");Serial.println(value);
+/******************************************************************
+ *                                                                *
+ *                         Transactions                           *
+ *                                                                *
+ ******************************************************************/
 
-  if (!( channel >= 0 && channel < 16)){
-    Serial.println("Invalid channel.");
-  }
+void data_config_begin(DataConfigTransaction* txn) {
+  config_lock();
+  memcpy(workingChannels, dataConfig.channels, dataConfig.channel_count * sizeof(ChannelConfig));
+  txn->channelCount = dataConfig.channel_count;
+  txn->error = nullptr;
+}
 
-  if (key.equals("enabled")) {
-    dataConfig.enabled[channel] = value;
+bool data_config_stage_count(DataConfigTransaction* txn, int channelCount) {
+  if (txn->error != nullptr) {
+    return false;
   }
-  else if (key.equals("interval")) {
-    dataConfig.interval[channel] = value;
+  if (channelCount < 0 || channelCount > CHANNEL_COUNT_MAX) {
+    txn->error = "Invalid channel count";
+    return false;
   }
-  else if (key.equals("pin")) {
-    dataConfig.pin[channel] = value;
+  for (int i = txn->channelCount; i < channelCount; i++) {
+    workingChannels[i] = defaultChannel;
   }
-  else if (key.equals("sensor")) {
-    dataConfig.type[channel] = (SensorType) value;
+  txn->channelCount = channelCount;
+  return true;
+}
+
+bool data_config_stage(DataConfigTransaction* txn, int channel, const char* key, int value) {
+  if (txn->error != nullptr) {
+    return false;
+  }
+  Serial.printf("channel %d, key:%s; value:%d\n", channel, key, value);
+
+  if (channel < 0 || channel >= CHANNEL_COUNT_MAX) {
+    txn->error = "Invalid channel";
+    return false;
   }
-  else{
-    Serial.println("Invalid key.");
+  if (channel >= txn->channelCount) {
+    data_config_stage_count(txn, channel + 1);
   }
 
-  // Save updated configuration
-  preferences.begin("configurations", false);
-  if (preferences.isKey("dataconfig")) {
-    preferences.putBytes("dataconfig", &dataConfig, sizeof(dataConfig));
+  ChannelConfig* config = &workingChannels[channel];
+  if (strcmp(key, "enabled") == 0) {
+    config->enabled = value;
+  } else if (strcmp(key, "interval") == 0) {
+    if (value < 1 || value > UINT16_MAX) {
+      txn->error = "Invalid interval";
+    } else {
+      config->interval = value;
+    }
+  } else if (strcmp(key, "pin") == 0) {
+    if (value < 0 || value > UINT8_MAX) {
+      txn->error = "Invalid pin";
+    } else {
+      config->pin = value;
+    }
+  } else if (strcmp(key, "sensor") == 0) {
+    if (value < Unknown || value > SRNEInverter) {
+      txn->error = "Invalid sensor type";
+    } else {
+      config->type = (SensorType)value;
+    }
+  } else if (strcmp(key, "bus") == 0) {
+    if (value < 0 || value >= max(RS485_BUS_COUNT, I2C_BUS_COUNT)) {
+      txn->error = "Invalid bus";
+    } else {
+      config->bus = value;
+    }
   } else {
-    Serial.println("Data collection configuration not found. Update Failed.");
+    txn->error = "Invalid key";
   }
-  preferences.end();
-  // printDataConfig();
+  return txn->error == nullptr;
+}
 
-  // saveDataConfigToSD();
-  // loadDataConfigFromPreferences(); // reload into struct after update
-  // Serial.println("Finished updating data collection configuration.");
-}
\ No newline at end of file
+bool data_config_commit(DataConfigTransaction* txn) {
+  if (txn->error != nullptr) {
+    Serial.printf("Data collection configuration not updated: %s.\n", txn->error);
+    config_unlock();
+    return false;
+  }
+
+  if (txn->channelCount != dataConfig.channel_count ||
+      memcmp(workingChannels, dataConfig.channels, txn->channelCount * sizeof(ChannelConfig)) != 0) {
+    memcpy(dataConfig.channels, workingChannels, txn->channelCount * sizeof(ChannelConfig));
+    dataConfig.channel_count = txn->channelCount;
+    data_config_index(&dataConfig);
+    data_config_publish_locked();
+    data_config_save();
+    Serial.printf("Data collection configuration updated: %d channels, %d enabled.\n", dataConfig.channel_count,
+                  dataConfig.enabled_count);
+  }
+  config_unlock();
+  return true;
+}
+
+void updateDataCollectionConfiguration(int channel, String key, int value) {
+  DataConfigTransaction txn;
+  data_config_begin(&txn);
+  data_config_stage(&txn, channel, key.c_str(), value);
+  data_config_commit(&txn);
+}
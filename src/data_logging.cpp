@@ -7,122 +7,324 @@
 #include "single_phase_meter.h"
 #include "srne_inverter.h"
 #include "mqtt.h"
+#include "sensor_driver.h"
 
-// Sensor Libs
-#include <Adafruit_Sensor.h>
-#include <Adafruit_BME280.h>
+// Per-channel state, sized at init to the channel table: channels added later are not
+// initialized, so they are only polled after a restart. The same holds for a channel
+// whose sensor type or bus changes while running: init() ran for the old ones.
+struct ChannelState {
+  unsigned long lastLogTime;   // millis() / 1000 of the last poll
+  uint32_t lastLoggedEpoch;    // wall time of the last published sample
+  bool ready;                  // driver initialized
+  SensorType type;             // the type whose driver was initialized
+  uint8_t bus;                 // and the bus it was initialized on
+  bool staleReported;          // logDataTask noted the type change
+};
+static ChannelState* channelState = nullptr;
+static int channelStateCount = 0;
 
-unsigned long lastLogTime[CHANNEL_COUNT] = {0};
+// Samples read before the wall clock was first set: kept in binary form with their
+// acquisition stamps, and published once NTP, the RTC or a LoRa time sync sets the clock
+struct BackloggedSample {
+  int channel;
+  const SensorDriver* driver;
+  SensorSample sample;
+};
+static QueueHandle_t sampleBacklog = NULL;
+static uint32_t sampleBacklogDropped = 0;
+static portMUX_TYPE sampleBacklogMux = portMUX_INITIALIZER_UNLOCKED;
 
-float generateRandomFloat(float minVal, float maxVal) {
-  uint32_t randomValue = esp_random();
-  float scaledValue = (float)randomValue / (float)UINT32_MAX; // Scale to [0, 1]
-  return minVal + scaledValue * (maxVal - minVal); // Scale to [minVal, maxVal]
+// Polling decisions use the snapshot the task took for this cycle, so a configuration
+// commit applies to a channel all at once, between cycles
+static bool channel_initialized(const DataCollectionConfig* config, int channel) {
+  return channel < channelStateCount && channelState[channel].ready &&
+         channelState[channel].type == config->channels[channel].type &&
+         channelState[channel].bus == config->channels[channel].bus;
 }
 
-void logDataFunction(int channel, String timestamp) {
-  float sensorValue = 0.0f;
-  const char* sensorTypeStr = "Unknown";
-  
-  // Read sensor data based on sensor type
-  switch (dataConfig.type[channel]) {
-    case SinglePhaseMeter:
-      sensorTypeStr = "SinglePhaseMeter";
-      // Publish all meter data as JSON
-      if (!publish_single_phase_meter_data(channel, timestamp.c_str())) {
-        Serial.printf("Channel %d: Failed to read/publish single phase meter data\n", channel);
-        return;  // Skip if read/publish failed
-      }
-      break;
-      
-    case SRNEInverter:
-      sensorTypeStr = "SRNEInverter";
-      // Publish all inverter data as JSON
-      if (!publish_srne_inverter_data(channel, timestamp.c_str())) {
-        Serial.printf("Channel %d: Failed to read/publish SRNE inverter data\n", channel);
-        return;  // Skip if read/publish failed
-      }
-      break;
-      
-    case VibratingWire:
-      // TODO: Implement vibrating wire reading
-      sensorValue = generateRandomFloat(7000, 8000);
-      sensorTypeStr = "VibratingWire";
-      // Publish directly to MQTT (no SD card)
-      publish_sensor_data(channel, sensorTypeStr, sensorValue, timestamp.c_str());
-      break;
-      
-    case Barometric:
-      // TODO: Implement barometric sensor reading
-      sensorValue = generateRandomFloat(950, 1050);
-      sensorTypeStr = "Barometric";
-      // Publish directly to MQTT (no SD card)
-      publish_sensor_data(channel, sensorTypeStr, sensorValue, timestamp.c_str());
-      break;
-      
-    default:
-      Serial.printf("Channel %d: Unknown sensor type\n", channel);
-      return;
+static bool channel_due(const DataCollectionConfig* config, int channel, unsigned long currentTime) {
+  return channel_initialized(config, channel) && config->channels[channel].enabled &&
+         (currentTime - channelState[channel].lastLogTime >= config->channels[channel].interval);
+}
+
+// Once per channel, from logDataTask only
+static void report_stale_channel(const DataCollectionConfig* config, int channel) {
+  if (channel >= channelStateCount) {
+    return;
   }
-  
-  // Update latest data in dataconfig
+  ChannelState* state = &channelState[channel];
+  if (!state->ready || channel_initialized(config, channel) || state->staleReported) {
+    return;
+  }
+  state->staleReported = true;
+  Serial.printf("Channel %d: sensor type/bus changed from %d/%d to %d/%d, polling resumes after a restart\n",
+                channel, state->type, state->bus, config->channels[channel].type, config->channels[channel].bus);
+}
+
+static void channel_logged(int channel) {
   time_t now;
   time(&now);  // Get the current time as time_t (epoch time)
-  dataConfig.time[channel] = now;
+  channelState[channel].lastLoggedEpoch = now;
+}
+
+uint32_t data_logging_last_logged(int channel) {
+  if (channel < 0 || channel >= channelStateCount) {
+    return 0;
+  }
+  return channelState[channel].lastLoggedEpoch;
+}
+
+// Publish now, or keep the sample until its timestamp can be resolved; the oldest
+// sample makes room when the backlog is full
+static bool publish_or_backlog(int channel, const SensorDriver* driver, const SensorSample* sample) {
+  if (time_wall_valid()) {
+    return publish_sensor_sample(channel, driver, sample);
+  }
+  BackloggedSample entry = {channel, driver, *sample};
+  if (xQueueSend(sampleBacklog, &entry, 0) != pdTRUE) {
+    BackloggedSample oldest;
+    xQueueReceive(sampleBacklog, &oldest, 0);
+    xQueueSend(sampleBacklog, &entry, 0);
+    portENTER_CRITICAL(&sampleBacklogMux);
+    sampleBacklogDropped++;
+    portEXIT_CRITICAL(&sampleBacklogMux);
+  }
+  return true;
+}
+
+// Called by every polling task; whichever sees the clock set first publishes the backlog
+static void drain_sample_backlog() {
+  if (uxQueueMessagesWaiting(sampleBacklog) == 0 || !time_wall_valid()) {
+    return;
+  }
+  int published = 0;
+  BackloggedSample entry;
+  while (xQueueReceive(sampleBacklog, &entry, 0) == pdTRUE) {
+    published += publish_sensor_sample(entry.channel, entry.driver, &entry.sample) ? 1 : 0;
+  }
+  Serial.printf("Published %d samples read before time sync, %lu dropped while the backlog was full\n", published,
+                (unsigned long)sampleBacklogDropped);
+}
+
+void logDataFunction(const DataCollectionConfig* config, int channel) {
+  const ChannelConfig* channelConfig = &config->channels[channel];
+  const SensorDriver* driver = sensor_driver(channelConfig->type);
+  if (driver == nullptr) {
+    Serial.printf("Channel %d: Unknown sensor type\n", channel);
+    return;
+  }
+
+  bool published;
+  if (driver->publish != nullptr) {
+    if (!time_wall_valid()) {
+      return;  // the driver keeps the acquisition and its stamp until the clock is set
+    }
+    published = driver->publish(channel, channelConfig);
+  } else {
+    SensorSample sample;
+    sample.count = driver->pointCount;
+    sample.acquiredUs = esp_timer_get_time();
+    published = driver->read(channel, channelConfig, &sample) && publish_or_backlog(channel, driver, &sample);
+  }
+  if (!published) {
+    Serial.printf("Channel %d: Failed to read/publish %s data\n", channel, driver->name);
+    return;  // Skip if read/publish failed
+  }
+
+  // Update latest data in dataconfig
+  channel_logged(channel);
+}
+
+// One readBatch() call, stamped with the start of the pass
+static void logDataChunk(const DataCollectionConfig* config, const SensorDriver* driver, const int* channels,
+                         size_t count, unsigned long currentTime) {
+  const ChannelConfig* configs[SENSOR_BATCH_MAX];
+  for (size_t k = 0; k < count; k++) {
+    configs[k] = &config->channels[channels[k]];
+  }
+  SensorSample samples[SENSOR_BATCH_MAX];
+  int64_t acquiredUs = esp_timer_get_time();
+  unsigned long start = millis();
+  size_t good = driver->readBatch(channels, configs, count, samples);
+  Serial.printf("%s batch: %d/%d channels in %lu ms\n", driver->name, (int)good, (int)count, millis() - start);
+
+  for (size_t k = 0; k < count; k++) {
+    int channel = channels[k];
+    channelState[channel].lastLogTime = currentTime;
+    samples[k].acquiredUs = acquiredUs;
+    if (samples[k].count > 0 && publish_or_backlog(channel, driver, &samples[k])) {
+      channel_logged(channel);
+    }
+  }
+}
+
+// Every due channel of a batching driver is read in passes of up to SENSOR_BATCH_MAX
+// (vibrating-wire gauges share the VM501 through the mux)
+static void logDataBatch(const DataCollectionConfig* config, SensorType type, const SensorDriver* driver,
+                         unsigned long currentTime) {
+  int channels[SENSOR_BATCH_MAX];
+  size_t count = 0;
+  for (uint16_t k = 0; k < config->enabled_count; k++) {
+    int i = config->enabled[k];
+    if (config->channels[i].type != type || !channel_due(config, i, currentTime)) {
+      continue;
+    }
+    channels[count++] = i;
+    if (count == SENSOR_BATCH_MAX) {
+      logDataChunk(config, driver, channels, count, currentTime);
+      count = 0;
+    }
+  }
+  if (count > 0) {
+    logDataChunk(config, driver, channels, count, currentTime);
+  }
 }
 
 void logDataTask(void *parameter) {
   while (true) {
+    drain_sample_backlog();
     unsigned long currentTime = millis() / 1000; // Convert milliseconds to seconds
+    const DataCollectionConfig* config = data_config_acquire();
 
-    for (int i = 0; i < CHANNEL_COUNT; i++) {
-      if (dataConfig.enabled[i] && (currentTime - lastLogTime[i] >= dataConfig.interval[i])) {
-        logDataFunction(i, get_current_time(false));
-        lastLogTime[i] = currentTime;
+    for (uint16_t k = 0; k < config->enabled_count; k++) {
+      int i = config->enabled[k];
+      report_stale_channel(config, i);
+      if (!channel_due(config, i, currentTime)) {
+        continue;
+      }
+      const SensorDriver* driver = sensor_driver(config->channels[i].type);
+      if (driver == nullptr || driver->affinity != SENSOR_AFFINITY_LOCAL) {
+        continue;
+      }
+      if (driver->readBatch != nullptr) {
+        logDataBatch(config, config->channels[i].type, driver, currentTime);
+      } else {
+        logDataFunction(config, i);
+        channelState[i].lastLogTime = currentTime;
       }
       vTaskDelay(100 / portTICK_PERIOD_MS); // Delay for 100 milliseconds
     }
+    data_config_release(config);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
   }
 }
 
-void log_data_init() {
+// One task per RS485 bus, so devices on different buses are polled concurrently
+void rs485BusTask(void *parameter) {
+  int bus = (int)(intptr_t)parameter;
 
-  Serial.println("Initializing data logging (MQTT mode - no SD card).");
-  
-  // Initialize single phase meter if any channel uses it
-  bool hasSinglePhaseMeter = false;
-  for (int i = 0; i < CHANNEL_COUNT; i++) {
-    if (dataConfig.enabled[i] && dataConfig.type[i] == SinglePhaseMeter) {
-      hasSinglePhaseMeter = true;
-      break;
+  while (true) {
+    drain_sample_backlog();
+    unsigned long currentTime = millis() / 1000; // Convert milliseconds to seconds
+    const DataCollectionConfig* config = data_config_acquire();
+
+    // Device list: enabled Modbus channels assigned to this bus
+    for (uint16_t k = 0; k < config->enabled_count; k++) {
+      int i = config->enabled[k];
+      if (!channel_due(config, i, currentTime) || config->channels[i].bus != bus) {
+        continue;
+      }
+      const SensorDriver* driver = sensor_driver(config->channels[i].type);
+      if (driver != nullptr && driver->affinity == SENSOR_AFFINITY_RS485) {
+        logDataFunction(config, i);
+        channelState[i].lastLogTime = currentTime;
+      }
     }
+    data_config_release(config);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
   }
-  
-  if (hasSinglePhaseMeter) {
-    single_phase_meter_init();
+}
+
+// Fraction of each polling task's time the configured channels are expected to take
+static void log_load_estimate(const DataCollectionConfig* config, const bool* busUsed) {
+  float localLoad = 0;
+  float busLoad[RS485_BUS_COUNT] = {0};
+  for (uint16_t k = 0; k < config->enabled_count; k++) {
+    int i = config->enabled[k];
+    if (!channelState[i].ready) {
+      continue;
+    }
+    const ChannelConfig* channel = &config->channels[i];
+    const SensorDriver* driver = sensor_driver(channel->type);
+    float load = driver->costMs / (1000.0f * max(1, (int)channel->interval));
+    if (driver->affinity == SENSOR_AFFINITY_RS485) {
+      busLoad[channel->bus] += load;
+    } else {
+      localLoad += load;
+    }
   }
-  
-  // Initialize SRNE inverter if any channel uses it
-  bool hasSRNEInverter = false;
-  for (int i = 0; i < CHANNEL_COUNT; i++) {
-    if (dataConfig.enabled[i] && dataConfig.type[i] == SRNEInverter) {
-      hasSRNEInverter = true;
-      break;
+  Serial.printf("Estimated load: local sensors %.0f%%\n", localLoad * 100);
+  for (int bus = 0; bus < RS485_BUS_COUNT; bus++) {
+    if (busUsed[bus]) {
+      Serial.printf("Estimated load: RS485 bus %d %.0f%%\n", bus, busLoad[bus] * 100);
     }
   }
+  if (localLoad > 1.0f) {
+    Serial.println("Warning: local sensors cannot all be read at their configured intervals");
+  }
+  for (int bus = 0; bus < RS485_BUS_COUNT; bus++) {
+    if (busLoad[bus] > 1.0f) {
+      Serial.printf("Warning: RS485 bus %d cannot poll all devices at their configured intervals\n", bus);
+    }
+  }
+}
+
+void log_data_init() {
+
+  Serial.println("Initializing data logging (MQTT mode - no SD card).");
+  sampleBacklog = xQueueCreate(SAMPLE_BACKLOG_LENGTH, sizeof(BackloggedSample));
+
+  // Channels are bound to the snapshot current now; the tasks compare theirs against it
+  const DataCollectionConfig* config = data_config_acquire();
+  channelStateCount = config->channel_count;
+  channelState = new ChannelState[channelStateCount]();
   
-  if (hasSRNEInverter) {
-    srne_inverter_init();
+  // Modbus devices first, on the bus each channel is assigned to
+  bool busUsed[RS485_BUS_COUNT] = {false};
+  for (uint16_t k = 0; k < config->enabled_count; k++) {
+    int i = config->enabled[k];
+    const SensorDriver* driver = sensor_driver(config->channels[i].type);
+    if (driver == nullptr || driver->affinity != SENSOR_AFFINITY_RS485) {
+      continue;
+    }
+    int bus = config->channels[i].bus;
+    if (!rs485_bus_available(bus)) {
+      Serial.printf("Channel %d: RS485 bus %d not available, channel ignored\n", i, bus);
+      continue;
+    }
+    channelState[i].type = config->channels[i].type;
+    channelState[i].bus = config->channels[i].bus;
+    channelState[i].ready = driver->init(i, &config->channels[i]);
+    busUsed[bus] |= channelState[i].ready;
   }
 
-  // Print enabled channels
-  for (int i = 0; i < CHANNEL_COUNT; i++) {
-    if (dataConfig.enabled[i]) {
-      Serial.printf("Channel %d: Enabled, Type: %d, Interval: %d minutes\n", 
-                    i, dataConfig.type[i], dataConfig.interval[i]);
+  // Then everything polled by logDataTask
+  for (uint16_t k = 0; k < config->enabled_count; k++) {
+    int i = config->enabled[k];
+    const SensorDriver* driver = sensor_driver(config->channels[i].type);
+    if (driver == nullptr || driver->affinity != SENSOR_AFFINITY_LOCAL) {
+      continue;
     }
+    for (int bus = 0; bus < RS485_BUS_COUNT; bus++) {
+      if ((driver->rs485Conflicts & (1 << bus)) && busUsed[bus]) {
+        Serial.printf("Warning: channel %d (%s) shares pins/UART with RS485 bus %d\n", i, driver->name, bus);
+      }
+    }
+    channelState[i].type = config->channels[i].type;
+    channelState[i].bus = config->channels[i].bus;
+    channelState[i].ready = driver->init(i, &config->channels[i]);
   }
 
+  log_load_estimate(config, busUsed);
+
+  // Print enabled channels
+  for (uint16_t k = 0; k < config->enabled_count; k++) {
+    int i = config->enabled[k];
+    Serial.printf("Channel %d: Enabled, Type: %d, Interval: %d minutes\n", 
+                  i, config->channels[i].type, config->channels[i].interval);
+  }
+  data_config_release(config);
+
   xTaskCreate(
     logDataTask,        // Task function
     "Log Data Task",    // Name of the task (for debugging)
@@ -133,4 +335,21 @@ void log_data_init() {
   );
   Serial.println("Added Data Logging Task (MQTT direct mode).");
 
+  for (int bus = 0; bus < RS485_BUS_COUNT; bus++) {
+    if (!busUsed[bus]) {
+      continue;
+    }
+    char taskName[16];
+    snprintf(taskName, sizeof(taskName), "RS485 Bus %d", bus);
+    xTaskCreate(
+      rs485BusTask,             // Task function
+      taskName,                 // Name of the task (for debugging)
+      8192,                     // Stack size (in words, not bytes)
+      (void *)(intptr_t)bus,    // Task input parameter: bus index
+      1,                        // Priority of the task
+      NULL                      // Task handle
+    );
+    Serial.printf("Added RS485 bus %d polling task.\n", bus);
+  }
+
 }
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "geophone.h"
+#include "driver/i2s.h"
+#include "driver/adc.h"
+
+#define GEOPHONE_I2S_PORT I2S_NUM_0
+
+static bool geophoneInitialized = false;
+
+// Ring of sample blocks; slots travel between the two tasks as indices
+static int16_t geophoneRing[GEOPHONE_RING_SLOTS][GEOPHONE_BLOCK_SAMPLES];
+static int64_t geophoneRingUs[GEOPHONE_RING_SLOTS];      // DMA completion stamp of each slot
+static int16_t geophoneScratch[GEOPHONE_BLOCK_SAMPLES];  // DMA drain target when the ring is full
+static QueueHandle_t geophoneFreeSlots;
+static QueueHandle_t geophoneFullSlots;
+static QueueHandle_t geophoneI2sEvents;
+
+static struct {
+  GeophoneConsumer consumer;
+  void* context;
+} geophoneConsumers[GEOPHONE_MAX_CONSUMERS];
+static int geophoneConsumerCount = 0;
+
+static portMUX_TYPE geophoneMux = portMUX_INITIALIZER_UNLOCKED;
+static GeophoneStats geophoneStats;
+
+// Analysis window filled block by block, and the features of the current reporting interval
+static float geophoneWindow[GEOPHONE_FFT_SIZE];
+static size_t geophoneWindowFill = 0;
+static GeophoneFeatures geophoneFeatures;
+
+/******************************************************************
+ *                                                                *
+ *                          Acquisition                           *
+ *                                                                *
+ ******************************************************************/
+
+void geophoneAcquisitionTask(void* parameter) {
+  int64_t rateWindowStart = esp_timer_get_time();
+  uint32_t rateWindowSamples = 0;
+
+  while (true) {
+    i2s_event_t event;
+    if (xQueueReceive(geophoneI2sEvents, &event, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    if (event.type == I2S_EVENT_RX_Q_OVF || event.type == I2S_EVENT_DMA_ERROR) {
+      portENTER_CRITICAL(&geophoneMux);
+      geophoneStats.dmaOverflows++;
+      portEXIT_CRITICAL(&geophoneMux);
+      continue;
+    }
+    if (event.type != I2S_EVENT_RX_DONE) {
+      continue;
+    }
+    // Stamped here, not on the processing task, which may be several queued blocks behind
+    int64_t blockUs = esp_timer_get_time();
+
+    // One DMA buffer is complete: move it out of the driver in a single block copy
+    int slot;
+    bool haveSlot = (xQueueReceive(geophoneFreeSlots, &slot, 0) == pdTRUE);
+    int16_t* target = haveSlot ? geophoneRing[slot] : geophoneScratch;
+    size_t bytesRead = 0;
+    i2s_read(GEOPHONE_I2S_PORT, target, sizeof(geophoneScratch), &bytesRead, 0);
+    size_t samples = bytesRead / sizeof(int16_t);
+
+    portENTER_CRITICAL(&geophoneMux);
+    geophoneStats.samples += samples;
+    if (!haveSlot) {
+      geophoneStats.droppedBlocks++;  // processing fell behind; keep DMA running
+    }
+    portEXIT_CRITICAL(&geophoneMux);
+
+    if (haveSlot) {
+      if (samples == GEOPHONE_BLOCK_SAMPLES) {
+        geophoneRingUs[slot] = blockUs;
+        xQueueSend(geophoneFullSlots, &slot, 0);  // cannot fail, queue holds every slot
+      } else {
+        xQueueSend(geophoneFreeSlots, &slot, 0);  // short read, should not happen
+      }
+    }
+
+    rateWindowSamples += samples;
+    int64_t now = esp_timer_get_time();
+    if (now - rateWindowStart >= 1000000) {
+      float rate = rateWindowSamples * 1e6f / (float)(now - rateWindowStart);
+      portENTER_CRITICAL(&geophoneMux);
+      geophoneStats.sampleRate = rate;
+      portEXIT_CRITICAL(&geophoneMux);
+      rateWindowStart = now;
+      rateWindowSamples = 0;
+    }
+  }
+}
+
+/******************************************************************
+ *                                                                *
+ *                          Processing                            *
+ *                                                                *
+ ******************************************************************/
+
+// Built-in consumer: windowed spectral features, so only a handful of numbers leave the device
+static void geophone_analysis_consumer(const int16_t* samples, size_t count, int64_t blockUs, void* context) {
+  for (size_t i = 0; i < count; i++) {
+    geophoneWindow[geophoneWindowFill++] = samples[i] * GEOPHONE_MM_S_PER_COUNT;
+    if (geophoneWindowFill < GEOPHONE_FFT_SIZE) {
+      continue;
+    }
+    geophoneWindowFill = 0;
+
+    SpectralFeatures window;
+    spectral_analyze(geophoneWindow, GEOPHONE_FFT_SIZE, GEOPHONE_SAMPLE_RATE, &window);
+
+    portENTER_CRITICAL(&geophoneMux);
+    if (geophoneFeatures.windows == 0 || window.peak > geophoneFeatures.ppv) {
+      geophoneFeatures.ppv = window.peak;
+      geophoneFeatures.dominantFrequency = window.dominantFrequency;
+    }
+    for (int band = 0; band < SPECTRAL_OCTAVE_BANDS; band++) {
+      if (window.bandEnergy[band] > geophoneFeatures.bandEnergy[band]) {
+        geophoneFeatures.bandEnergy[band] = window.bandEnergy[band];
+      }
+    }
+    geophoneFeatures.windows++;
+    portEXIT_CRITICAL(&geophoneMux);
+  }
+}
+
+void geophoneProcessingTask(void* parameter) {
+  while (true) {
+    int slot;
+    if (xQueueReceive(geophoneFullSlots, &slot, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    int16_t* block = geophoneRing[slot];
+
+    // I2S ADC words carry the channel in the top 4 bits; keep the 12-bit sample, centred
+    for (size_t i = 0; i < GEOPHONE_BLOCK_SAMPLES; i++) {
+      block[i] = (int16_t)((uint16_t)block[i] & 0x0FFF) - GEOPHONE_ADC_MIDSCALE;
+    }
+
+    for (int c = 0; c < geophoneConsumerCount; c++) {
+      geophoneConsumers[c].consumer(block, GEOPHONE_BLOCK_SAMPLES, geophoneRingUs[slot],
+                                    geophoneConsumers[c].context);
+    }
+
+    portENTER_CRITICAL(&geophoneMux);
+    geophoneStats.blocks++;
+    portEXIT_CRITICAL(&geophoneMux);
+
+    xQueueSend(geophoneFreeSlots, &slot, 0);
+  }
+}
+
+/******************************************************************
+ *                                                                *
+ *                            Setup                               *
+ *                                                                *
+ ******************************************************************/
+
+bool geophone_add_consumer(GeophoneConsumer consumer, void* context) {
+  // Consumers are registered during setup, before or right after geophone_init()
+  if (geophoneConsumerCount >= GEOPHONE_MAX_CONSUMERS) {
+    return false;
+  }
+  geophoneConsumers[geophoneConsumerCount].consumer = consumer;
+  geophoneConsumers[geophoneConsumerCount].context = context;
+  geophoneConsumerCount++;
+  return true;
+}
+
+bool geophone_init(uint8_t pin) {
+  if (geophoneInitialized) {
+    return true;
+  }
+
+  int8_t channel = digitalPinToAnalogChannel(pin);
+  if (channel < 0 || channel > 7) {
+    Serial.printf("Geophone: GPIO%d is not an ADC1 pin\n", pin);
+    return false;
+  }
+
+  if (!spectral_init(GEOPHONE_FFT_SIZE)) {
+    Serial.println("Geophone: spectral analysis init failed");
+    return false;
+  }
+
+  geophoneFreeSlots = xQueueCreate(GEOPHONE_RING_SLOTS, sizeof(int));
+  geophoneFullSlots = xQueueCreate(GEOPHONE_RING_SLOTS, sizeof(int));
+  for (int slot = 0; slot < GEOPHONE_RING_SLOTS; slot++) {
+    xQueueSend(geophoneFreeSlots, &slot, 0);
+  }
+
+  i2s_config_t i2sConfig = {};
+  i2sConfig.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+  i2sConfig.sample_rate = GEOPHONE_SAMPLE_RATE;
+  i2sConfig.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+  i2sConfig.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+  i2sConfig.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+  i2sConfig.intr_alloc_flags = 0;
+  i2sConfig.dma_buf_count = GEOPHONE_DMA_BUFFERS;
+  i2sConfig.dma_buf_len = GEOPHONE_BLOCK_SAMPLES;
+  i2sConfig.use_apll = false;
+
+  if (i2s_driver_install(GEOPHONE_I2S_PORT, &i2sConfig, GEOPHONE_DMA_BUFFERS * 2, &geophoneI2sEvents) != ESP_OK) {
+    Serial.println("Geophone: I2S driver install failed");
+    return false;
+  }
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  adc1_config_channel_atten((adc1_channel_t)channel, ADC_ATTEN_DB_11);
+  i2s_set_adc_mode(ADC_UNIT_1, (adc1_channel_t)channel);
+
+  geophone_add_consumer(geophone_analysis_consumer, nullptr);
+
+  xTaskCreatePinnedToCore(
+    geophoneProcessingTask,   // Task function
+    "Geophone Processing",    // Name of the task (for debugging)
+    4096,                     // Stack size (in words, not bytes)
+    NULL,                     // Task input parameter
+    GEOPHONE_PROC_PRIORITY,   // Priority of the task
+    NULL,                     // Task handle
+    GEOPHONE_CORE             // Core
+  );
+  xTaskCreatePinnedToCore(
+    geophoneAcquisitionTask,  // Task function
+    "Geophone Acquisition",   // Name of the task (for debugging)
+    3072,                     // Stack size (in words, not bytes)
+    NULL,                     // Task input parameter
+    GEOPHONE_ACQ_PRIORITY,    // Above processing so the DMA ring is always drained
+    NULL,                     // Task handle
+    GEOPHONE_CORE             // Core
+  );
+
+  i2s_adc_enable(GEOPHONE_I2S_PORT);
+  geophoneInitialized = true;
+  Serial.printf("Geophone: sampling GPIO%d (ADC1 channel %d) at %d Hz\n", pin, channel, GEOPHONE_SAMPLE_RATE);
+  return true;
+}
+
+void geophone_get_stats(GeophoneStats* stats) {
+  portENTER_CRITICAL(&geophoneMux);
+  *stats = geophoneStats;
+  portEXIT_CRITICAL(&geophoneMux);
+}
+
+bool geophone_take_features(GeophoneFeatures* features) {
+  portENTER_CRITICAL(&geophoneMux);
+  *features = geophoneFeatures;
+  memset(&geophoneFeatures, 0, sizeof(geophoneFeatures));
+  portEXIT_CRITICAL(&geophoneMux);
+  return features->windows > 0;
+}
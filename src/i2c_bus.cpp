@@ -0,0 +1,137 @@
+#include "i2c_bus.h"
+
+struct I2CRequest {
+  I2CJob job;
+  void* context;
+  TaskHandle_t notifyTask;
+  bool result;
+};
+
+static struct {
+  TwoWire* wire;
+  QueueHandle_t queue;
+  bool initialized;
+} i2cBuses[I2C_BUS_COUNT];
+
+void i2cBusTask(void* parameter) {
+  int bus = (int)(intptr_t)parameter;
+
+  while (true) {
+    I2CRequest* request;
+    if (xQueueReceive(i2cBuses[bus].queue, &request, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    request->result = request->job(i2cBuses[bus].wire, request->context);
+    xTaskNotifyGive(request->notifyTask);
+  }
+}
+
+bool i2c_bus_init(int bus) {
+  static const int8_t sdaPins[I2C_BUS_COUNT] = {I2C_BUS0_SDA, I2C_BUS1_SDA};
+  static const int8_t sclPins[I2C_BUS_COUNT] = {I2C_BUS0_SCL, I2C_BUS1_SCL};
+
+  if (bus < 0 || bus >= I2C_BUS_COUNT) {
+    return false;
+  }
+  if (i2cBuses[bus].initialized) {
+    return true;
+  }
+  if (sdaPins[bus] < 0 || sclPins[bus] < 0) {
+    Serial.printf("I2C bus %d has no pins assigned\n", bus);
+    return false;
+  }
+
+  TwoWire* wire = (bus == 0) ? &Wire : &Wire1;
+  // Wire may already be running for the OLED/RTC; begin() keeps the existing setup then
+  wire->begin(sdaPins[bus], sclPins[bus], I2C_BUS_FREQUENCY);
+
+  i2cBuses[bus].wire = wire;
+  i2cBuses[bus].queue = xQueueCreate(I2C_QUEUE_LENGTH, sizeof(I2CRequest*));
+
+  char taskName[16];
+  snprintf(taskName, sizeof(taskName), "I2C Bus %d", bus);
+  xTaskCreate(
+    i2cBusTask,               // Task function
+    taskName,                 // Name of the task (for debugging)
+    3072,                     // Stack size (in words, not bytes)
+    (void *)(intptr_t)bus,    // Task input parameter: bus index
+    2,                        // Above the polling tasks so queued jobs run promptly
+    NULL                      // Task handle
+  );
+
+  i2cBuses[bus].initialized = true;
+  return true;
+}
+
+bool i2c_bus_run(int bus, I2CJob job, void* context) {
+  if (bus < 0 || bus >= I2C_BUS_COUNT || !i2cBuses[bus].initialized) {
+    return false;
+  }
+  I2CRequest request = {job, context, xTaskGetCurrentTaskHandle(), false};
+  I2CRequest* pointer = &request;
+  if (xQueueSend(i2cBuses[bus].queue, &pointer, portMAX_DELAY) != pdTRUE) {
+    return false;
+  }
+  // Wire transactions time out on their own, so the worker always answers
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  return request.result;
+}
+
+/******************************************************************
+ *                                                                *
+ *                           Helpers                              *
+ *                                                                *
+ ******************************************************************/
+
+struct I2CRegisterAccess {
+  uint8_t address;
+  uint8_t reg;
+  uint8_t* data;
+  size_t len;
+};
+
+static bool i2c_probe_job(TwoWire* wire, void* context) {
+  I2CRegisterAccess* access = (I2CRegisterAccess*)context;
+  wire->beginTransmission(access->address);
+  return wire->endTransmission() == 0;
+}
+
+static bool i2c_write_job(TwoWire* wire, void* context) {
+  I2CRegisterAccess* access = (I2CRegisterAccess*)context;
+  wire->beginTransmission(access->address);
+  wire->write(access->reg);
+  wire->write(access->data, access->len);
+  return wire->endTransmission() == 0;
+}
+
+// Register pointer write and burst read with a repeated start, as one bus transaction
+static bool i2c_read_job(TwoWire* wire, void* context) {
+  I2CRegisterAccess* access = (I2CRegisterAccess*)context;
+  wire->beginTransmission(access->address);
+  wire->write(access->reg);
+  if (wire->endTransmission(false) != 0) {
+    return false;
+  }
+  if (wire->requestFrom(access->address, (uint8_t)access->len) != access->len) {
+    return false;
+  }
+  for (size_t i = 0; i < access->len; i++) {
+    access->data[i] = wire->read();
+  }
+  return true;
+}
+
+bool i2c_probe(int bus, uint8_t address) {
+  I2CRegisterAccess access = {address, 0, nullptr, 0};
+  return i2c_bus_run(bus, i2c_probe_job, &access);
+}
+
+bool i2c_write_register(int bus, uint8_t address, uint8_t reg, uint8_t value) {
+  I2CRegisterAccess access = {address, reg, &value, 1};
+  return i2c_bus_run(bus, i2c_write_job, &access);
+}
+
+bool i2c_read_registers(int bus, uint8_t address, uint8_t reg, uint8_t* data, size_t len) {
+  I2CRegisterAccess access = {address, reg, data, len};
+  return i2c_bus_run(bus, i2c_read_job, &access);
+}
@@ -0,0 +1,233 @@
+#include "inclinometer.h"
+
+#define SAA_SEGMENT_FIELDS 5   // index, x, y, z, temperature
+#define SAA_HEADER_FIELDS 3    // "SAA", serial, segments
+
+static HardwareSerial SAA(SAA_UART_NUM);
+static bool saaInitialized = false;
+
+enum SAAParseState : uint8_t {
+  SAA_WAIT_HEADER,   // discard until '$'
+  SAA_HEADER,
+  SAA_SEGMENTS,
+};
+
+// Parser state, touched only by the UART event task
+static struct {
+  SAAParseState state;
+  char field[SAA_MAX_FIELD + 1];
+  uint8_t fieldLen;
+  uint8_t fieldIndex;
+  bool lineBad;
+  float values[SAA_SEGMENT_FIELDS];
+  uint16_t expected;
+  uint16_t received;
+} saaParser;
+
+// Triple buffer: the parser fills one table, the newest complete frame waits in another,
+// and the table last handed out by saa_take_frame() is left alone until the next take
+static SAAFrame saaFrames[3];
+static int saaFilling = 0;
+static int saaReady = 1;
+static int saaHeld = 2;
+static bool saaReadyFresh = false;
+static uint32_t saaSequence = 0;
+
+static portMUX_TYPE saaMux = portMUX_INITIALIZER_UNLOCKED;
+static SAAStats saaStats;
+
+/******************************************************************
+ *                                                                *
+ *                            Parser                              *
+ *                                                                *
+ ******************************************************************/
+
+static void saa_drop_frame() {
+  portENTER_CRITICAL(&saaMux);
+  saaStats.badFrames++;
+  portEXIT_CRITICAL(&saaMux);
+  saaParser.state = SAA_WAIT_HEADER;
+}
+
+static void saa_start_line() {
+  saaParser.fieldLen = 0;
+  saaParser.fieldIndex = 0;
+  saaParser.lineBad = false;
+}
+
+static void saa_complete_frame() {
+  SAAFrame* frame = &saaFrames[saaFilling];
+  frame->segmentCount = saaParser.expected;
+  frame->completedUs = esp_timer_get_time();
+
+  portENTER_CRITICAL(&saaMux);
+  frame->sequence = ++saaSequence;
+  if (saaReadyFresh) {
+    saaStats.unreadFrames++;
+  }
+  int swap = saaReady;
+  saaReady = saaFilling;
+  saaFilling = swap;
+  saaReadyFresh = true;
+  saaStats.frames++;
+  portEXIT_CRITICAL(&saaMux);
+
+  saaParser.state = SAA_WAIT_HEADER;
+}
+
+// A field is converted as soon as its delimiter arrives
+static void saa_end_field() {
+  saaParser.field[saaParser.fieldLen] = '\0';
+  uint8_t index = saaParser.fieldIndex++;
+  if (saaParser.fieldLen == 0) {
+    saaParser.lineBad = true;
+    return;
+  }
+
+  if (saaParser.state == SAA_HEADER) {
+    char* end;
+    switch (index) {
+      case 0:
+        saaParser.lineBad |= strcmp(saaParser.field, "SAA") != 0;
+        break;
+      case 1:
+        saaFrames[saaFilling].serial = strtoul(saaParser.field, &end, 10);
+        saaParser.lineBad |= (*end != '\0');
+        break;
+      case 2:
+        saaParser.expected = (uint16_t)strtoul(saaParser.field, &end, 10);
+        saaParser.lineBad |= (*end != '\0');
+        break;
+      default:
+        saaParser.lineBad = true;
+    }
+    return;
+  }
+
+  if (index >= SAA_SEGMENT_FIELDS) {
+    saaParser.lineBad = true;
+    return;
+  }
+  char* end;
+  saaParser.values[index] = strtof(saaParser.field, &end);
+  saaParser.lineBad |= (*end != '\0');
+}
+
+static void saa_end_line() {
+  if (saaParser.state == SAA_HEADER) {
+    if (saaParser.lineBad || saaParser.fieldIndex != SAA_HEADER_FIELDS ||
+        saaParser.expected == 0 || saaParser.expected > SAA_MAX_SEGMENTS) {
+      saa_drop_frame();
+    } else {
+      saaParser.received = 0;
+      saaParser.state = SAA_SEGMENTS;
+    }
+    return;
+  }
+
+  // Segments must arrive complete and in order; anything else loses the frame
+  if (saaParser.lineBad || saaParser.fieldIndex != SAA_SEGMENT_FIELDS ||
+      saaParser.values[0] != (float)(saaParser.received + 1)) {
+    saa_drop_frame();
+    return;
+  }
+  SAASegment* segment = &saaFrames[saaFilling].segments[saaParser.received++];
+  segment->x = saaParser.values[1];
+  segment->y = saaParser.values[2];
+  segment->z = saaParser.values[3];
+  segment->temperature = saaParser.values[4];
+
+  if (saaParser.received == saaParser.expected) {
+    saa_complete_frame();
+  }
+}
+
+static void saa_parse_byte(char c) {
+  if (c == '$') {
+    if (saaParser.state == SAA_SEGMENTS) {
+      saa_drop_frame();  // next frame started before this one was complete
+    }
+    saaParser.state = SAA_HEADER;
+    saa_start_line();
+    return;
+  }
+  if (saaParser.state == SAA_WAIT_HEADER || c == '\r') {
+    return;
+  }
+
+  if (c == ',' || c == '\n') {
+    bool blank = (c == '\n' && saaParser.fieldIndex == 0 && saaParser.fieldLen == 0);
+    if (blank) {
+      return;
+    }
+    saa_end_field();
+    saaParser.fieldLen = 0;
+    if (c == '\n') {
+      saa_end_line();
+      saa_start_line();
+    }
+    return;
+  }
+
+  if (saaParser.fieldLen < SAA_MAX_FIELD) {
+    saaParser.field[saaParser.fieldLen++] = c;
+  } else {
+    saaParser.lineBad = true;
+  }
+}
+
+static void saa_on_receive() {
+  uint8_t chunk[64];
+  while (SAA.available() > 0) {
+    size_t n = SAA.read(chunk, sizeof(chunk));
+    for (size_t i = 0; i < n; i++) {
+      saa_parse_byte((char)chunk[i]);
+    }
+  }
+}
+
+/******************************************************************
+ *                                                                *
+ *                             API                                *
+ *                                                                *
+ ******************************************************************/
+
+bool saa_init() {
+  if (saaInitialized) {
+    return true;
+  }
+  SAA.setRxBufferSize(1024);  // must precede begin(); a 128-segment frame is about 5 KB
+  SAA.begin(SAA_BAUD, SERIAL_8N1, SAA_RX_PIN, SAA_TX_PIN);
+  SAA.setRxTimeout(2);
+  SAA.onReceive(saa_on_receive, false);
+  saaParser.state = SAA_WAIT_HEADER;
+  saaInitialized = true;
+  Serial.printf("Inclinometer: SAA on UART%d at %d baud\n", SAA_UART_NUM, SAA_BAUD);
+  return true;
+}
+
+void saa_request_frame() {
+  if (saaInitialized) {
+    SAA.print(SAA_POLL_COMMAND);
+  }
+}
+
+const SAAFrame* saa_take_frame() {
+  portENTER_CRITICAL(&saaMux);
+  bool fresh = saaReadyFresh;
+  if (fresh) {
+    int swap = saaHeld;
+    saaHeld = saaReady;
+    saaReady = swap;
+    saaReadyFresh = false;
+  }
+  int held = saaHeld;
+  portEXIT_CRITICAL(&saaMux);
+  return fresh ? &saaFrames[held] : nullptr;
+}
+
+void saa_get_stats(SAAStats* stats) {
+  portENTER_CRITICAL(&saaMux);
+  *stats = saaStats;
+  portEXIT_CRITICAL(&saaMux);
+}
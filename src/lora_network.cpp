@@ -47,10 +47,13 @@ void handle_collection_config_update(const uint8_t *incomingData){
   collection_config_message msg;
   memcpy(&msg, incomingData, sizeof(msg));
 
-  updateDataCollectionConfiguration(msg.channel, "pin", msg.pin);
-  updateDataCollectionConfiguration(msg.channel, "sensor", msg.sensor);
-  updateDataCollectionConfiguration(msg.channel, "enabled", msg.enabled);
-  updateDataCollectionConfiguration(msg.channel, "interval", msg.interval);
+  DataConfigTransaction txn;
+  data_config_begin(&txn);
+  data_config_stage(&txn, msg.channel, "pin", msg.pin);
+  data_config_stage(&txn, msg.channel, "sensor", msg.sensor);
+  data_config_stage(&txn, msg.channel, "enabled", msg.enabled);
+  data_config_stage(&txn, msg.channel, "interval", msg.interval);
+  data_config_commit(&txn);
 }
 
 void handle_system_config_update(const uint8_t *incomingData){
@@ -75,7 +78,12 @@ void task_handle_config_poll(void *parameter){
     if (poll_config_flag)
     {
       Serial.println("=== data configuration ===");
-      if(sendLoRaData((uint8_t *) &dataConfig, sizeof(dataConfig), "/data.conf")){
+      // Same layout as the NVS channel table
+      static uint8_t table[DATA_CONFIG_BLOB_MAX];
+      const DataCollectionConfig* config = data_config_acquire();
+      size_t length = data_config_serialize(config, table, sizeof(table));
+      data_config_release(config);
+      if(sendLoRaData(table, length, "/data.conf")){
         Serial.println("Sent data collection configuration to gateway.");
       }
       Serial.println("=== sys configuration ===");
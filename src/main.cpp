@@ -5,6 +5,7 @@
 // #include "lora_network.h"  // Disabled - no LoRa needed
 #include "configuration.h"
 #include "mqtt.h"
+#include "time_service.h"
 
 
 /* Tasks */
@@ -13,11 +14,6 @@ TaskHandle_t parsingTask; // Task handle for the parsing task
 TaskHandle_t wifimanagerTaskHandle; // Task handle for the parsing task
 TaskHandle_t blinkTaskHandle; // Task handle for the parsing task
 
-void taskInitiNTP(void *parameter) {
-  ntp_sync();  // Call the initNTP function
-  vTaskDelete(NULL);  // Delete the task once initialization is complete
-}
-
 void setup() {
 
   Serial.begin(115200);
@@ -54,7 +50,7 @@ void setup() {
     NULL                    // Task handle
   );
   
-  xTaskCreate(taskInitiNTP, "InitNTPTask", 4096, NULL, 1, NULL);
+  time_service_start();// NTP sync now and periodically, see time_service.h
   start_http_server();// start Async server with api-interfaces
   // FTP server - optional (commented out for no-SD-card mode)
   // ftp_server_init();
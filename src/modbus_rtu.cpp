@@ -0,0 +1,580 @@
+#include "modbus_rtu.h"
+#include "driver/uart.h"
+
+ModbusPort rs485Buses[RS485_BUS_COUNT];
+
+// Engine task notification bits
+#define MODBUS_EVT_QUEUE (1 << 0)
+#define MODBUS_EVT_RX (1 << 1)
+#define MODBUS_EVT_TIMER (1 << 2)
+
+/******************************************************************
+ *                                                                *
+ *                          Framing                               *
+ *                                                                *
+ ******************************************************************/
+
+// Time on the wire for n bytes at 11 bits per character (8N1 + start/stop margin)
+static uint32_t modbus_frame_time_us(const ModbusPort* port, size_t bytes) {
+  return (uint32_t)((bytes * 11UL * 1000000UL) / port->baud);
+}
+
+// Inter-frame silence: 3.5 characters, fixed at 1750 us above 19200 baud as the spec recommends
+static uint32_t modbus_t35_us(uint32_t baud) {
+  if (baud > 19200) {
+    return 1750;
+  }
+  return (uint32_t)((35UL * 11UL * 100000UL) / baud);
+}
+
+static bool modbus_request_valid(const ModbusPort* port, const ModbusRequest* request) {
+  return port->initialized && request->count > 0 && request->count <= MODBUS_MAX_READ_REGISTERS &&
+         (request->function == MODBUS_FC_READ_HOLDING_REGISTERS ||
+          request->function == MODBUS_FC_READ_INPUT_REGISTERS);
+}
+
+/******************************************************************
+ *                                                                *
+ *                      Adaptive Timeout                          *
+ *                                                                *
+ ******************************************************************/
+
+// Update the smoothed response time with a new sample (RFC 6298 style)
+static void modbus_update_timeout(ModbusPort* port, uint32_t sample_us) {
+  if (port->srtt_us == 0) {
+    port->srtt_us = sample_us;
+    port->rttvar_us = sample_us / 2;
+  } else {
+    uint32_t delta = (sample_us > port->srtt_us) ? sample_us - port->srtt_us : port->srtt_us - sample_us;
+    port->rttvar_us = (3 * port->rttvar_us + delta) / 4;
+    port->srtt_us = (7 * port->srtt_us + sample_us) / 8;
+  }
+
+  uint32_t timeout_ms = (port->srtt_us + 4 * port->rttvar_us) / 1000 + 1;
+  if (timeout_ms < MODBUS_TIMEOUT_MIN_MS) timeout_ms = MODBUS_TIMEOUT_MIN_MS;
+  if (timeout_ms > MODBUS_TIMEOUT_MAX_MS) timeout_ms = MODBUS_TIMEOUT_MAX_MS;
+  port->timeout_ms = timeout_ms;
+}
+
+/******************************************************************
+ *                                                                *
+ *                    Asynchronous Engine                         *
+ *                                                                *
+ ******************************************************************/
+
+static void modbus_arm_timer(ModbusPort* port, uint32_t us) {
+  esp_timer_stop(port->timer);
+  port->timerDeadlineUs = esp_timer_get_time() + us;
+  esp_timer_start_once(port->timer, us);
+}
+
+static void modbus_timer_callback(void* arg) {
+  ModbusPort* port = (ModbusPort*)arg;
+  xTaskNotify(port->engineTask, MODBUS_EVT_TIMER, eSetBits);
+}
+
+static void modbus_complete(ModbusPort* port, uint8_t result) {
+  esp_timer_stop(port->timer);
+  ModbusRequest* request = port->current;
+  port->current = nullptr;
+  port->state = MODBUS_IDLE;
+  port->lastActivityUs = esp_timer_get_time();
+
+  request->result = result;
+  if (request->onComplete != nullptr) {
+    request->onComplete(request);
+  }
+  // The request may be reused by its owner as soon as it is notified
+  if (request->notifyTask != nullptr) {
+    xTaskNotifyGive(request->notifyTask);
+  }
+}
+
+static void modbus_transmit(ModbusPort* port) {
+  ModbusRequest* request = port->current;
+  uint8_t frame[MODBUS_READ_REQUEST_SIZE];
+  modbus_encode_read_request(frame, request->slaveId, request->function, request->address, request->count);
+
+  // Drop anything left over from a previous, timed out transaction
+  while (port->serial->available() > 0) {
+    port->serial->read();
+  }
+  port->rxLen = 0;
+
+  // The UART asserts DE for exactly as long as the frame is shifted out, so there is
+  // nothing to wait for here: the request ends on the wire one frame time from now
+  port->serial->write(frame, sizeof(frame));
+  uint32_t txTime = modbus_frame_time_us(port, sizeof(frame));
+
+  port->transactions++;
+  port->responseStartUs = esp_timer_get_time() + txTime;
+  port->state = MODBUS_WAIT_RESPONSE;
+
+  // Adaptive timeout plus the time the response itself spends on the wire
+  modbus_arm_timer(port, txTime + port->timeout_ms * 1000UL + modbus_frame_time_us(port, 5 + 2 * request->count));
+}
+
+static uint8_t modbus_decode_response(ModbusPort* port, size_t len) {
+  ModbusRequest* request = port->current;
+  uint8_t result = modbus_decode_read_response(port->rxBuf, len, request->slaveId, request->function,
+                                               request->count, request->out);
+  if (result == MODBUS_ERR_INVALID_CRC) {
+    port->crcErrors++;
+    return result;
+  }
+
+  // Device answered with a valid frame: feed the response time estimator
+  modbus_update_timeout(port, request->responseTimeUs);
+
+  if (modbus_result_is_exception(result)) {
+    port->exceptions++;
+  }
+  return result;
+}
+
+static void modbus_on_rx(ModbusPort* port) {
+  HardwareSerial* serial = port->serial;
+
+  if (port->state != MODBUS_WAIT_RESPONSE) {
+    // Late answer to a timed out request or line noise: drop it, but keep the bus quiet time
+    if (serial->available() > 0) {
+      while (serial->available() > 0) {
+        serial->read();
+      }
+      port->lastActivityUs = esp_timer_get_time();
+    }
+    return;
+  }
+
+  int available = serial->available();
+  size_t space = sizeof(port->rxBuf) - port->rxLen;
+  if (available > 0 && space > 0) {
+    port->rxLen += serial->read(port->rxBuf + port->rxLen, min((size_t)available, space));
+  }
+
+  // Complete as soon as the frame length is satisfied instead of waiting for the line to go idle
+  size_t expected = modbus_response_length(port->rxBuf, port->rxLen);
+  if (expected == 0 || port->rxLen < expected) {
+    return;
+  }
+  // responseStartUs is an estimate, so a quick reply can seem to beat it; clamping to the
+  // timeout ceiling also keeps the estimator's sums within uint32_t
+  int64_t responseUs = esp_timer_get_time() - port->responseStartUs;
+  if (responseUs < 0) responseUs = 0;
+  if (responseUs > MODBUS_TIMEOUT_MAX_MS * 1000LL) responseUs = MODBUS_TIMEOUT_MAX_MS * 1000LL;
+  port->current->responseTimeUs = (uint32_t)responseUs;
+  modbus_complete(port, modbus_decode_response(port, expected));
+}
+
+static void modbus_on_timer(ModbusPort* port) {
+  if (esp_timer_get_time() < port->timerDeadlineUs) {
+    return;  // stale event from a timer that was stopped and re-armed
+  }
+
+  if (port->state == MODBUS_GUARD) {
+    int64_t quiet = esp_timer_get_time() - port->lastActivityUs;
+    if (quiet < port->t35_us) {
+      modbus_arm_timer(port, port->t35_us - quiet);  // bus saw traffic during the guard
+    } else {
+      modbus_transmit(port);
+    }
+  } else if (port->state == MODBUS_WAIT_RESPONSE) {
+    modbus_on_rx(port);  // pick up bytes the UART has not reported yet
+    if (port->state == MODBUS_WAIT_RESPONSE) {
+      port->timeouts++;
+      // Back off until the next valid response re-derives the timeout
+      port->timeout_ms = min((uint32_t)(port->timeout_ms * 2), (uint32_t)MODBUS_TIMEOUT_MAX_MS);
+      modbus_complete(port, MODBUS_ERR_RESPONSE_TIMEOUT);
+    }
+  }
+}
+
+static void modbus_start_next(ModbusPort* port) {
+  if (port->state != MODBUS_IDLE) {
+    return;
+  }
+  ModbusRequest* request;
+  if (xQueueReceive(port->queue, &request, 0) != pdTRUE) {
+    return;
+  }
+  port->current = request;
+
+  // Keep the 3.5 character silence between frames, without blocking
+  int64_t quiet = esp_timer_get_time() - port->lastActivityUs;
+  if (quiet < port->t35_us) {
+    port->state = MODBUS_GUARD;
+    modbus_arm_timer(port, port->t35_us - quiet);
+  } else {
+    modbus_transmit(port);
+  }
+}
+
+void modbusEngineTask(void* parameter) {
+  ModbusPort* port = (ModbusPort*)parameter;
+
+  while (true) {
+    uint32_t events = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+
+    if (events & MODBUS_EVT_RX) {
+      modbus_on_rx(port);
+    }
+    if (events & MODBUS_EVT_TIMER) {
+      modbus_on_timer(port);
+    }
+    // Pipeline: the next request goes out as soon as the bus is free
+    modbus_start_next(port);
+  }
+}
+
+/******************************************************************
+ *                                                                *
+ *                         Transport                              *
+ *                                                                *
+ ******************************************************************/
+
+void modbus_port_init(ModbusPort* port, HardwareSerial* serial, uart_port_t uartNum, uint32_t baud,
+                      int8_t rxPin, int8_t txPin, int8_t rePin) {
+  if (port->initialized) {
+    return;  // bus is shared by several drivers
+  }
+
+  port->serial = serial;
+  port->uartNum = uartNum;
+  port->rePin = rePin;
+  port->baud = baud;
+  port->t35_us = modbus_t35_us(baud);
+  port->state = MODBUS_IDLE;
+  port->current = nullptr;
+  port->rxLen = 0;
+  port->lastActivityUs = 0;
+  port->srtt_us = 0;
+  port->rttvar_us = 0;
+  port->timeout_ms = MODBUS_TIMEOUT_INITIAL_MS;
+  port->transactions = 0;
+  port->timeouts = 0;
+  port->crcErrors = 0;
+  port->exceptions = 0;
+
+  serial->begin(baud, SERIAL_8N1, rxPin, txPin);
+
+  // RS485 half-duplex: RTS drives the transceiver's DE/RE and the UART releases it
+  // right after the last stop bit, with no busy-wait on our side
+  serial->setPins(rxPin, txPin, -1, rePin);
+  serial->setHwFlowCtrlMode(HW_FLOWCTRL_DISABLE);
+  serial->setMode(UART_MODE_RS485_HALF_DUPLEX);
+
+  // Hardware also keeps at least 3.5 characters of silence between our own frames
+  uint32_t idleBits = (uint32_t)(((uint64_t)port->t35_us * baud + 999999) / 1000000);
+  uart_set_tx_idle_num(uartNum, min(idleBits, (uint32_t)1023));
+
+  port->queue = xQueueCreate(MODBUS_QUEUE_LENGTH, sizeof(ModbusRequest*));
+
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = modbus_timer_callback;
+  timerArgs.arg = port;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "modbus";
+  esp_timer_create(&timerArgs, &port->timer);
+
+  xTaskCreate(
+    modbusEngineTask,     // Task function
+    "Modbus Engine",      // Name of the task (for debugging)
+    3072,                 // Stack size (in words, not bytes)
+    port,                 // Task input parameter
+    3,                    // Above the polling tasks so responses are handled promptly
+    &port->engineTask     // Task handle
+  );
+
+  // UART RX events wake the engine; deliver buffered bytes after a short idle time
+  serial->setRxTimeout(MODBUS_RX_TIMEOUT_SYMBOLS);
+  serial->onReceive([port]() {
+    xTaskNotify(port->engineTask, MODBUS_EVT_RX, eSetBits);
+  }, false);
+
+  port->initialized = true;
+}
+
+bool modbus_baud_supported(uint32_t baud) {
+  switch (baud) {
+    case 9600:
+    case 19200:
+    case 38400:
+    case 57600:
+    case 115200:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool rs485_bus_available(int bus) {
+#ifdef RS485_BUS2_ENABLED
+  return bus >= 0 && bus < RS485_BUS_COUNT;
+#else
+  return bus >= 0 && bus < RS485_BUS_COUNT - 1;
+#endif
+}
+
+ModbusPort* rs485_bus_init(int bus) {
+  static const uint32_t busBaud[RS485_BUS_COUNT] = {RS485_BUS0_BAUD, RS485_BUS1_BAUD, RS485_BUS2_BAUD};
+
+  if (!rs485_bus_available(bus)) {
+    Serial.printf("RS485 bus %d is not available\n", bus);
+    return nullptr;
+  }
+  uint32_t baud = busBaud[bus];
+  if (!modbus_baud_supported(baud)) {
+    Serial.printf("RS485 bus %d: unsupported baud rate %lu\n", bus, baud);
+    return nullptr;
+  }
+
+  ModbusPort* port = &rs485Buses[bus];
+  switch (bus) {
+    case 0:
+      modbus_port_init(port, &Serial2, UART_NUM_2, baud, RS485_BUS0_RX, RS485_BUS0_TX, RS485_BUS0_DE);
+      break;
+    case 1:
+      modbus_port_init(port, &Serial1, UART_NUM_1, baud, RS485_BUS1_RX, RS485_BUS1_TX, RS485_BUS1_DE);
+      break;
+    case 2:
+      Serial.println("RS485 bus 2 takes over UART0, console output stops here.");
+      Serial.flush();
+      modbus_port_init(port, &Serial, UART_NUM_0, baud, RS485_BUS2_RX, RS485_BUS2_TX, RS485_BUS2_DE);
+      break;
+  }
+  return port;
+}
+
+bool modbus_submit(ModbusPort* port, ModbusRequest* request) {
+  if (!modbus_request_valid(port, request)) {
+    return false;
+  }
+  if (xQueueSend(port->queue, &request, 0) != pdTRUE) {
+    return false;
+  }
+  xTaskNotify(port->engineTask, MODBUS_EVT_QUEUE, eSetBits);
+  return true;
+}
+
+// Submit a list of requests and sleep until every one of them completed
+static void modbus_run(ModbusPort* port, ModbusRequest** list, size_t count) {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  size_t next = 0;
+  size_t pending = 0;
+
+  while (next < count || pending > 0) {
+    while (next < count) {
+      ModbusRequest* request = list[next];
+      request->onComplete = nullptr;
+      request->notifyTask = self;
+      if (!modbus_request_valid(port, request)) {
+        request->result = MODBUS_ERR_INVALID_FUNCTION;
+        next++;
+        continue;
+      }
+      if (xQueueSend(port->queue, &request, 0) != pdTRUE) {
+        break;  // queue full, wait for a completion to make room
+      }
+      xTaskNotify(port->engineTask, MODBUS_EVT_QUEUE, eSetBits);
+      next++;
+      pending++;
+    }
+
+    if (pending > 0) {
+      ulTaskNotifyTake(pdFALSE, portMAX_DELAY);  // one completion per notification
+      pending--;
+    } else if (next < count) {
+      vTaskDelay(1);  // queue filled by other tasks
+    }
+  }
+}
+
+void modbus_transact(ModbusPort* port, ModbusRequest* requests, size_t count) {
+  ModbusRequest* list[count];
+  for (size_t i = 0; i < count; i++) {
+    list[i] = &requests[i];
+  }
+  modbus_run(port, list, count);
+}
+
+uint8_t modbus_read_holding_registers(ModbusPort* port, uint8_t slaveId, uint16_t address,
+                                      uint16_t count, uint16_t* out) {
+  ModbusRequest request = {};
+  request.slaveId = slaveId;
+  request.function = MODBUS_FC_READ_HOLDING_REGISTERS;
+  request.address = address;
+  request.count = count;
+  request.out = out;
+  modbus_transact(port, &request, 1);
+  return request.result;
+}
+
+/******************************************************************
+ *                                                                *
+ *                  Unsupported-Register Learning                 *
+ *                                                                *
+ ******************************************************************/
+
+bool modbus_register_should_poll(const ModbusRegisterHealth* health) {
+  if (health == nullptr || !health->quarantined) {
+    return true;
+  }
+  // Quarantined registers are re-probed rarely in case the firmware was updated
+  return (long)(millis() - health->nextProbeMs) >= 0;
+}
+
+void modbus_register_record(ModbusRegisterHealth* health, uint8_t result, bool deviceAlive) {
+  if (health == nullptr) {
+    return;
+  }
+  health->lastResult = result;
+
+  if (result == MODBUS_OK) {
+    if (health->quarantined) {
+      Serial.println("Modbus: quarantined register answered again, resuming polling");
+    }
+    health->strikes = 0;
+    health->quarantined = false;
+    health->reprobeIntervalMs = 0;
+    return;
+  }
+
+  // Only failures that say "this register does not exist" count towards quarantine.
+  // A timeout counts too, but only while the device is known to be answering other registers.
+  bool unsupported = (result == MODBUS_EX_ILLEGAL_DATA_ADDRESS || result == MODBUS_EX_ILLEGAL_FUNCTION ||
+                      (result == MODBUS_ERR_RESPONSE_TIMEOUT && deviceAlive));
+  if (!unsupported) {
+    return;
+  }
+
+  if (health->quarantined) {
+    // Failed re-probe: back off further
+    health->reprobeIntervalMs = min((uint32_t)(health->reprobeIntervalMs * 2), (uint32_t)MODBUS_REPROBE_MAX_MS);
+    health->nextProbeMs = millis() + health->reprobeIntervalMs;
+    return;
+  }
+
+  if (health->strikes < 255) {
+    health->strikes++;
+  }
+  if (health->strikes >= MODBUS_QUARANTINE_STRIKES) {
+    health->quarantined = true;
+    health->reprobeIntervalMs = MODBUS_REPROBE_INITIAL_MS;
+    health->nextProbeMs = millis() + health->reprobeIntervalMs;
+  }
+}
+
+static bool modbus_should_retry(uint8_t result) {
+  return result == MODBUS_ERR_RESPONSE_TIMEOUT || result == MODBUS_ERR_INVALID_CRC;
+}
+
+void modbus_read_batch(ModbusPort* port, ModbusRequest* requests, ModbusRegisterHealth* health,
+                       size_t count, bool* deviceAlive) {
+  bool alive = *deviceAlive;
+  ModbusRequest* list[count];
+  size_t polled = 0;
+  size_t probes = 0;
+
+  // Registers in good standing first, so the probe below is never a quarantine re-probe
+  for (size_t i = 0; i < count; i++) {
+    if (health == nullptr || !health[i].quarantined) {
+      list[polled++] = &requests[i];
+    }
+  }
+  for (size_t i = 0; health != nullptr && i < count; i++) {
+    if (!health[i].quarantined) {
+      continue;
+    }
+    if (modbus_register_should_poll(&health[i])) {
+      list[polled++] = &requests[i];
+    } else {
+      requests[i].result = health[i].lastResult;  // Skip the bus entirely
+    }
+  }
+
+  // Probe with a register that did not time out last time, if any: a device never seen alive
+  // is not kept looking dead by one register its firmware silently ignores
+  for (size_t k = 0; health != nullptr && k < polled && !health[list[k] - requests].quarantined; k++) {
+    if (health[list[k] - requests].lastResult != MODBUS_ERR_RESPONSE_TIMEOUT) {
+      ModbusRequest* probe = list[k];
+      list[k] = list[0];
+      list[0] = probe;
+      break;
+    }
+  }
+
+  if (polled > 0) {
+    // Probe with a single request before committing the whole batch, so a silent device
+    // costs one timeout instead of one per register. A device believed alive gets retries.
+    modbus_run(port, list, 1);
+    for (int attempt = 1; attempt <= MODBUS_MAX_RETRIES && alive && modbus_should_retry(list[0]->result); attempt++) {
+      vTaskDelay((MODBUS_RETRY_BACKOFF_MS << (attempt - 1)) / portTICK_PERIOD_MS);
+      modbus_run(port, list, 1);
+    }
+    probes = 1;
+    // Firmware that ignores an unimplemented register instead of raising an exception must
+    // not lose the whole device: while it was answering, the next register probes, and the
+    // silent one is charged below once another register has shown the device is there
+    while (alive && list[probes - 1]->result == MODBUS_ERR_RESPONSE_TIMEOUT && probes < polled) {
+      modbus_run(port, list + probes, 1);
+      probes++;
+    }
+    alive = (list[probes - 1]->result != MODBUS_ERR_RESPONSE_TIMEOUT);
+    if (!alive) {
+      for (size_t k = probes; k < polled; k++) {
+        list[k]->result = MODBUS_ERR_RESPONSE_TIMEOUT;
+      }
+      polled = probes;  // only the probes feed the learning
+    }
+  }
+
+  if (alive && polled > probes) {
+    modbus_run(port, list + probes, polled - probes);
+
+    // Retry timeouts and CRC errors with exponential backoff.
+    // Exceptions are definitive answers and quarantine re-probes get a single attempt.
+    for (int attempt = 1; attempt <= MODBUS_MAX_RETRIES; attempt++) {
+      ModbusRequest* retry[polled];
+      size_t retries = 0;
+      for (size_t k = probes; k < polled; k++) {
+        size_t i = list[k] - requests;
+        if (modbus_should_retry(list[k]->result) && (health == nullptr || !health[i].quarantined)) {
+          retry[retries++] = list[k];
+        }
+      }
+      if (retries == 0) {
+        break;
+      }
+      vTaskDelay((MODBUS_RETRY_BACKOFF_MS << (attempt - 1)) / portTICK_PERIOD_MS);
+      modbus_run(port, retry, retries);
+    }
+  }
+
+  if (health != nullptr) {
+    for (size_t k = 0; k < polled; k++) {
+      size_t i = list[k] - requests;
+      bool wasQuarantined = health[i].quarantined;
+      modbus_register_record(&health[i], list[k]->result, alive);
+      if (health[i].quarantined && !wasQuarantined) {
+        Serial.printf("Modbus: register 0x%04X on slave %d quarantined (error 0x%02X), re-probe in %lu s\n",
+                      list[k]->address, list[k]->slaveId, list[k]->result, health[i].reprobeIntervalMs / 1000);
+      }
+    }
+  }
+
+  *deviceAlive = alive;
+}
+
+uint8_t modbus_read_holding_registers_retry(ModbusPort* port, uint8_t slaveId, uint16_t address,
+                                            uint16_t count, uint16_t* out,
+                                            ModbusRegisterHealth* health, bool deviceAlive) {
+  ModbusRequest request = {};
+  request.slaveId = slaveId;
+  request.function = MODBUS_FC_READ_HOLDING_REGISTERS;
+  request.address = address;
+  request.count = count;
+  request.out = out;
+  modbus_read_batch(port, &request, health, 1, &deviceAlive);
+  return request.result;
+}
@@ -5,7 +5,13 @@
 #include "configuration.h"
 #include "srne_inverter.h"
 #include "single_phase_meter.h"
+#include "trigger.h"
+#include "inclinometer.h"
+#include "sensor_driver.h"
 #include "mqtt_schema.h"
+#include "mqtt.h"
+#include "utils.h"
+#include "time_service.h"
 // #include "LoRaLite.h"  // Disabled - no LoRa needed
 
 // MQTT credentials - now loaded from systemConfig
@@ -20,11 +26,14 @@ PubSubClient client(espClient);
 long lastMsg = 0;
 char msg[50];
 int value = 0;
-int mqtt_buffer_size = 4096;
-SemaphoreHandle_t mqttMutex;
+int mqtt_buffer_size = 8192;   // a 45-point SRNE inverter sample is ~4.6 KB of JSON
+SemaphoreHandle_t mqttMutex = NULL;
 
 // Wrap MQTT operations with mutex
 bool safe_mqtt_publish(const char* topic, const char* payload) {
+    if (mqttMutex == NULL) {
+        return false;  // mqtt_initialize() has not run yet
+    }
     if (xSemaphoreTake(mqttMutex, portMAX_DELAY) == pdTRUE) {
         bool result = client.publish(topic, payload);
         xSemaphoreGive(mqttMutex);
@@ -33,6 +42,33 @@ bool safe_mqtt_publish(const char* topic, const char* payload) {
     return false;
 }
 
+bool safe_mqtt_publish_binary(const char* topic, const uint8_t* payload, size_t length) {
+    if (mqttMutex == NULL) {
+        return false;
+    }
+    if (xSemaphoreTake(mqttMutex, portMAX_DELAY) == pdTRUE) {
+        bool result = client.publish(topic, payload, length);
+        xSemaphoreGive(mqttMutex);
+        return result;
+    }
+    return false;
+}
+
+// Reconnect if needed and process incoming packets. Sensor data is published from
+// several tasks (one per RS485 bus), so the client is only touched under the mutex.
+void safe_mqtt_service() {
+    if (mqttMutex == NULL) {
+        return;
+    }
+    if (xSemaphoreTake(mqttMutex, portMAX_DELAY) == pdTRUE) {
+        if (!client.connected()) {
+            mqtt_reconnect();
+        }
+        client.loop();
+        xSemaphoreGive(mqttMutex);
+    }
+}
+
 // ***********************************
 // * MQTT Reconnect
 // ***********************************
@@ -245,10 +281,7 @@ bool mqtt_process_folder(String folderPath, String extension, String DeviceName)
 */
 
 void publish_system_status() {
-  if (!client.connected()) {
-    mqtt_reconnect();
-  }
-  client.loop();
+  safe_mqtt_service();
 
   // Gather system status
   int cpuFreq = getCpuFrequencyMhz();
@@ -275,6 +308,16 @@ void publish_system_status() {
   payload += String(uptimeMinutes) + " minutes, ";
   payload += String(uptimeSeconds) + " seconds";
 
+  TimeSyncStatus timeSync;
+  time_service_get_status(&timeSync);
+  if (timeSync.synced) {
+    payload += "\nNTP: " + String(timeSync.server) + ", offset " + String(timeSync.offsetMs) + " ms";
+    payload += timeSync.stepped ? " (stepped)" : " (slewed)";
+    payload += ", delay " + String(timeSync.delayMs) + " ms, " + String(time_service_sync_age()) + " s ago";
+  } else {
+    payload += "\nNTP: not synchronized, " + String(timeSync.failures) + " failed rounds";
+  }
+
   // Publish the system status to a specific topic
   if (safe_mqtt_publish("esp32/status", payload.c_str())) {
     Serial.println("System status published successfully.");
@@ -327,6 +370,7 @@ void mqttKeepaliveTask(void * parameter) {
   while (true) {
     // Only try to reconnect if WiFi is connected
     if (WiFi.status() == WL_CONNECTED) {
+      xSemaphoreTake(mqttMutex, portMAX_DELAY);
       if (!client.connected()) {
         unsigned long now = millis();
         if (now - lastReconnectAttempt > reconnectInterval) {
@@ -337,6 +381,7 @@ void mqttKeepaliveTask(void * parameter) {
         // If connected, process MQTT messages
         client.loop();
       }
+      xSemaphoreGive(mqttMutex);
     }
     vTaskDelay(1000/portTICK_PERIOD_MS);  // Check every second
   }
@@ -381,10 +426,7 @@ String build_sensor_json_payload(int channel, const char* sensorType, const char
 // Uses schema with single data point
 // *********************************************************
 bool publish_sensor_data(int channel, const char* sensorType, float value, const char* timestamp, const char* unit) {
-  if (!client.connected()) {
-    mqtt_reconnect();
-  }
-  client.loop();
+  safe_mqtt_service();
   
   // Create single data point with proper name based on sensor type
   RegisterDataPoint dataPoint;
@@ -417,112 +459,139 @@ bool publish_sensor_data(int channel, const char* sensorType, float value, const
   }
 }
 
-bool publish_srne_inverter_data(int channel, const char* timestamp) {
-  if (!client.connected()) {
-    mqtt_reconnect();
-  }
-  client.loop();
+// *********************************************************
+// Publish one driver sample: the driver's point schema
+// supplies names and units, the sample the values and the
+// acquisition stamp, resolved to wall time here
+// *********************************************************
+bool publish_sensor_sample(int channel, const SensorDriver* driver, const SensorSample* sample) {
+  safe_mqtt_service();
   
-  SRNEInverterData data;
-  if (!read_srne_inverter_data(&data)) {
-    Serial.printf("Channel %d: Failed to read SRNE inverter data\n", channel);
-    return false;
+  char timestamp[TIME_ISO8601_SIZE];
+  format_mono_iso8601(sample->acquiredUs, timestamp, sizeof(timestamp));
+  RegisterDataPoint dataPoints[SENSOR_MAX_POINTS];
+  int count = min(sample->count, driver->pointCount);
+  for (int i = 0; i < count; i++) {
+    dataPoints[i] = {driver->points[i].name, sample->values[i], driver->points[i].unit, timestamp};
   }
   
-  // Create data points array with schema (name, value, unit, timestamp)
-  RegisterDataPoint dataPoints[46];
-  int idx = 0;
-  
-  dataPoints[idx++] = {"Battery SOC", data.battery_soc, "%", timestamp};
-  dataPoints[idx++] = {"Battery Voltage", data.battery_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Battery Current", data.battery_current, "A", timestamp};
-  dataPoints[idx++] = {"PV Voltage", data.pv_voltage, "V", timestamp};
-  dataPoints[idx++] = {"PV Current", data.pv_current, "A", timestamp};
-  dataPoints[idx++] = {"PV Power", data.pv_power, "W", timestamp};
-  dataPoints[idx++] = {"Battery Charge Power", data.battery_charge_power, "W", timestamp};
-  dataPoints[idx++] = {"Battery Type", data.battery_type, "", timestamp};
-  dataPoints[idx++] = {"Battery Over Voltage", data.battery_over_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Battery Equalizing Charge Voltage", data.battery_equalizing_charge_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Battery Boost Charge Voltage", data.battery_boost_charge_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Battery Float Charge Voltage", data.battery_float_charge_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Over Discharge Delay Time", data.over_discharge_delay_time, "min", timestamp};
-  dataPoints[idx++] = {"Battery Equalizing Charge Time", data.battery_equalizing_charge_time, "min", timestamp};
-  dataPoints[idx++] = {"Battery Equalizing Interval", data.battery_equalizing_interval, "days", timestamp};
-  dataPoints[idx++] = {"Battery Under Voltage Warning", data.battery_under_voltage_warning, "V", timestamp};
-  dataPoints[idx++] = {"Battery Over Discharge Voltage", data.battery_over_discharge_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Battery Limited Discharge Voltage", data.battery_limited_discharge_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Battery Boost Charge Time", data.battery_boost_charge_time, "min", timestamp};
-  dataPoints[idx++] = {"Battery Mains Switching Voltage", data.battery_mains_switching_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Battery Stop Charging Current", data.battery_stop_charging_current, "A", timestamp};
-  dataPoints[idx++] = {"Battery Number in Series", data.battery_number_in_series, "", timestamp};
-  dataPoints[idx++] = {"Inverter Switch Voltage", data.inverter_switch_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Battery Max Charge Current", data.battery_max_charge_current, "A", timestamp};
-  dataPoints[idx++] = {"Inverter Output Priority", data.inverter_output_priority, "", timestamp};
-  dataPoints[idx++] = {"Inverter Charge Priority", data.inverter_charge_priority, "", timestamp};
-  dataPoints[idx++] = {"Grid Battery Charge Max Current", data.grid_battery_charge_max_current, "A", timestamp};
-  dataPoints[idx++] = {"Inverter Charger Priority", data.inverter_charger_priority, "", timestamp};
-  dataPoints[idx++] = {"Inverter Alarm Control", data.inverter_alarm_control, "", timestamp};
-  dataPoints[idx++] = {"Machine State", data.machine_state, "", timestamp};
-  dataPoints[idx++] = {"Total Running Days", data.total_running_days, "days", timestamp};
-  dataPoints[idx++] = {"Grid Voltage", data.grid_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Grid Input Current", data.grid_input_current, "A", timestamp};
-  dataPoints[idx++] = {"Grid Frequency", data.grid_frequency, "Hz", timestamp};
-  dataPoints[idx++] = {"Inverter Voltage", data.inverter_voltage, "V", timestamp};
-  dataPoints[idx++] = {"Inverter Current", data.inverter_current, "A", timestamp};
-  dataPoints[idx++] = {"Inverter Frequency", data.inverter_frequency, "Hz", timestamp};
-  dataPoints[idx++] = {"Load Current", data.load_current, "A", timestamp};
-  dataPoints[idx++] = {"Inverter Power", data.inverter_power, "W", timestamp};
-  dataPoints[idx++] = {"Inverter Apparent Power", data.inverter_apparent_power, "VA", timestamp};
-  dataPoints[idx++] = {"Grid Battery Charge Current", data.grid_battery_charge_current, "A", timestamp};
-  dataPoints[idx++] = {"Temperature DC", data.temp_dc, "°C", timestamp};
-  dataPoints[idx++] = {"Temperature AC", data.temp_ac, "°C", timestamp};
-  dataPoints[idx++] = {"Temperature Transformer", data.temp_tr, "°C", timestamp};
-  dataPoints[idx++] = {"PV Battery Charge Current", data.pv_battery_charge_current, "A", timestamp};
-  
   // Build JSON using schema
   String topic = String(systemConfig.DEVICE_NAME) + "/sensor/" + String(channel);
-  String payload = build_sensor_json_payload(channel, "SRNEInverter", timestamp, dataPoints, 46);
+  String payload = build_sensor_json_payload(channel, driver->name, timestamp, dataPoints, count);
   
   if (safe_mqtt_publish(topic.c_str(), payload.c_str())) {
-    Serial.printf("Published SRNE Inverter data: Channel %d, Battery SOC: %.2f%%, Battery Voltage: %.2fV\n", 
-                  channel, data.battery_soc, data.battery_voltage);
+    Serial.printf("Published %s data: Channel %d, %s: %.2f%s (%d points)\n", driver->name, channel,
+                  dataPoints[0].name, dataPoints[0].value, dataPoints[0].unit, count);
     return true;
   } else {
-    Serial.printf("Failed to publish SRNE inverter data for channel %d\n", channel);
+    Serial.printf("Failed to publish %s data for channel %d\n", driver->name, channel);
     return false;
   }
 }
 
-bool publish_single_phase_meter_data(int channel, const char* timestamp) {
-  if (!client.connected()) {
-    mqtt_reconnect();
-  }
-  client.loop();
+// Inclinometer frame: one structured array point per message, each row holding a
+// segment's index, X, Y, Z and temperature; long arrays are split across messages
+bool publish_inclinometer_data(int channel) {
+  safe_mqtt_service();
   
-  SinglePhaseMeterData data;
-  if (!read_single_phase_meter_data(&data)) {
-    Serial.printf("Channel %d: Failed to read single phase meter data\n", channel);
+  const SAAFrame* frame = saa_take_frame();
+  saa_request_frame();  // the next frame is parsed in the background until the next interval
+  if (frame == nullptr) {
+    Serial.printf("Channel %d: No inclinometer frame received since last report\n", channel);
     return false;
   }
+  char timestamp[TIME_ISO8601_SIZE];
+  format_mono_iso8601(frame->completedUs, timestamp, sizeof(timestamp));
   
-  // Create data points array with schema (name, value, unit, timestamp)
-  RegisterDataPoint dataPoints[3];
-  dataPoints[0] = {"Voltage", data.voltage, "V", timestamp};
-  dataPoints[1] = {"Current", data.current, "A", timestamp};
-  dataPoints[2] = {"Frequency", data.frequency, "Hz", timestamp};
-  
-  // Build JSON using schema
   String topic = String(systemConfig.DEVICE_NAME) + "/sensor/" + String(channel);
-  String payload = build_sensor_json_payload(channel, "SinglePhaseMeter", timestamp, dataPoints, 3);
+  bool ok = true;
+  for (uint16_t offset = 0; offset < frame->segmentCount; offset += SAA_SEGMENTS_PER_MESSAGE) {
+    uint16_t count = min((uint16_t)SAA_SEGMENTS_PER_MESSAGE, (uint16_t)(frame->segmentCount - offset));
+    
+    String payload;
+    payload.reserve(320 + count * 56);
+    payload = "{";
+    payload += "\"device\":\"" + String(systemConfig.DEVICE_NAME) + "\",";
+    payload += "\"channel\":" + String(channel) + ",";
+    payload += "\"sensorType\":\"Inclinometer\",";
+    payload += "\"timestamp\":\"" + String(timestamp) + "\",";
+    payload += "\"serial\":" + String(frame->serial) + ",";
+    payload += "\"frame\":" + String(frame->sequence) + ",";
+    payload += "\"segments\":" + String(frame->segmentCount) + ",";
+    payload += "\"data\":[{";
+    payload += "\"name\":\"Segments\",";
+    payload += "\"fields\":[\"Segment\",\"X\",\"Y\",\"Z\",\"Temperature\"],";
+    payload += "\"units\":[\"\",\"g\",\"g\",\"g\",\"C\"],";
+    payload += "\"values\":[";
+    for (uint16_t i = 0; i < count; i++) {
+      const SAASegment* segment = &frame->segments[offset + i];
+      char row[64];
+      snprintf(row, sizeof(row), "%s[%u,%.5f,%.5f,%.5f,%.2f]", i > 0 ? "," : "",
+               offset + i + 1, segment->x, segment->y, segment->z, segment->temperature);
+      payload += row;
+    }
+    payload += "],";
+    payload += "\"timestamp\":\"" + String(timestamp) + "\"";
+    payload += "}]";
+    payload += "}";
+    
+    if (!safe_mqtt_publish(topic.c_str(), payload.c_str())) {
+      ok = false;
+    }
+  }
   
-  if (safe_mqtt_publish(topic.c_str(), payload.c_str())) {
-    Serial.printf("Published Single Phase Meter data: Channel %d, Voltage: %.2fV, Current: %.2fA, Frequency: %.2fHz\n", 
-                  channel, data.voltage, data.current, data.frequency);
-    return true;
+  if (ok) {
+    Serial.printf("Published Inclinometer data: Channel %d, Serial %lu, Frame %lu, %u segments\n", 
+                  channel, frame->serial, frame->sequence, frame->segmentCount);
   } else {
-    Serial.printf("Failed to publish single phase meter data for channel %d\n", channel);
+    Serial.printf("Failed to publish inclinometer data for channel %d\n", channel);
+  }
+  return ok;
+}
+
+// Event record: a JSON header on <device>/event/<channel>, then the waveform as raw
+// little-endian int16 counts in parts on <device>/event/<channel>/<id>/<part>
+bool publish_trigger_event(const TriggerEvent* event) {
+  static const char* modeNames[] = {"threshold", "sta_lta", "slope"};
+  const size_t partSamples = 1024;  // 2 KB per message, well inside the client buffer
+  size_t parts = (event->count + partSamples - 1) / partSamples;
+  safe_mqtt_service();
+  
+  char timestamp[TIME_ISO8601_SIZE];
+  format_mono_iso8601(event->triggerUs, timestamp, sizeof(timestamp));
+  
+  String header = "{";
+  header += "\"device\":\"" + String(systemConfig.DEVICE_NAME) + "\",";
+  header += "\"channel\":" + String(event->channel) + ",";
+  header += "\"event\":" + String(event->id) + ",";
+  header += "\"timestamp\":\"" + String(timestamp) + "\",";
+  header += "\"trigger\":\"" + String(modeNames[event->mode]) + "\",";
+  header += "\"triggerValue\":" + String(event->triggerValue, 2) + ",";
+  header += "\"sampleRate\":" + String(event->sampleRate) + ",";
+  header += "\"preTriggerSamples\":" + String((unsigned)event->preSamples) + ",";
+  header += "\"samples\":" + String((unsigned)event->count) + ",";
+  header += "\"peak\":" + String(event->peak) + ",";
+  header += "\"format\":\"int16le\",";
+  header += "\"parts\":" + String((unsigned)parts);
+  header += "}";
+  
+  String topic = String(systemConfig.DEVICE_NAME) + "/event/" + String(event->channel);
+  if (!safe_mqtt_publish(topic.c_str(), header.c_str())) {
     return false;
   }
+  for (size_t part = 0; part < parts; part++) {
+    size_t first = part * partSamples;
+    size_t count = min(partSamples, event->count - first);
+    String partTopic = topic + "/" + String(event->id) + "/" + String(part);
+    // ESP32 is little-endian, so the sample buffer is already in wire format
+    if (!safe_mqtt_publish_binary(partTopic.c_str(), (const uint8_t*)(event->samples + first),
+                                  count * sizeof(int16_t))) {
+      return false;
+    }
+  }
+  Serial.printf("Published trigger event %lu: Channel %d, %d samples, peak %d\n",
+                event->id, event->channel, (int)event->count, event->peak);
+  return true;
 }
 
 // Function to reinitialize MQTT with new server settings
@@ -0,0 +1,175 @@
+#include "rain_gauge.h"
+#include "configuration.h"
+#include <Preferences.h>
+#include "driver/pcnt.h"
+
+struct RainGauge {
+  int channel;
+  bool initialized;
+  pcnt_unit_t unit;
+  volatile uint32_t overflows;   // counter wraps, bumped by the PCNT ISR
+  uint32_t lastCount;            // running count at the previous read
+  uint64_t totalTips;            // persisted total
+};
+
+// One per PCNT unit, in the order the channels were initialized
+static RainGauge rainGauges[RAIN_GAUGE_MAX];
+static int rainGaugeUnits = 0;
+static portMUX_TYPE rainMux = portMUX_INITIALIZER_UNLOCKED;
+static Preferences rainPreferences;
+
+static void IRAM_ATTR rain_gauge_overflow_isr(void* arg) {
+  RainGauge* gauge = (RainGauge*)arg;
+  uint32_t status = 0;
+  pcnt_get_event_status(gauge->unit, &status);
+  if (status & PCNT_EVT_H_LIM) {
+    portENTER_CRITICAL_ISR(&rainMux);
+    gauge->overflows++;
+    portEXIT_CRITICAL_ISR(&rainMux);
+  }
+}
+
+// Tips since init as one running number. The counter is never cleared, so there is no
+// window between "read" and "reset" in which a tip could be lost.
+static uint32_t rain_gauge_running_count(RainGauge* gauge) {
+  while (true) {
+    portENTER_CRITICAL(&rainMux);
+    uint32_t before = gauge->overflows;
+    portEXIT_CRITICAL(&rainMux);
+
+    int16_t count = 0;
+    pcnt_get_counter_value(gauge->unit, &count);
+
+    portENTER_CRITICAL(&rainMux);
+    uint32_t after = gauge->overflows;
+    portEXIT_CRITICAL(&rainMux);
+
+    // A wrap between the two reads would pair a new count with an old overflow total
+    if (before != after) {
+      continue;
+    }
+    uint32_t running = after * (uint32_t)RAIN_PCNT_LIMIT + (uint16_t)count;
+    // Counter already wrapped but the overflow ISR has not run yet
+    if (running < gauge->lastCount) {
+      delay(1);
+      continue;
+    }
+    return running;
+  }
+}
+
+static RainGauge* rain_gauge_find(int channel) {
+  for (int i = 0; i < rainGaugeUnits; i++) {
+    if (rainGauges[i].channel == channel) {
+      return &rainGauges[i];
+    }
+  }
+  return nullptr;
+}
+
+static void rain_gauge_key(int channel, char* key, size_t len) {
+  snprintf(key, len, "total%d", channel);
+}
+
+bool rain_gauge_init(int channel, uint8_t pin) {
+  if (channel < 0 || channel >= CHANNEL_COUNT_MAX) {
+    return false;
+  }
+  if (rain_gauge_find(channel) != nullptr) {
+    return true;
+  }
+  if (rainGaugeUnits >= RAIN_GAUGE_MAX) {
+    Serial.printf("Channel %d: no PCNT unit left for rain gauge\n", channel);
+    return false;
+  }
+  RainGauge* gauge = &rainGauges[rainGaugeUnits];
+  gauge->channel = channel;
+  gauge->unit = (pcnt_unit_t)rainGaugeUnits;
+
+  pcnt_config_t config = {};
+  config.pulse_gpio_num = pin;
+  config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+  config.lctrl_mode = PCNT_MODE_KEEP;
+  config.hctrl_mode = PCNT_MODE_KEEP;
+  config.pos_mode = PCNT_COUNT_INC;   // count rising edges only
+  config.neg_mode = PCNT_COUNT_DIS;
+  config.counter_h_lim = RAIN_PCNT_LIMIT;
+  config.counter_l_lim = 0;
+  config.unit = gauge->unit;
+  config.channel = PCNT_CHANNEL_0;
+  if (pcnt_unit_config(&config) != ESP_OK) {
+    Serial.printf("Channel %d: PCNT setup failed on GPIO%d\n", channel, pin);
+    return false;
+  }
+  pinMode(pin, INPUT_PULLUP);  // reed switch to ground
+
+  pcnt_set_filter_value(gauge->unit, RAIN_PCNT_FILTER);
+  pcnt_filter_enable(gauge->unit);
+
+  // The only interrupt: the counter reaching its limit and wrapping to 0
+  pcnt_event_enable(gauge->unit, PCNT_EVT_H_LIM);
+  if (rainGaugeUnits == 0) {
+    pcnt_isr_service_install(0);
+  }
+  pcnt_isr_handler_add(gauge->unit, rain_gauge_overflow_isr, gauge);
+
+  pcnt_counter_pause(gauge->unit);
+  pcnt_counter_clear(gauge->unit);
+  pcnt_counter_resume(gauge->unit);
+
+  char key[12];
+  rain_gauge_key(channel, key, sizeof(key));
+  rainPreferences.begin("raingauge", true);
+  gauge->totalTips = rainPreferences.getULong64(key, 0);
+  rainPreferences.end();
+
+  gauge->overflows = 0;
+  gauge->lastCount = 0;
+  gauge->initialized = true;
+  rainGaugeUnits++;
+
+  Serial.printf("Channel %d: rain gauge on GPIO%d (PCNT unit %d), total %.1f mm\n",
+                channel, pin, gauge->unit, gauge->totalTips * RAIN_MM_PER_TIP);
+  return true;
+}
+
+bool rain_gauge_read(int channel, RainGaugeReading* reading) {
+  RainGauge* gauge = rain_gauge_find(channel);
+  if (gauge == nullptr || !gauge->initialized) {
+    return false;
+  }
+
+  uint32_t count = rain_gauge_running_count(gauge);
+  uint32_t tips = count - gauge->lastCount;
+  gauge->lastCount = count;
+
+  if (tips > 0) {
+    gauge->totalTips += tips;
+    // Only written when it rained, so dry spells cost no flash wear
+    char key[12];
+    rain_gauge_key(channel, key, sizeof(key));
+    rainPreferences.begin("raingauge", false);
+    rainPreferences.putULong64(key, gauge->totalTips);
+    rainPreferences.end();
+  }
+
+  reading->tips = tips;
+  reading->rainfall = tips * RAIN_MM_PER_TIP;
+  reading->total = gauge->totalTips * RAIN_MM_PER_TIP;
+  return true;
+}
+
+void rain_gauge_clear_total(int channel) {
+  if (channel < 0 || channel >= CHANNEL_COUNT_MAX) {
+    return;
+  }
+  RainGauge* gauge = rain_gauge_find(channel);
+  if (gauge != nullptr) {
+    gauge->totalTips = 0;
+  }
+  char key[12];
+  rain_gauge_key(channel, key, sizeof(key));
+  rainPreferences.begin("raingauge", false);
+  rainPreferences.remove(key);
+  rainPreferences.end();
+}
@@ -0,0 +1,102 @@
+#include "rtc_drift.h"
+#include <Preferences.h>
+
+// Kept apart from the RTC access in utils.cpp so it builds without RTClib (native build)
+
+static RtcDriftState rtcDrift;
+static portMUX_TYPE rtcDriftMux = portMUX_INITIALIZER_UNLOCKED;
+static Preferences rtcDriftPreferences;
+
+static void rtc_drift_save(const RtcDriftState* state) {
+  rtcDriftPreferences.begin("rtcdrift", false);
+  rtcDriftPreferences.putLong64("setAt", state->referenced ? state->setAtUs : 0);
+  rtcDriftPreferences.putFloat("ppm", state->ppm);
+  rtcDriftPreferences.putUShort("estimates", state->estimates);
+  rtcDriftPreferences.end();
+}
+
+void rtc_drift_load() {
+  RtcDriftState state = {};
+  rtcDriftPreferences.begin("rtcdrift", true);
+  state.setAtUs = rtcDriftPreferences.getLong64("setAt", 0);
+  state.ppm = rtcDriftPreferences.getFloat("ppm", 0);
+  state.estimates = rtcDriftPreferences.getUShort("estimates", 0);
+  rtcDriftPreferences.end();
+  state.referenced = state.setAtUs > 0;
+  if (fabsf(state.ppm) > RTC_DRIFT_MAX_PPM) {
+    state.ppm = 0;
+    state.estimates = 0;
+  }
+
+  portENTER_CRITICAL(&rtcDriftMux);
+  rtcDrift = state;
+  portEXIT_CRITICAL(&rtcDriftMux);
+  if (state.estimates > 0) {
+    Serial.printf("RTC drift: %.2f ppm from %u windows\n", state.ppm, state.estimates);
+  }
+}
+
+void rtc_drift_get(RtcDriftState* state) {
+  portENTER_CRITICAL(&rtcDriftMux);
+  *state = rtcDrift;
+  portEXIT_CRITICAL(&rtcDriftMux);
+}
+
+int64_t rtc_drift_compensate(int64_t rtcUs) {
+  RtcDriftState state;
+  rtc_drift_get(&state);
+  if (!state.referenced || state.estimates == 0 || rtcUs < state.setAtUs) {
+    return rtcUs;
+  }
+  double rtcElapsed = (double)(rtcUs - state.setAtUs);
+  return state.setAtUs + (int64_t)(rtcElapsed / (1.0 + state.ppm * 1e-6));
+}
+
+bool rtc_drift_observe(int64_t rtcUs, int64_t trueUs) {
+  RtcDriftState state;
+  rtc_drift_get(&state);
+  int64_t elapsed = trueUs - state.setAtUs;
+  if (!state.referenced || elapsed <= 0) {
+    return true;
+  }
+
+  // Far from what any crystal could do: the RTC was set by hand, lost power or stopped
+  int64_t error = rtcUs - trueUs;
+  double predicted = state.estimates > 0 ? elapsed * state.ppm * 1e-6 : 0;
+  if (fabs(error - predicted) > elapsed * (RTC_DRIFT_MAX_PPM * 1e-6) + RTC_DRIFT_SLACK_US) {
+    Serial.printf("RTC drift: RTC off by %lld ms after %lld h, not used for the estimate\n",
+                  (long long)(error / 1000), (long long)(elapsed / 3600000000LL));
+    return true;
+  }
+  if (elapsed < RTC_DRIFT_MIN_WINDOW_S * 1000000LL) {
+    return false;  // keep the RTC running undisturbed until the window is long enough
+  }
+
+  float measured = (float)(error * 1e6 / elapsed);
+  if (state.estimates == 0) {
+    state.ppm = measured;
+  } else {
+    state.ppm += (measured - state.ppm) / RTC_DRIFT_WEIGHT;
+  }
+  if (state.estimates < UINT16_MAX) {
+    state.estimates++;
+  }
+  portENTER_CRITICAL(&rtcDriftMux);
+  rtcDrift.ppm = state.ppm;
+  rtcDrift.estimates = state.estimates;
+  portEXIT_CRITICAL(&rtcDriftMux);
+  rtc_drift_save(&state);
+  Serial.printf("RTC drift: %.2f ppm over %lld h, estimate %.2f ppm\n", measured,
+                (long long)(elapsed / 3600000000LL), state.ppm);
+  return true;
+}
+
+void rtc_drift_reference(int64_t trueUs) {
+  RtcDriftState state;
+  portENTER_CRITICAL(&rtcDriftMux);
+  rtcDrift.referenced = true;
+  rtcDrift.setAtUs = trueUs;
+  state = rtcDrift;
+  portEXIT_CRITICAL(&rtcDriftMux);
+  rtc_drift_save(&state);
+}
@@ -0,0 +1,389 @@
+#include "sensor_driver.h"
+#include "single_phase_meter.h"
+#include "srne_inverter.h"
+#include "vibrating_wire.h"
+#include "bme280.h"
+#include "geophone.h"
+#include "trigger.h"
+#include "rain_gauge.h"
+#include "inclinometer.h"
+#include "mqtt.h"
+
+/******************************************************************
+ *                                                                *
+ *                        Modbus devices                          *
+ *                                                                *
+ ******************************************************************/
+
+static const SensorPoint singlePhaseMeterPoints[] = {
+  {"Voltage", "V"},
+  {"Current", "A"},
+  {"Frequency", "Hz"},
+};
+
+static bool single_phase_meter_driver_init(int channel, const ChannelConfig* config) {
+  single_phase_meter_init(config->bus);
+  return true;
+}
+
+static bool single_phase_meter_driver_read(int channel, const ChannelConfig* config, SensorSample* sample) {
+  SinglePhaseMeterData data;
+  if (!read_single_phase_meter_data(config->bus, &data)) {
+    return false;
+  }
+  sample->values[0] = data.voltage;
+  sample->values[1] = data.current;
+  sample->values[2] = data.frequency;
+  return true;
+}
+
+static const SensorPoint srneInverterPoints[] = {
+  {"Battery SOC", "%"},
+  {"Battery Voltage", "V"},
+  {"Battery Current", "A"},
+  {"PV Voltage", "V"},
+  {"PV Current", "A"},
+  {"PV Power", "W"},
+  {"Battery Charge Power", "W"},
+  {"Battery Type", ""},
+  {"Battery Over Voltage", "V"},
+  {"Battery Equalizing Charge Voltage", "V"},
+  {"Battery Boost Charge Voltage", "V"},
+  {"Battery Float Charge Voltage", "V"},
+  {"Over Discharge Delay Time", "min"},
+  {"Battery Equalizing Charge Time", "min"},
+  {"Battery Equalizing Interval", "days"},
+  {"Battery Under Voltage Warning", "V"},
+  {"Battery Over Discharge Voltage", "V"},
+  {"Battery Limited Discharge Voltage", "V"},
+  {"Battery Boost Charge Time", "min"},
+  {"Battery Mains Switching Voltage", "V"},
+  {"Battery Stop Charging Current", "A"},
+  {"Battery Number in Series", ""},
+  {"Inverter Switch Voltage", "V"},
+  {"Battery Max Charge Current", "A"},
+  {"Inverter Output Priority", ""},
+  {"Inverter Charge Priority", ""},
+  {"Grid Battery Charge Max Current", "A"},
+  {"Inverter Charger Priority", ""},
+  {"Inverter Alarm Control", ""},
+  {"Machine State", ""},
+  {"Total Running Days", "days"},
+  {"Grid Voltage", "V"},
+  {"Grid Input Current", "A"},
+  {"Grid Frequency", "Hz"},
+  {"Inverter Voltage", "V"},
+  {"Inverter Current", "A"},
+  {"Inverter Frequency", "Hz"},
+  {"Load Current", "A"},
+  {"Inverter Power", "W"},
+  {"Inverter Apparent Power", "VA"},
+  {"Grid Battery Charge Current", "A"},
+  {"Temperature DC", "°C"},
+  {"Temperature AC", "°C"},
+  {"Temperature Transformer", "°C"},
+  {"PV Battery Charge Current", "A"},
+};
+
+static bool srne_inverter_driver_init(int channel, const ChannelConfig* config) {
+  srne_inverter_init(config->bus);
+  return true;
+}
+
+static bool srne_inverter_driver_read(int channel, const ChannelConfig* config, SensorSample* sample) {
+  SRNEInverterData data;
+  if (!read_srne_inverter_data(config->bus, &data)) {
+    return false;
+  }
+  float* v = sample->values;
+  *v++ = data.battery_soc;
+  *v++ = data.battery_voltage;
+  *v++ = data.battery_current;
+  *v++ = data.pv_voltage;
+  *v++ = data.pv_current;
+  *v++ = data.pv_power;
+  *v++ = data.battery_charge_power;
+  *v++ = data.battery_type;
+  *v++ = data.battery_over_voltage;
+  *v++ = data.battery_equalizing_charge_voltage;
+  *v++ = data.battery_boost_charge_voltage;
+  *v++ = data.battery_float_charge_voltage;
+  *v++ = data.over_discharge_delay_time;
+  *v++ = data.battery_equalizing_charge_time;
+  *v++ = data.battery_equalizing_interval;
+  *v++ = data.battery_under_voltage_warning;
+  *v++ = data.battery_over_discharge_voltage;
+  *v++ = data.battery_limited_discharge_voltage;
+  *v++ = data.battery_boost_charge_time;
+  *v++ = data.battery_mains_switching_voltage;
+  *v++ = data.battery_stop_charging_current;
+  *v++ = data.battery_number_in_series;
+  *v++ = data.inverter_switch_voltage;
+  *v++ = data.battery_max_charge_current;
+  *v++ = data.inverter_output_priority;
+  *v++ = data.inverter_charge_priority;
+  *v++ = data.grid_battery_charge_max_current;
+  *v++ = data.inverter_charger_priority;
+  *v++ = data.inverter_alarm_control;
+  *v++ = data.machine_state;
+  *v++ = data.total_running_days;
+  *v++ = data.grid_voltage;
+  *v++ = data.grid_input_current;
+  *v++ = data.grid_frequency;
+  *v++ = data.inverter_voltage;
+  *v++ = data.inverter_current;
+  *v++ = data.inverter_frequency;
+  *v++ = data.load_current;
+  *v++ = data.inverter_power;
+  *v++ = data.inverter_apparent_power;
+  *v++ = data.grid_battery_charge_current;
+  *v++ = data.temp_dc;
+  *v++ = data.temp_ac;
+  *v++ = data.temp_tr;
+  *v++ = data.pv_battery_charge_current;
+  return true;
+}
+
+/******************************************************************
+ *                                                                *
+ *                        Local sensors                           *
+ *                                                                *
+ ******************************************************************/
+
+// The native build has no ADC, I2S, PCNT or I2C hardware behind these drivers
+#ifndef NATIVE_BUILD
+
+static const SensorPoint vibratingWirePoints[] = {
+  {"Frequency", "Hz"},
+  {"Temperature", "C"},
+};
+
+static bool vibrating_wire_driver_init(int channel, const ChannelConfig* config) {
+  static bool initialized = false;
+  if (!initialized) {
+    vm501_init();
+    vw_mux_init();
+    initialized = true;
+  }
+  return true;
+}
+
+// Every due gauge in one pipelined sweep through the mux
+static size_t vibrating_wire_driver_read_batch(const int* channels, const ChannelConfig* const* configs, size_t count,
+                                               SensorSample* samples) {
+  uint8_t muxChannels[SENSOR_BATCH_MAX];
+  VM501Reading readings[SENSOR_BATCH_MAX];
+  count = min(count, (size_t)SENSOR_BATCH_MAX);
+  for (size_t k = 0; k < count; k++) {
+    muxChannels[k] = configs[k]->pin;
+  }
+  size_t good = vw_sweep(muxChannels, count, readings);
+  for (size_t k = 0; k < count; k++) {
+    if (readings[k].result != MODBUS_OK) {
+      Serial.printf("Channel %d: Failed to read VM501 (error 0x%02X)\n", channels[k], readings[k].result);
+      samples[k].count = 0;
+      continue;
+    }
+    samples[k].values[0] = readings[k].frequency;
+    samples[k].values[1] = readings[k].temperature;
+    samples[k].count = 2;
+  }
+  return good;
+}
+
+static bool vibrating_wire_driver_read(int channel, const ChannelConfig* config, SensorSample* sample) {
+  return vibrating_wire_driver_read_batch(&channel, &config, 1, sample) == 1;
+}
+
+static const SensorPoint barometricPoints[] = {
+  {"Pressure", "hPa"},
+  {"Temperature", "C"},
+  {"Humidity", "%"},
+};
+
+static bool barometric_driver_init(int channel, const ChannelConfig* config) {
+  return bme280_init(config->bus);
+}
+
+static bool barometric_driver_read(int channel, const ChannelConfig* config, SensorSample* sample) {
+  BME280Data data;
+  if (!bme280_read(config->bus, &data)) {
+    return false;
+  }
+  sample->values[0] = data.pressure;
+  sample->values[1] = data.temperature;
+  sample->values[2] = data.humidity;
+  return true;
+}
+
+static const SensorPoint geophonePoints[] = {
+  {"PPV", "mm/s"},
+  {"Dominant Frequency", "Hz"},
+  {"Band 1Hz", "mm2/s2"},
+  {"Band 2Hz", "mm2/s2"},
+  {"Band 4Hz", "mm2/s2"},
+  {"Band 8Hz", "mm2/s2"},
+  {"Band 16Hz", "mm2/s2"},
+  {"Band 31.5Hz", "mm2/s2"},
+  {"Band 63Hz", "mm2/s2"},
+  {"Band 125Hz", "mm2/s2"},
+  {"Band 250Hz", "mm2/s2"},
+  {"Band 500Hz", "mm2/s2"},
+  {"Sample Rate", "Hz"},
+  {"Dropped Blocks", ""},
+};
+static_assert(sizeof(geophonePoints) / sizeof(geophonePoints[0]) == 4 + SPECTRAL_OCTAVE_BANDS,
+              "one point per octave band");
+
+// One ADC1 channel can be sampled continuously
+static bool geophone_driver_init(int channel, const ChannelConfig* config) {
+  static int geophoneChannel = -1;
+  if (geophoneChannel >= 0) {
+    Serial.printf("Channel %d: only one geophone channel is supported, channel ignored\n", channel);
+    return false;
+  }
+  if (!geophone_init(config->pin)) {
+    return false;
+  }
+  geophoneChannel = channel;
+
+  // Waveforms only leave the device around events
+  TriggerConfig trigger = {TRIGGER_STA_LTA, GEOPHONE_TRIGGER_RATIO, 50, 5000,
+                           GEOPHONE_TRIGGER_PRE_MS, GEOPHONE_TRIGGER_POST_MS, 1000};
+  TriggerEngine* engine = trigger_create(channel, GEOPHONE_SAMPLE_RATE, &trigger);
+  if (engine != nullptr) {
+    geophone_add_consumer(trigger_consumer, engine);
+  }
+  return true;
+}
+
+// Sampled continuously by the DMA pipeline; only the features of the last interval leave the device
+static bool geophone_driver_read(int channel, const ChannelConfig* config, SensorSample* sample) {
+  GeophoneFeatures features;
+  if (!geophone_take_features(&features)) {
+    Serial.printf("Channel %d: No geophone windows analysed since last report\n", channel);
+    return false;
+  }
+  GeophoneStats stats;
+  geophone_get_stats(&stats);
+
+  float* v = sample->values;
+  *v++ = features.ppv;
+  *v++ = features.dominantFrequency;
+  for (int band = 0; band < SPECTRAL_OCTAVE_BANDS; band++) {
+    *v++ = features.bandEnergy[band];
+  }
+  *v++ = stats.sampleRate;
+  *v++ = (float)stats.droppedBlocks;
+  return true;
+}
+
+static const SensorPoint rainGaugePoints[] = {
+  {"Rainfall", "mm"},
+  {"Tips", ""},
+  {"Total Rainfall", "mm"},
+};
+
+static bool rain_gauge_driver_init(int channel, const ChannelConfig* config) {
+  return rain_gauge_init(channel, config->pin);
+}
+
+// Tips are counted in hardware; the read returns the count since the last interval
+static bool rain_gauge_driver_read(int channel, const ChannelConfig* config, SensorSample* sample) {
+  RainGaugeReading reading;
+  if (!rain_gauge_read(channel, &reading)) {
+    return false;
+  }
+  sample->values[0] = reading.rainfall;
+  sample->values[1] = (float)reading.tips;
+  sample->values[2] = reading.total;
+  return true;
+}
+
+#endif  // NATIVE_BUILD
+
+// One array on Serial2; frames are parsed off the UART as they arrive
+static bool inclinometer_driver_init(int channel, const ChannelConfig* config) {
+  if (!saa_init()) {
+    return false;
+  }
+  saa_request_frame();
+  return true;
+}
+
+static bool inclinometer_driver_publish(int channel, const ChannelConfig* config) {
+  return publish_inclinometer_data(channel);
+}
+
+/******************************************************************
+ *                                                                *
+ *                           Registry                             *
+ *                                                                *
+ ******************************************************************/
+
+#define SENSOR_POINTS(points) points, (int)(sizeof(points) / sizeof(points[0]))
+
+static const SensorDriver singlePhaseMeterDriver = {
+  "SinglePhaseMeter", SENSOR_AFFINITY_RS485, 0, 60, SENSOR_POINTS(singlePhaseMeterPoints),
+  single_phase_meter_driver_init, single_phase_meter_driver_read, nullptr, nullptr,
+};
+
+static const SensorDriver srneInverterDriver = {
+  "SRNEInverter", SENSOR_AFFINITY_RS485, 0, 400, SENSOR_POINTS(srneInverterPoints),
+  srne_inverter_driver_init, srne_inverter_driver_read, nullptr, nullptr,
+};
+
+#ifndef NATIVE_BUILD
+// VM501 uses UART1 on GPIO16/17: RS485 bus 0's pins and bus 1's UART
+static const SensorDriver vibratingWireDriver = {
+  "VibratingWire", SENSOR_AFFINITY_LOCAL, 0x03, VW_MUX_SETTLE_MS + VW_EXCITATION_MS, SENSOR_POINTS(vibratingWirePoints),
+  vibrating_wire_driver_init, vibrating_wire_driver_read, vibrating_wire_driver_read_batch, nullptr,
+};
+
+static const SensorDriver barometricDriver = {
+  "Barometric", SENSOR_AFFINITY_LOCAL, 0, 10, SENSOR_POINTS(barometricPoints),
+  barometric_driver_init, barometric_driver_read, nullptr, nullptr,
+};
+
+static const SensorDriver geophoneDriver = {
+  "GeoPhone", SENSOR_AFFINITY_LOCAL, 0, 1, SENSOR_POINTS(geophonePoints),
+  geophone_driver_init, geophone_driver_read, nullptr, nullptr,
+};
+
+static const SensorDriver rainGaugeDriver = {
+  "RainGauge", SENSOR_AFFINITY_LOCAL, 0, 1, SENSOR_POINTS(rainGaugePoints),
+  rain_gauge_driver_init, rain_gauge_driver_read, nullptr, nullptr,
+};
+
+#define LOCAL_SENSOR_DRIVER(driver) &driver
+#else
+#define LOCAL_SENSOR_DRIVER(driver) nullptr
+#endif
+
+// Serial2 on GPIO16/17, RS485 bus 0's UART and pins; segment arrays are published as rows
+static const SensorDriver inclinometerDriver = {
+  "Inclinometer", SENSOR_AFFINITY_LOCAL, 0x01, 50, nullptr, 0,
+  inclinometer_driver_init, nullptr, nullptr, inclinometer_driver_publish,
+};
+
+// Indexed by SensorType
+static const SensorDriver* const sensorDrivers[] = {
+  nullptr,                                   // Unknown
+  LOCAL_SENSOR_DRIVER(vibratingWireDriver),  // VibratingWire
+  LOCAL_SENSOR_DRIVER(barometricDriver),     // Barometric
+  LOCAL_SENSOR_DRIVER(geophoneDriver),       // GeoPhone
+  &inclinometerDriver,                       // Inclinometer
+  LOCAL_SENSOR_DRIVER(rainGaugeDriver),      // RainGauege
+  &singlePhaseMeterDriver,                   // SinglePhaseMeter
+  &srneInverterDriver,                       // SRNEInverter
+};
+
+static_assert(sizeof(sensorDrivers) / sizeof(sensorDrivers[0]) == SRNEInverter + 1,
+              "every SensorType needs a registry entry");
+
+const SensorDriver* sensor_driver(SensorType type) {
+  if (type >= sizeof(sensorDrivers) / sizeof(sensorDrivers[0])) {
+    return nullptr;
+  }
+  return sensorDrivers[type];
+}
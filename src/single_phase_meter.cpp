@@ -1,45 +1,36 @@
 #include "single_phase_meter.h"
 
-ModbusMaster modbusNode;
+// Learned per-register state for voltage, current and frequency, one set per bus
+static ModbusRegisterHealth meterRegisterHealth[RS485_BUS_COUNT][3];
+static unsigned long meterLastResponseMs[RS485_BUS_COUNT];
 
-// Callback to switch MAX485 to Transmit mode
-void preTransmission() {
-  digitalWrite(RE_DE, HIGH);
-  delayMicroseconds(100);
-}
-
-// Callback to switch MAX485 to Receive mode
-void postTransmission() {
-  delayMicroseconds(100);
-  digitalWrite(RE_DE, LOW);
-}
-
-void single_phase_meter_init() {
-  Serial.println("Initializing Single Phase Meter (Modbus RS485)...");
-  
-  // Initialize Serial2 for Modbus communication
-  Serial2.begin(MODBUS_BAUD_RATE, SERIAL_8N1, RXD2, TXD2);
+void single_phase_meter_init(int bus) {
+  Serial.printf("Initializing Single Phase Meter (Modbus RS485 bus %d)...\n", bus);
   
-  // Configure RE/DE pin for RS485 direction control
-  pinMode(RE_DE, OUTPUT);
-  digitalWrite(RE_DE, LOW);  // Start in receive mode
-  
-  // Initialize ModbusMaster with slave ID
-  modbusNode.begin(MODBUS_SLAVE_ID, Serial2);
-  
-  // Register callbacks for RS485 direction control
-  modbusNode.preTransmission(preTransmission);
-  modbusNode.postTransmission(postTransmission);
+  // The bus may be shared with an SRNE inverter; line speed is set per bus
+  if (rs485_bus_init(bus) == nullptr) {
+    return;
+  }
   
   Serial.println("Single Phase Meter initialized successfully");
 }
 
 // Helper function to read a holding register with error handling
-static float read_register_with_multiplier(uint16_t registerAddress, float multiplier, const char* registerName) {
-  uint8_t result = modbusNode.readHoldingRegisters(registerAddress, 1);
+static float read_register_with_multiplier(int bus, uint16_t registerAddress, float multiplier,
+                                          const char* registerName, int healthIndex) {
+  if (!rs485_bus_available(bus)) {
+    return -1.0f;
+  }
+  uint16_t rawValue;
+  // Timeouts only count against a register while the meter answers others
+  bool meterAlive = meterLastResponseMs[bus] != 0 && (millis() - meterLastResponseMs[bus]) < 5UL * 60UL * 1000UL;
+  uint8_t result = modbus_read_holding_registers_retry(&rs485Buses[bus], MODBUS_SLAVE_ID, registerAddress, 1,
+                                                       &rawValue, &meterRegisterHealth[bus][healthIndex], meterAlive);
+  if (result != MODBUS_ERR_RESPONSE_TIMEOUT && result != MODBUS_ERR_INVALID_CRC) {
+    meterLastResponseMs[bus] = millis();
+  }
   
-  if (result == modbusNode.ku8MBSuccess) {
-    uint16_t rawValue = modbusNode.getResponseBuffer(0);
+  if (result == MODBUS_OK) {
     // Convert raw value to float using specific multiplier
     float value = rawValue * multiplier;
     return value;
@@ -56,18 +47,18 @@ static float read_register_with_multiplier(uint16_t registerAddress, float multi
 }
 
 // Read voltage register (multiplier: 0.1)
-float read_voltage_register() {
-  return read_register_with_multiplier(SINGLE_PHASE_REG_VOLTAGE, 0.1f, "Voltage");
+float read_voltage_register(int bus) {
+  return read_register_with_multiplier(bus, SINGLE_PHASE_REG_VOLTAGE, 0.1f, "Voltage", 0);
 }
 
 // Read current register (multiplier: 0.1)
-float read_current_register() {
-  return read_register_with_multiplier(SINGLE_PHASE_REG_CURRENT, 0.1f, "Current");
+float read_current_register(int bus) {
+  return read_register_with_multiplier(bus, SINGLE_PHASE_REG_CURRENT, 0.1f, "Current", 1);
 }
 
 // Read frequency register (multiplier: 0.01)
-float read_frequency_register() {
-  return read_register_with_multiplier(SINGLE_PHASE_REG_FREQUENCY, 0.01f, "Frequency");
+float read_frequency_register(int bus) {
+  return read_register_with_multiplier(bus, SINGLE_PHASE_REG_FREQUENCY, 0.01f, "Frequency", 2);
 }
 
 // Legacy function for backward compatibility
@@ -76,8 +67,8 @@ float read_voltage_from_meter() {
 }
 
 // Read all single phase meter data
-bool read_single_phase_meter_data(SinglePhaseMeterData* data) {
-  if (data == nullptr) {
+bool read_single_phase_meter_data(int bus, SinglePhaseMeterData* data) {
+  if (data == nullptr || !rs485_bus_available(bus)) {
     return false;
   }
   
@@ -89,22 +80,42 @@ bool read_single_phase_meter_data(SinglePhaseMeterData* data) {
   
   unsigned long startTime = millis();
   
-  // Read voltage (multiplier: 0.1)
-  data->voltage = read_voltage_register();
-  vTaskDelay(5 / portTICK_PERIOD_MS);  // Yield CPU between reads
+  // Voltage (x0.1), current (x0.1) and frequency (x0.01) back to back on the bus
+  static const uint16_t addresses[3] = {SINGLE_PHASE_REG_VOLTAGE, SINGLE_PHASE_REG_CURRENT, SINGLE_PHASE_REG_FREQUENCY};
+  static const float multipliers[3] = {0.1f, 0.1f, 0.01f};
+  float* values[3] = {&data->voltage, &data->current, &data->frequency};
+  
+  uint16_t rawValues[3];
+  ModbusRequest requests[3] = {};
+  for (int i = 0; i < 3; i++) {
+    requests[i].slaveId = MODBUS_SLAVE_ID;
+    requests[i].function = MODBUS_FC_READ_HOLDING_REGISTERS;
+    requests[i].address = addresses[i];
+    requests[i].count = 1;
+    requests[i].out = &rawValues[i];
+  }
   
-  // Read current (multiplier: 0.1)
-  data->current = read_current_register();
-  vTaskDelay(5 / portTICK_PERIOD_MS);  // Yield CPU between reads
+  bool meterAlive = meterLastResponseMs[bus] != 0 && (millis() - meterLastResponseMs[bus]) < 5UL * 60UL * 1000UL;
+  modbus_read_batch(&rs485Buses[bus], requests, meterRegisterHealth[bus], 3, &meterAlive);
+  if (meterAlive) {
+    meterLastResponseMs[bus] = millis();
+  }
   
-  // Read frequency (multiplier: 0.01)
-  data->frequency = read_frequency_register();
+  static unsigned long lastErrorTime = 0;
+  for (int i = 0; i < 3; i++) {
+    if (requests[i].result == MODBUS_OK) {
+      *values[i] = rawValues[i] * multipliers[i];
+    } else if (millis() - lastErrorTime > 5000) {  // Print error max once per 5 seconds
+      Serial.printf("Single Phase Meter Modbus Error reading 0x%04X: 0x%02X\n", addresses[i], requests[i].result);
+      lastErrorTime = millis();
+    }
+  }
   
   // Check if at least one critical reading succeeded
   data->is_valid = (data->voltage >= 0.0f || data->current >= 0.0f || data->frequency >= 0.0f);
   
   unsigned long elapsedTime = millis() - startTime;
-  Serial.printf("Single Phase Meter: Read 3 registers in %lu ms\n", elapsedTime);
+  Serial.printf("Single Phase Meter (bus %d): Read 3 registers in %lu ms\n", bus, elapsedTime);
   
   if (data->is_valid) {
     Serial.printf("Single Phase Meter - Voltage: %.2f V, Current: %.2f A, Frequency: %.2f Hz\n",
@@ -114,8 +125,12 @@ bool read_single_phase_meter_data(SinglePhaseMeterData* data) {
   return data->is_valid;
 }
 
-bool is_meter_connected() {
-  uint8_t result = modbusNode.readHoldingRegisters(SINGLE_PHASE_REG_VOLTAGE, 1);
-  return (result == modbusNode.ku8MBSuccess);
+bool is_meter_connected(int bus) {
+  if (!rs485_bus_available(bus)) {
+    return false;
+  }
+  uint16_t rawValue;
+  uint8_t result = modbus_read_holding_registers(&rs485Buses[bus], MODBUS_SLAVE_ID, SINGLE_PHASE_REG_VOLTAGE, 1, &rawValue);
+  return (result == MODBUS_OK);
 }
 
@@ -0,0 +1,198 @@
+#include "spectral.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM) && __has_include("esp_dsp.h")
+#include "esp_dsp.h"
+#define SPECTRAL_USE_ESP_DSP 1
+#endif
+
+const float spectralOctaveCentres[SPECTRAL_OCTAVE_BANDS] = {
+  1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 31.5f, 63.0f, 125.0f, 250.0f, 500.0f,
+};
+
+// Interleaved complex work buffer, Hann window and its power
+static float spectralData[2 * SPECTRAL_MAX_FFT];
+static float spectralWindow[SPECTRAL_MAX_FFT];
+static float spectralWindowPower = 0;
+static size_t spectralSize = 0;
+
+/******************************************************************
+ *                                                                *
+ *                             FFT                                *
+ *                                                                *
+ ******************************************************************/
+
+#ifdef SPECTRAL_USE_ESP_DSP
+
+static bool spectral_fft_init(size_t n) {
+  static bool tablesReady = false;
+  if (!tablesReady) {
+    // Twiddle table for the largest size; smaller FFTs stride through it
+    if (dsps_fft2r_init_fc32(NULL, SPECTRAL_MAX_FFT) != ESP_OK) {
+      return false;
+    }
+    tablesReady = true;
+  }
+  dsps_wind_hann_f32(spectralWindow, n);
+  return true;
+}
+
+static void spectral_fft(float* data, size_t n) {
+  dsps_fft2r_fc32(data, n);
+  dsps_bit_rev_fc32(data, n);
+}
+
+const char* spectral_backend() {
+  return "esp-dsp";
+}
+
+#else
+
+// cos/-sin pairs for k < n/2
+static float spectralTwiddle[SPECTRAL_MAX_FFT];
+
+static bool spectral_fft_init(size_t n) {
+  for (size_t k = 0; k < n / 2; k++) {
+    double angle = 2.0 * M_PI * k / n;
+    spectralTwiddle[2 * k] = (float)cos(angle);
+    spectralTwiddle[2 * k + 1] = (float)-sin(angle);
+  }
+  for (size_t i = 0; i < n; i++) {
+    spectralWindow[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / (n - 1)));
+  }
+  return true;
+}
+
+// In-place iterative radix-2 decimation-in-time FFT on interleaved complex data
+static void spectral_fft(float* data, size_t n) {
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      float re = data[2 * i], im = data[2 * i + 1];
+      data[2 * i] = data[2 * j];
+      data[2 * i + 1] = data[2 * j + 1];
+      data[2 * j] = re;
+      data[2 * j + 1] = im;
+    }
+  }
+
+  for (size_t len = 2; len <= n; len <<= 1) {
+    size_t half = len >> 1;
+    size_t stride = n / len;
+    for (size_t start = 0; start < n; start += len) {
+      for (size_t k = 0; k < half; k++) {
+        float wr = spectralTwiddle[2 * k * stride];
+        float wi = spectralTwiddle[2 * k * stride + 1];
+        float* a = &data[2 * (start + k)];
+        float* b = &data[2 * (start + k + half)];
+        float tr = b[0] * wr - b[1] * wi;
+        float ti = b[0] * wi + b[1] * wr;
+        b[0] = a[0] - tr;
+        b[1] = a[1] - ti;
+        a[0] += tr;
+        a[1] += ti;
+      }
+    }
+  }
+}
+
+const char* spectral_backend() {
+  return "portable";
+}
+
+#endif
+
+/******************************************************************
+ *                                                                *
+ *                          Features                              *
+ *                                                                *
+ ******************************************************************/
+
+bool spectral_init(size_t n) {
+  if (n < 4 || n > SPECTRAL_MAX_FFT || (n & (n - 1)) != 0) {
+    return false;
+  }
+  if (!spectral_fft_init(n)) {
+    return false;
+  }
+  spectralWindowPower = 0;
+  for (size_t i = 0; i < n; i++) {
+    spectralWindowPower += spectralWindow[i] * spectralWindow[i];
+  }
+  spectralSize = n;
+  return true;
+}
+
+void spectral_analyze(const float* samples, size_t n, float sampleRate, SpectralFeatures* features) {
+  memset(features, 0, sizeof(*features));
+  if (n != spectralSize) {
+    return;
+  }
+
+  // Peak on the raw signal; the spectrum is taken without DC so leakage does not mask low bands
+  float mean = 0;
+  for (size_t i = 0; i < n; i++) {
+    float magnitude = fabsf(samples[i]);
+    if (magnitude > features->peak) {
+      features->peak = magnitude;
+    }
+    mean += samples[i];
+  }
+  mean /= n;
+  for (size_t i = 0; i < n; i++) {
+    spectralData[2 * i] = (samples[i] - mean) * spectralWindow[i];
+    spectralData[2 * i + 1] = 0;
+  }
+
+  spectral_fft(spectralData, n);
+
+  // One-sided power per bin, scaled so that bins sum to the mean square of the input (Parseval)
+  float scale = 2.0f / (n * spectralWindowPower);
+  float binHz = sampleRate / n;
+  size_t bins = n / 2;
+  size_t peakBin = 0;
+  float peakPower = 0;
+  for (size_t k = 1; k < bins; k++) {
+    float re = spectralData[2 * k];
+    float im = spectralData[2 * k + 1];
+    float power = (re * re + im * im) * scale;
+    spectralData[k] = power;  // reuse the front of the buffer, bin k is read before being overwritten
+    if (power > peakPower) {
+      peakPower = power;
+      peakBin = k;
+    }
+  }
+  spectralData[0] = 0;
+
+  // Parabolic interpolation on log power around the strongest bin
+  if (peakBin > 1 && peakBin < bins - 1) {
+    float a = logf(spectralData[peakBin - 1] + 1e-20f);
+    float b = logf(spectralData[peakBin] + 1e-20f);
+    float c = logf(spectralData[peakBin + 1] + 1e-20f);
+    float denominator = a - 2 * b + c;
+    float offset = (denominator != 0) ? 0.5f * (a - c) / denominator : 0;
+    features->dominantFrequency = (peakBin + offset) * binHz;
+  } else {
+    features->dominantFrequency = peakBin * binHz;
+  }
+
+  // Octave bands: [fc / sqrt(2), fc * sqrt(2))
+  for (int band = 0; band < SPECTRAL_OCTAVE_BANDS; band++) {
+    float low = spectralOctaveCentres[band] * (float)M_SQRT1_2;
+    float high = spectralOctaveCentres[band] * (float)M_SQRT2;
+    size_t first = (size_t)ceilf(low / binHz);
+    if (first < 1) {
+      first = 1;
+    }
+    float energy = 0;
+    for (size_t k = first; k < bins && k * binHz < high; k++) {
+      energy += spectralData[k];
+    }
+    features->bandEnergy[band] = energy;
+  }
+}
@@ -1,73 +1,122 @@
 #include "srne_inverter.h"
 
-ModbusMaster srneModbusNode;
+// Register sweep table: address and destination field, in polling order
+struct SRNERegisterEntry {
+  uint16_t address;
+  float SRNEInverterData::*field;
+};
 
-// Callback to switch MAX485 to Transmit mode
-void srne_preTransmission() {
-  digitalWrite(RE_DE, HIGH);
-  delayMicroseconds(100);
-}
+static const SRNERegisterEntry srneRegisters[] = {
+  // Critical battery parameters first
+  {SRNE_REG_BATTERY_SOC, &SRNEInverterData::battery_soc},
+  {SRNE_REG_BATTERY_VOLTAGE, &SRNEInverterData::battery_voltage},
+  {SRNE_REG_BATTERY_CURRENT, &SRNEInverterData::battery_current},
 
-// Callback to switch MAX485 to Receive mode
-void srne_postTransmission() {
-  delayMicroseconds(100);
-  digitalWrite(RE_DE, LOW);
-}
+  // PV parameters
+  {SRNE_REG_PV_VOLTAGE, &SRNEInverterData::pv_voltage},
+  {SRNE_REG_PV_CURRENT, &SRNEInverterData::pv_current},
+  {SRNE_REG_PV_POWER, &SRNEInverterData::pv_power},
+  {SRNE_REG_BATTERY_CHARGE_POWER, &SRNEInverterData::battery_charge_power},
 
-void srne_inverter_init() {
-  Serial.println("Initializing SRNE Inverter (Modbus RS485)...");
-  
-  // Initialize Serial2 for Modbus communication (shared with single-phase meter)
-  Serial2.begin(SRNE_MODBUS_BAUD_RATE, SERIAL_8N1, RXD2, TXD2);
+  // Configuration registers (not implemented by every firmware variant)
+  {SRNE_REG_BATTERY_TYPE, &SRNEInverterData::battery_type},
+  {SRNE_REG_BATTERY_OVER_VOLTAGE, &SRNEInverterData::battery_over_voltage},
+  {SRNE_REG_BATTERY_EQUALIZING_CHARGE_VOLTAGE, &SRNEInverterData::battery_equalizing_charge_voltage},
+  {SRNE_REG_BATTERY_BOOST_CHARGE_VOLTAGE, &SRNEInverterData::battery_boost_charge_voltage},
+  {SRNE_REG_BATTERY_FLOAT_CHARGE_VOLTAGE, &SRNEInverterData::battery_float_charge_voltage},
+  {SRNE_REG_OVER_DISCHARGE_DELAY_TIME, &SRNEInverterData::over_discharge_delay_time},
+  {SRNE_REG_BATTERY_EQUALIZING_CHARGE_TIME, &SRNEInverterData::battery_equalizing_charge_time},
+  {SRNE_REG_BATTERY_EQUALIZING_INTERVAL, &SRNEInverterData::battery_equalizing_interval},
+  {SRNE_REG_BATTERY_UNDER_VOLTAGE_WARNING, &SRNEInverterData::battery_under_voltage_warning},
+  {SRNE_REG_BATTERY_OVER_DISCHARGE_VOLTAGE, &SRNEInverterData::battery_over_discharge_voltage},
+  {SRNE_REG_BATTERY_LIMITED_DISCHARGE_VOLTAGE, &SRNEInverterData::battery_limited_discharge_voltage},
+  {SRNE_REG_BATTERY_BOOST_CHARGE_TIME, &SRNEInverterData::battery_boost_charge_time},
+  {SRNE_REG_BATTERY_MAINS_SWITCHING_VOLTAGE, &SRNEInverterData::battery_mains_switching_voltage},
+  {SRNE_REG_BATTERY_STOP_CHARGING_CURRENT, &SRNEInverterData::battery_stop_charging_current},
+  {SRNE_REG_BATTERY_NUMBER_IN_SERIES, &SRNEInverterData::battery_number_in_series},
+  {SRNE_REG_INVERTER_SWITCH_VOLTAGE, &SRNEInverterData::inverter_switch_voltage},
+  {SRNE_REG_BATTERY_MAX_CHARGE_CURRENT, &SRNEInverterData::battery_max_charge_current},
+  {SRNE_REG_INVERTER_OUTPUT_PRIORITY, &SRNEInverterData::inverter_output_priority},
+  {SRNE_REG_INVERTER_CHARGE_PRIORITY, &SRNEInverterData::inverter_charge_priority},
+  {SRNE_REG_GRID_BATTERY_CHARGE_MAX_CURRENT, &SRNEInverterData::grid_battery_charge_max_current},
+  {SRNE_REG_INVERTER_CHARGER_PRIORITY, &SRNEInverterData::inverter_charger_priority},
+  {SRNE_REG_INVERTER_ALARM_CONTROL, &SRNEInverterData::inverter_alarm_control},
+
+  // Status registers
+  {SRNE_REG_MACHINE_STATE, &SRNEInverterData::machine_state},
+  {SRNE_REG_TOTAL_RUNNING_DAYS, &SRNEInverterData::total_running_days},
+
+  // Grid and inverter parameters
+  {SRNE_REG_GRID_VOLTAGE, &SRNEInverterData::grid_voltage},
+  {SRNE_REG_GRID_INPUT_CURRENT, &SRNEInverterData::grid_input_current},
+  {SRNE_REG_GRID_FREQUENCY, &SRNEInverterData::grid_frequency},
+  {SRNE_REG_INVERTER_VOLTAGE, &SRNEInverterData::inverter_voltage},
+  {SRNE_REG_INVERTER_CURRENT, &SRNEInverterData::inverter_current},
+  {SRNE_REG_INVERTER_FREQUENCY, &SRNEInverterData::inverter_frequency},
+  {SRNE_REG_LOAD_CURRENT, &SRNEInverterData::load_current},
+  {SRNE_REG_INVERTER_POWER, &SRNEInverterData::inverter_power},
+  {SRNE_REG_INVERTER_APPARENT_POWER, &SRNEInverterData::inverter_apparent_power},
+  {SRNE_REG_GRID_BATTERY_CHARGE_CURRENT, &SRNEInverterData::grid_battery_charge_current},
+
+  // Temperature sensors
+  {SRNE_REG_TEMP_DC, &SRNEInverterData::temp_dc},
+  {SRNE_REG_TEMP_AC, &SRNEInverterData::temp_ac},
+  {SRNE_REG_TEMP_TR, &SRNEInverterData::temp_tr},
+  {SRNE_REG_PV_BATTERY_CHARGE_CURRENT, &SRNEInverterData::pv_battery_charge_current},
+};
+
+#define SRNE_REGISTER_COUNT (sizeof(srneRegisters) / sizeof(srneRegisters[0]))
+
+// Learned per-register state (quarantine of registers this firmware does not implement),
+// one set per bus since each bus can carry its own inverter
+static ModbusRegisterHealth srneRegisterHealth[RS485_BUS_COUNT][SRNE_REGISTER_COUNT];
+static unsigned long srneLastResponseMs[RS485_BUS_COUNT];
+
+void srne_inverter_init(int bus) {
+  Serial.printf("Initializing SRNE Inverter (Modbus RS485 bus %d)...\n", bus);
   
-  // Configure RE/DE pin for RS485 direction control
-  pinMode(RE_DE, OUTPUT);
-  digitalWrite(RE_DE, LOW);  // Start in receive mode
+  // The bus may be shared with a single-phase meter; line speed is set per bus
+  if (rs485_bus_init(bus) == nullptr) {
+    return;
+  }
   
   // Small delay to allow hardware to stabilize
   delay(100);
   
-  // Initialize ModbusMaster with slave ID
-  srneModbusNode.begin(SRNE_MODBUS_SLAVE_ID, Serial2);
-  
-  // Try to set longer timeout (if supported by library)
-  // Some ModbusMaster versions support setResponseTimeout()
-  // srneModbusNode.setResponseTimeout(2000); // 2 second timeout
-  
-  // Register callbacks for RS485 direction control
-  srneModbusNode.preTransmission(srne_preTransmission);
-  srneModbusNode.postTransmission(srne_postTransmission);
-  
   Serial.println("SRNE Inverter initialized successfully");
 }
 
-float read_srne_register(uint16_t registerAddress) {
-  uint8_t result = srneModbusNode.readHoldingRegisters(registerAddress, 1);
-  
-  // Always yield to other tasks after Modbus operation to prevent watchdog timeout
-  vTaskDelay(5 / portTICK_PERIOD_MS);  // 5ms delay - allows other tasks to run
+static void srne_log_error(uint16_t registerAddress, uint8_t result) {
+  // Only print error for first few failures to avoid spam
+  static int errorCount = 0;
+  if (errorCount < 5) {
+    Serial.print("Modbus Error reading register 0x");
+    Serial.print(registerAddress, HEX);
+    Serial.print(": 0x");
+    Serial.println(result, HEX);
+    errorCount++;
+  }
+}
+
+float read_srne_register(int bus, uint16_t registerAddress) {
+  if (!rs485_bus_available(bus)) {
+    return -9999.0f;
+  }
+  uint16_t rawValue;
+  uint8_t result = modbus_read_holding_registers_retry(&rs485Buses[bus], SRNE_MODBUS_SLAVE_ID, registerAddress, 1,
+                                                       &rawValue, nullptr, true);
   
-  if (result == srneModbusNode.ku8MBSuccess) {
-    uint16_t rawValue = srneModbusNode.getResponseBuffer(0);
+  if (result == MODBUS_OK) {
     // For now, use multiplier 1.0 (will be updated later)
-    float value = rawValue * 1.0f;
-    return value;
+    return rawValue * 1.0f;
   } else {
-    // Only print error for first few failures to avoid spam
-    static int errorCount = 0;
-    if (errorCount < 5) {
-      Serial.print("Modbus Error reading register 0x");
-      Serial.print(registerAddress, HEX);
-      Serial.print(": 0x");
-      Serial.println(result, HEX);
-      errorCount++;
-    }
+    srne_log_error(registerAddress, result);
     return -9999.0f;  // Return error value
   }
 }
 
-bool read_srne_inverter_data(SRNEInverterData* data) {
-  if (data == nullptr) {
+bool read_srne_inverter_data(int bus, SRNEInverterData* data) {
+  if (data == nullptr || !rs485_bus_available(bus)) {
     return false;
   }
   
@@ -76,67 +125,47 @@ bool read_srne_inverter_data(SRNEInverterData* data) {
   data->is_valid = false;
   
   unsigned long startTime = millis();
-  
-  // Read all registers with error handling
-  // Critical battery parameters first
-  data->battery_soc = read_srne_register(SRNE_REG_BATTERY_SOC);
-  data->battery_voltage = read_srne_register(SRNE_REG_BATTERY_VOLTAGE);
-  data->battery_current = read_srne_register(SRNE_REG_BATTERY_CURRENT);
-  
-  // PV parameters
-  data->pv_voltage = read_srne_register(SRNE_REG_PV_VOLTAGE);
-  data->pv_current = read_srne_register(SRNE_REG_PV_CURRENT);
-  data->pv_power = read_srne_register(SRNE_REG_PV_POWER);
-  data->battery_charge_power = read_srne_register(SRNE_REG_BATTERY_CHARGE_POWER);
-  
-  // Configuration registers (may fail, continue anyway)
-  data->battery_type = read_srne_register(SRNE_REG_BATTERY_TYPE);
-  data->battery_over_voltage = read_srne_register(SRNE_REG_BATTERY_OVER_VOLTAGE);
-  data->battery_equalizing_charge_voltage = read_srne_register(SRNE_REG_BATTERY_EQUALIZING_CHARGE_VOLTAGE);
-  data->battery_boost_charge_voltage = read_srne_register(SRNE_REG_BATTERY_BOOST_CHARGE_VOLTAGE);
-  data->battery_float_charge_voltage = read_srne_register(SRNE_REG_BATTERY_FLOAT_CHARGE_VOLTAGE);
-  data->over_discharge_delay_time = read_srne_register(SRNE_REG_OVER_DISCHARGE_DELAY_TIME);
-  data->battery_equalizing_charge_time = read_srne_register(SRNE_REG_BATTERY_EQUALIZING_CHARGE_TIME);
-  data->battery_equalizing_interval = read_srne_register(SRNE_REG_BATTERY_EQUALIZING_INTERVAL);
-  data->battery_under_voltage_warning = read_srne_register(SRNE_REG_BATTERY_UNDER_VOLTAGE_WARNING);
-  data->battery_over_discharge_voltage = read_srne_register(SRNE_REG_BATTERY_OVER_DISCHARGE_VOLTAGE);
-  data->battery_limited_discharge_voltage = read_srne_register(SRNE_REG_BATTERY_LIMITED_DISCHARGE_VOLTAGE);
-  data->battery_boost_charge_time = read_srne_register(SRNE_REG_BATTERY_BOOST_CHARGE_TIME);
-  data->battery_mains_switching_voltage = read_srne_register(SRNE_REG_BATTERY_MAINS_SWITCHING_VOLTAGE);
-  data->battery_stop_charging_current = read_srne_register(SRNE_REG_BATTERY_STOP_CHARGING_CURRENT);
-  data->battery_number_in_series = read_srne_register(SRNE_REG_BATTERY_NUMBER_IN_SERIES);
-  data->inverter_switch_voltage = read_srne_register(SRNE_REG_INVERTER_SWITCH_VOLTAGE);
-  data->battery_max_charge_current = read_srne_register(SRNE_REG_BATTERY_MAX_CHARGE_CURRENT);
-  data->inverter_output_priority = read_srne_register(SRNE_REG_INVERTER_OUTPUT_PRIORITY);
-  data->inverter_charge_priority = read_srne_register(SRNE_REG_INVERTER_CHARGE_PRIORITY);
-  data->grid_battery_charge_max_current = read_srne_register(SRNE_REG_GRID_BATTERY_CHARGE_MAX_CURRENT);
-  data->inverter_charger_priority = read_srne_register(SRNE_REG_INVERTER_CHARGER_PRIORITY);
-  data->inverter_alarm_control = read_srne_register(SRNE_REG_INVERTER_ALARM_CONTROL);
-  
-  // Status registers
-  data->machine_state = read_srne_register(SRNE_REG_MACHINE_STATE);
-  data->total_running_days = read_srne_register(SRNE_REG_TOTAL_RUNNING_DAYS);
-  
-  // Grid and inverter parameters
-  data->grid_voltage = read_srne_register(SRNE_REG_GRID_VOLTAGE);
-  data->grid_input_current = read_srne_register(SRNE_REG_GRID_INPUT_CURRENT);
-  data->grid_frequency = read_srne_register(SRNE_REG_GRID_FREQUENCY);
-  data->inverter_voltage = read_srne_register(SRNE_REG_INVERTER_VOLTAGE);
-  data->inverter_current = read_srne_register(SRNE_REG_INVERTER_CURRENT);
-  data->inverter_frequency = read_srne_register(SRNE_REG_INVERTER_FREQUENCY);
-  data->load_current = read_srne_register(SRNE_REG_LOAD_CURRENT);
-  data->inverter_power = read_srne_register(SRNE_REG_INVERTER_POWER);
-  data->inverter_apparent_power = read_srne_register(SRNE_REG_INVERTER_APPARENT_POWER);
-  data->grid_battery_charge_current = read_srne_register(SRNE_REG_GRID_BATTERY_CHARGE_CURRENT);
-  
-  // Temperature sensors
-  data->temp_dc = read_srne_register(SRNE_REG_TEMP_DC);
-  data->temp_ac = read_srne_register(SRNE_REG_TEMP_AC);
-  data->temp_tr = read_srne_register(SRNE_REG_TEMP_TR);
-  data->pv_battery_charge_current = read_srne_register(SRNE_REG_PV_BATTERY_CHARGE_CURRENT);
+  ModbusPort* port = &rs485Buses[bus];
+  // Device counts as alive if it answered during the last few minutes
+  bool deviceAlive = srneLastResponseMs[bus] != 0 && (millis() - srneLastResponseMs[bus]) < 5UL * 60UL * 1000UL;
+  uint32_t transactionsBefore = port->transactions;
+
+  // Queue the whole sweep at once so the requests run back to back on the bus
+  uint16_t rawValues[SRNE_REGISTER_COUNT];
+  ModbusRequest requests[SRNE_REGISTER_COUNT] = {};
+  for (size_t i = 0; i < SRNE_REGISTER_COUNT; i++) {
+    requests[i].slaveId = SRNE_MODBUS_SLAVE_ID;
+    requests[i].function = MODBUS_FC_READ_HOLDING_REGISTERS;
+    requests[i].address = srneRegisters[i].address;
+    requests[i].count = 1;
+    requests[i].out = &rawValues[i];
+  }
+  modbus_read_batch(port, requests, srneRegisterHealth[bus], SRNE_REGISTER_COUNT, &deviceAlive);
+  if (deviceAlive) {
+    srneLastResponseMs[bus] = millis();
+  } else {
+    Serial.printf("SRNE (bus %d): inverter not responding, sweep skipped\n", bus);
+  }
+
+  int skipped = 0;
+  for (size_t i = 0; i < SRNE_REGISTER_COUNT; i++) {
+    const SRNERegisterEntry& entry = srneRegisters[i];
+    if (requests[i].result == MODBUS_OK) {
+      // For now, use multiplier 1.0 (will be updated later)
+      data->*entry.field = rawValues[i] * 1.0f;
+    } else {
+      data->*entry.field = -9999.0f;  // Error value
+      if (srneRegisterHealth[bus][i].quarantined) {
+        skipped++;
+      } else if (deviceAlive) {
+        srne_log_error(entry.address, requests[i].result);
+      }
+    }
+  }
   
   unsigned long elapsedTime = millis() - startTime;
-  Serial.printf("SRNE: Read 46 registers in %lu ms\n", elapsedTime);
+  Serial.printf("SRNE (bus %d): %lu transactions in %lu ms (%d registers quarantined, timeout %lu ms)\n",
+                bus, port->transactions - transactionsBefore, elapsedTime, skipped, port->timeout_ms);
   
   // Check if at least some critical registers were read successfully
   // (not all -9999.0f values)
@@ -149,8 +178,11 @@ bool read_srne_inverter_data(SRNEInverterData* data) {
   return false;
 }
 
-bool is_srne_inverter_connected() {
-  uint8_t result = srneModbusNode.readHoldingRegisters(SRNE_REG_MACHINE_STATE, 1);
-  return (result == srneModbusNode.ku8MBSuccess);
+bool is_srne_inverter_connected(int bus) {
+  if (!rs485_bus_available(bus)) {
+    return false;
+  }
+  uint16_t rawValue;
+  uint8_t result = modbus_read_holding_registers(&rs485Buses[bus], SRNE_MODBUS_SLAVE_ID, SRNE_REG_MACHINE_STATE, 1, &rawValue);
+  return (result == MODBUS_OK);
 }
-
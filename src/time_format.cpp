@@ -0,0 +1,248 @@
+#include "utils.h"
+#include "configuration.h"
+#include <sys/time.h>
+
+// Wall-clock formatting, kept apart from utils.cpp so it builds without the
+// WiFi/RTC/OLED code (native build, see README.md)
+//
+// Timestamps are formatted from the epoch with integer calendar arithmetic. The local
+// offset and the DST state come from one localtime_r() and are cached for the window
+// around that time in which neither changes: until the next DST transition or New Year.
+
+#define TIME_VALID_AFTER 1451606400   // 2016-01-01: an earlier clock was never set, as for getLocalTime()
+
+struct TimeWindow {
+  bool valid;
+  time_t from;            // [from, until): constant local offset and DST state
+  time_t until;
+  int32_t localOffset;    // local time minus UTC in seconds, from the TZ the time service set
+  bool dst;
+};
+
+static TimeWindow timeWindow;
+static portMUX_TYPE timeWindowMux = portMUX_INITIALIZER_UNLOCKED;
+
+/******************************************************************
+ *                                                                *
+ *                      Calendar arithmetic                       *
+ *                                                                *
+ ******************************************************************/
+
+// Days since 1970-01-01 of a proleptic Gregorian date (month 1-12)
+static int32_t days_from_civil(int32_t year, uint32_t month, uint32_t day) {
+  year -= month <= 2;
+  int32_t era = (year >= 0 ? year : year - 399) / 400;
+  uint32_t yearOfEra = (uint32_t)(year - era * 400);
+  uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + (int32_t)dayOfEra - 719468;
+}
+
+static void civil_from_days(int32_t days, int32_t* year, uint32_t* month, uint32_t* day) {
+  days += 719468;
+  int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+  uint32_t dayOfEra = (uint32_t)(days - era * 146097);
+  uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  uint32_t monthIndex = (5 * dayOfYear + 2) / 153;
+  *day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+  *month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+  *year = (int32_t)yearOfEra + era * 400 + (*month <= 2);
+}
+
+static int32_t floor_div(int64_t value, int32_t divisor) {
+  return (int32_t)(value >= 0 ? value / divisor : (value - divisor + 1) / divisor);
+}
+
+// Day of month of the nth Sunday (1-based)
+static uint32_t nth_sunday(int32_t year, uint32_t month, uint32_t n) {
+  int32_t first = days_from_civil(year, month, 1);
+  uint32_t weekday = (uint32_t)((first % 7 + 11) % 7);  // 1970-01-01 was a Thursday; 0 = Sunday
+  return 1 + (7 - weekday) % 7 + 7 * (n - 1);
+}
+
+/******************************************************************
+ *                                                                *
+ *                       DST and offset cache                     *
+ *                                                                *
+ ******************************************************************/
+
+// DST windows of the year containing t under the TIME_DST_* rule. Starts are in standard
+// time and ends in daylight time, as in the POSIX TZ time_format_set_zone() builds from it.
+static void time_window_compute(time_t t, TimeWindow* window) {
+  struct tm local;
+  localtime_r(&t, &local);
+  int32_t year = local.tm_year + 1900;
+  int64_t localSeconds = (int64_t)days_from_civil(year, local.tm_mon + 1, local.tm_mday) * 86400 +
+                         local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+  int32_t standard = (int32_t)(localSeconds - t) - (local.tm_isdst > 0 ? 3600 : 0);
+  int32_t daylight = standard + 3600;
+
+  uint32_t startDay = nth_sunday(year, TIME_DST_START_MONTH, TIME_DST_START_SUNDAY);
+  uint32_t endDay = nth_sunday(year, TIME_DST_END_MONTH, TIME_DST_END_SUNDAY);
+  time_t yearStart = (time_t)days_from_civil(year, 1, 1) * 86400 - standard;
+  time_t dstStart = (time_t)days_from_civil(year, TIME_DST_START_MONTH, startDay) * 86400 +
+                    TIME_DST_HOUR * 3600 - standard;
+  time_t dstEnd = (time_t)days_from_civil(year, TIME_DST_END_MONTH, endDay) * 86400 +
+                  TIME_DST_HOUR * 3600 - daylight;
+  time_t nextYear = (time_t)days_from_civil(year + 1, 1, 1) * 86400 - standard;
+
+  window->valid = true;
+  window->dst = t >= dstStart && t < dstEnd;
+  window->localOffset = window->dst ? daylight : standard;
+  if (t < dstStart) {
+    window->from = yearStart;
+    window->until = dstStart;
+  } else if (t < dstEnd) {
+    window->from = dstStart;
+    window->until = dstEnd;
+  } else {
+    window->from = dstEnd;
+    window->until = nextYear;
+  }
+}
+
+// The window containing t: the cached one, or a new one that replaces it
+static void time_window_get(time_t t, TimeWindow* window) {
+  portENTER_CRITICAL(&timeWindowMux);
+  *window = timeWindow;
+  portEXIT_CRITICAL(&timeWindowMux);
+  if (window->valid && t >= window->from && t < window->until) {
+    return;
+  }
+  time_window_compute(t, window);
+  portENTER_CRITICAL(&timeWindowMux);
+  timeWindow = *window;
+  portEXIT_CRITICAL(&timeWindowMux);
+}
+
+void time_format_set_zone(int utcOffset) {
+  char tz[48];
+  snprintf(tz, sizeof(tz), "UTC%dDST,M%d.%d.0/%d,M%d.%d.0/%d", -utcOffset, TIME_DST_START_MONTH,
+           TIME_DST_START_SUNDAY, TIME_DST_HOUR, TIME_DST_END_MONTH, TIME_DST_END_SUNDAY, TIME_DST_HOUR);
+  setenv("TZ", tz, 1);
+  tzset();
+  portENTER_CRITICAL(&timeWindowMux);
+  timeWindow.valid = false;
+  portEXIT_CRITICAL(&timeWindowMux);
+}
+
+bool isDST() {
+  time_t now;
+  time(&now);
+  if (now < TIME_VALID_AFTER) {
+    return false;
+  }
+  TimeWindow window;
+  time_window_get(now, &window);
+  return window.dst;
+}
+
+/******************************************************************
+ *                                                                *
+ *                          Formatting                            *
+ *                                                                *
+ ******************************************************************/
+
+static inline char* put_2digits(char* out, uint32_t value) {
+  out[0] = (char)('0' + value / 10);
+  out[1] = (char)('0' + value % 10);
+  return out + 2;
+}
+
+static inline char* put_4digits(char* out, uint32_t value) {
+  out = put_2digits(out, value / 100);
+  return put_2digits(out, value % 100);
+}
+
+// Local date and time fields separated by dateSeparator, timeSeparator and middle
+static char* put_local_time(char* out, time_t epoch, const TimeWindow* window, char dateSeparator,
+                            char middle, char timeSeparator) {
+  int64_t local = (int64_t)epoch + window->localOffset;
+  int32_t days = floor_div(local, 86400);
+  uint32_t secondOfDay = (uint32_t)(local - (int64_t)days * 86400);
+  int32_t year;
+  uint32_t month, day;
+  civil_from_days(days, &year, &month, &day);
+
+  out = put_4digits(out, (uint32_t)year % 10000);
+  *out++ = dateSeparator;
+  out = put_2digits(out, month);
+  *out++ = dateSeparator;
+  out = put_2digits(out, day);
+  *out++ = middle;
+  out = put_2digits(out, secondOfDay / 3600);
+  *out++ = timeSeparator;
+  out = put_2digits(out, secondOfDay / 60 % 60);
+  *out++ = timeSeparator;
+  return put_2digits(out, secondOfDay % 60);
+}
+
+size_t format_iso8601(time_t epoch, char* buffer, size_t size) {
+  if (size < TIME_ISO8601_SIZE) {
+    return 0;
+  }
+  TimeWindow window;
+  time_window_get(epoch, &window);
+
+  // The suffix is the configured zone, one hour ahead while DST is in effect
+  int offsetHours = systemConfig.utcOffset + (window.dst ? 1 : 0);
+  char* out = put_local_time(buffer, epoch, &window, '-', 'T', ':');
+  *out++ = offsetHours < 0 ? '-' : '+';
+  out = put_2digits(out, (uint32_t)abs(offsetHours) % 100);
+  memcpy(out, ":00", 4);
+  return out + 3 - buffer;
+}
+
+bool time_wall_valid() {
+  return time(nullptr) >= TIME_VALID_AFTER;
+}
+
+// Sampled now, so a clock step (NTP, RTC, LoRa time sync) applies to every stamp not yet encoded
+int64_t time_mono_to_wall_us(int64_t monoUs) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  int64_t offset = (int64_t)now.tv_sec * 1000000 + now.tv_usec - esp_timer_get_time();
+  return monoUs + offset;
+}
+
+size_t format_mono_iso8601(int64_t monoUs, char* buffer, size_t size) {
+  if (!time_wall_valid()) {
+    snprintf(buffer, size, "error.");
+    return 0;
+  }
+  int64_t wallUs = time_mono_to_wall_us(monoUs);
+  return format_iso8601((time_t)(wallUs >= 0 ? wallUs / 1000000 : (wallUs - 999999) / 1000000), buffer, size);
+}
+
+bool format_current_time(char* buffer, size_t size, bool getFilename) {
+  time_t now;
+  time(&now);
+  if (now < TIME_VALID_AFTER) {
+    Serial.println("Failed to get system time. Cannot get current time.");
+    snprintf(buffer, size, "error.");
+    return false;
+  }
+  if (!getFilename) {
+    return format_iso8601(now, buffer, size) > 0;
+  }
+  if (size < TIME_FILENAME_SIZE) {
+    return false;
+  }
+  TimeWindow window;
+  time_window_get(now, &window);
+  *put_local_time(buffer, now, &window, '_', '_', '_') = '\0';
+  return true;
+}
+
+String get_current_time(bool getFilename) {
+  char buffer[TIME_ISO8601_SIZE];
+  format_current_time(buffer, sizeof(buffer), getFilename);
+  return String(buffer);
+}
+
+String convertTMtoString(time_t now){
+  char buffer[TIME_ISO8601_SIZE];
+  format_iso8601(now, buffer, sizeof(buffer));
+  return String(buffer);
+}
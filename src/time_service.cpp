@@ -0,0 +1,265 @@
+#include "time_service.h"
+#include "configuration.h"
+#include "utils.h"
+#include <WiFi.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define NTP_PACKET_SIZE 48
+#define NTP_UNIX_EPOCH 2208988800UL      // 1900-01-01 to 1970-01-01 in seconds
+
+static const char* ntpServers[] = {TIME_NTP_SERVERS};
+static const int numNtpServers = sizeof(ntpServers) / sizeof(ntpServers[0]);
+
+static TimeSyncStatus timeSyncStatus;
+static portMUX_TYPE timeSyncMux = portMUX_INITIALIZER_UNLOCKED;
+
+// One outstanding request per server
+struct NtpProbe {
+  int fd;
+  int64_t sentWallUs;          // local wall clock at transmit, echoed back as the originate stamp
+  int64_t sentMonoUs;
+  bool answered;
+  int64_t offsetUs;
+  int64_t delayUs;
+};
+
+/******************************************************************
+ *                                                                *
+ *                         NTP packets                            *
+ *                                                                *
+ ******************************************************************/
+
+static int64_t wall_now_us() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static void ntp_put_timestamp(uint8_t* out, int64_t unixUs) {
+  uint32_t seconds = (uint32_t)(unixUs / 1000000 + NTP_UNIX_EPOCH);
+  uint32_t fraction = (uint32_t)(((uint64_t)(unixUs % 1000000) << 32) / 1000000);
+  for (int i = 0; i < 4; i++) {
+    out[i] = (uint8_t)(seconds >> (24 - 8 * i));
+    out[4 + i] = (uint8_t)(fraction >> (24 - 8 * i));
+  }
+}
+
+static int64_t ntp_get_timestamp(const uint8_t* in) {
+  uint32_t seconds = ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+  uint32_t fraction = ((uint32_t)in[4] << 24) | ((uint32_t)in[5] << 16) | ((uint32_t)in[6] << 8) | in[7];
+  // Era 1 starts in 2036; seconds below 2^31 are taken to be in it
+  int64_t unixSeconds = (int64_t)seconds - NTP_UNIX_EPOCH + ((seconds & 0x80000000UL) ? 0 : (1LL << 32));
+  return unixSeconds * 1000000 + (int64_t)(((uint64_t)fraction * 1000000) >> 32);
+}
+
+static bool ntp_send_request(NtpProbe* probe, const char* server) {
+  probe->fd = -1;
+  probe->answered = false;
+
+  char port[8];
+  snprintf(port, sizeof(port), "%d", TIME_NTP_PORT);
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  struct addrinfo* address = nullptr;
+  if (getaddrinfo(server, port, &hints, &address) != 0 || address == nullptr) {
+    Serial.printf("NTP: cannot resolve %s\n", server);
+    return false;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd < 0 || connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+    freeaddrinfo(address);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  freeaddrinfo(address);
+
+  uint8_t request[NTP_PACKET_SIZE] = {};
+  request[0] = (0 << 6) | (4 << 3) | 3;  // no leap warning, version 4, client
+  probe->sentMonoUs = esp_timer_get_time();
+  probe->sentWallUs = wall_now_us();
+  ntp_put_timestamp(request + 40, probe->sentWallUs);
+  if (send(fd, request, sizeof(request), 0) != sizeof(request)) {
+    close(fd);
+    return false;
+  }
+  probe->fd = fd;
+  return true;
+}
+
+// Offset and delay from the four timestamps; the receive stamp comes from the monotonic
+// clock so a concurrent clock change cannot distort the round trip
+static bool ntp_read_reply(NtpProbe* probe) {
+  uint8_t reply[NTP_PACKET_SIZE];
+  ssize_t length = recv(probe->fd, reply, sizeof(reply), 0);
+  int64_t receivedWallUs = probe->sentWallUs + (esp_timer_get_time() - probe->sentMonoUs);
+  if (length < NTP_PACKET_SIZE) {
+    return false;
+  }
+  uint8_t leap = reply[0] >> 6;
+  uint8_t mode = reply[0] & 0x07;
+  uint8_t stratum = reply[1];
+  if (mode != 4 || leap == 3 || stratum == 0 || stratum > 15) {
+    return false;  // not a server reply, unsynchronized server, or kiss-o'-death
+  }
+  uint8_t sent[8];
+  ntp_put_timestamp(sent, probe->sentWallUs);
+  if (memcmp(reply + 24, sent, sizeof(sent)) != 0) {
+    return false;  // originate stamp does not echo our request
+  }
+  int64_t serverReceive = ntp_get_timestamp(reply + 32);
+  int64_t serverTransmit = ntp_get_timestamp(reply + 40);
+  probe->offsetUs = ((serverReceive - probe->sentWallUs) + (serverTransmit - receivedWallUs)) / 2;
+  probe->delayUs = (receivedWallUs - probe->sentWallUs) - (serverTransmit - serverReceive);
+  probe->answered = probe->delayUs >= 0;
+  return probe->answered;
+}
+
+/******************************************************************
+ *                                                                *
+ *                         Synchronization                        *
+ *                                                                *
+ ******************************************************************/
+
+// US daylight saving rules on the configured standard offset
+static void time_service_apply_zone() {
+  time_format_set_zone(systemConfig.utcOffset);
+}
+
+static void time_service_correct(int64_t offsetUs, bool* stepped) {
+  if (!time_wall_valid() || llabs(offsetUs) >= (int64_t)TIME_STEP_THRESHOLD_MS * 1000) {
+    int64_t corrected = wall_now_us() + offsetUs;
+    struct timeval now = {(time_t)(corrected / 1000000), (suseconds_t)(corrected % 1000000)};
+    settimeofday(&now, NULL);
+    *stepped = true;
+  } else {
+    struct timeval delta = {(time_t)(offsetUs / 1000000), (suseconds_t)(offsetUs % 1000000)};
+    adjtime(&delta, NULL);
+    *stepped = false;
+  }
+}
+
+// One round: a request to every server, then replies until all answered or the timeout
+static bool time_service_sync_once() {
+  NtpProbe probes[numNtpServers];
+  int outstanding = 0;
+  for (int i = 0; i < numNtpServers; i++) {
+    outstanding += ntp_send_request(&probes[i], ntpServers[i]) ? 1 : 0;
+  }
+
+  int64_t deadline = esp_timer_get_time() + TIME_NTP_TIMEOUT_MS * 1000LL;
+  while (outstanding > 0) {
+    int64_t remaining = deadline - esp_timer_get_time();
+    if (remaining <= 0) {
+      break;
+    }
+    fd_set readable;
+    FD_ZERO(&readable);
+    int maxFd = -1;
+    for (int i = 0; i < numNtpServers; i++) {
+      if (probes[i].fd >= 0) {
+        FD_SET(probes[i].fd, &readable);
+        maxFd = max(maxFd, probes[i].fd);
+      }
+    }
+    struct timeval timeout = {(time_t)(remaining / 1000000), (suseconds_t)(remaining % 1000000)};
+    if (select(maxFd + 1, &readable, NULL, NULL, &timeout) <= 0) {
+      break;
+    }
+    for (int i = 0; i < numNtpServers; i++) {
+      if (probes[i].fd >= 0 && FD_ISSET(probes[i].fd, &readable)) {
+        ntp_read_reply(&probes[i]);
+        close(probes[i].fd);
+        probes[i].fd = -1;
+        outstanding--;
+      }
+    }
+  }
+
+  int best = -1;
+  for (int i = 0; i < numNtpServers; i++) {
+    if (probes[i].fd >= 0) {
+      close(probes[i].fd);
+    }
+    if (probes[i].answered && (best < 0 || probes[i].delayUs < probes[best].delayUs)) {
+      best = i;
+    }
+  }
+  if (best < 0) {
+    portENTER_CRITICAL(&timeSyncMux);
+    timeSyncStatus.failures++;
+    portEXIT_CRITICAL(&timeSyncMux);
+    Serial.println("NTP: no server answered");
+    return false;
+  }
+
+  bool stepped;
+  time_service_correct(probes[best].offsetUs, &stepped);
+  portENTER_CRITICAL(&timeSyncMux);
+  timeSyncStatus.synced = true;
+  timeSyncStatus.server = ntpServers[best];
+  timeSyncStatus.offsetMs = (int32_t)(probes[best].offsetUs / 1000);
+  timeSyncStatus.delayMs = (uint32_t)(probes[best].delayUs / 1000);
+  timeSyncStatus.stepped = stepped;
+  timeSyncStatus.lastSyncUs = esp_timer_get_time();
+  timeSyncStatus.syncs++;
+  portEXIT_CRITICAL(&timeSyncMux);
+
+  Serial.printf("NTP: %s, offset %lld ms %s, delay %lld ms\n", ntpServers[best],
+                (long long)(probes[best].offsetUs / 1000), stepped ? "stepped" : "slewing",
+                (long long)(probes[best].delayUs / 1000));
+  Serial.println(get_current_time(false));
+  external_rtc_sync_ntp();
+  return true;
+}
+
+void timeServiceTask(void* parameter) {
+  uint32_t retryS = TIME_SYNC_RETRY_S;
+  while (true) {
+    uint32_t waitS;
+    time_service_apply_zone();  // picks up a changed utcOffset
+    if (WiFi.status() == WL_CONNECTED && time_service_sync_once()) {
+      waitS = TIME_SYNC_INTERVAL_S;
+      retryS = TIME_SYNC_RETRY_S;
+    } else {
+      waitS = retryS;
+      retryS = min(retryS * 2, (uint32_t)TIME_SYNC_INTERVAL_S);
+    }
+    vTaskDelay(waitS * 1000 / portTICK_PERIOD_MS);
+  }
+}
+
+void time_service_start() {
+  time_service_apply_zone();
+  xTaskCreate(
+    timeServiceTask,      // Task function
+    "Time Service",       // Name of the task (for debugging)
+    4096,                 // Stack size (in words, not bytes)
+    NULL,                 // Task input parameter
+    1,                    // Priority of the task
+    NULL                  // Task handle
+  );
+}
+
+void time_service_get_status(TimeSyncStatus* status) {
+  portENTER_CRITICAL(&timeSyncMux);
+  *status = timeSyncStatus;
+  portEXIT_CRITICAL(&timeSyncMux);
+}
+
+long time_service_sync_age() {
+  TimeSyncStatus status;
+  time_service_get_status(&status);
+  if (!status.synced) {
+    return -1;
+  }
+  return (long)((esp_timer_get_time() - status.lastSyncUs) / 1000000);
+}
@@ -0,0 +1,255 @@
+#include "trigger.h"
+#include "mqtt.h"
+#include "utils.h"
+
+struct TriggerEngine {
+  TriggerConfig config;
+  int channel;
+  uint32_t sampleRate;
+
+  // Pre-trigger ring
+  int16_t* ring;
+  size_t ringSize;
+  size_t ringHead;         // next write position
+  size_t ringFill;
+
+  // Event records: free pool, and the one currently being filled
+  TriggerEvent records[TRIGGER_EVENT_SLOTS];
+  QueueHandle_t freeRecords;
+  TriggerEvent* active;
+  size_t postRemaining;
+
+  // Detector state
+  float sta;
+  float lta;
+  float staAlpha;
+  float ltaAlpha;
+  uint32_t warmupRemaining;  // LTA is not trusted until it has seen one LTA length
+  uint32_t holdoffRemaining;
+  int16_t last;
+
+  uint32_t nextId;
+  TriggerStats stats;
+};
+
+static QueueHandle_t triggerShipQueue = NULL;
+
+/******************************************************************
+ *                                                                *
+ *                          Detection                             *
+ *                                                                *
+ ******************************************************************/
+
+static size_t trigger_ms_to_samples(const TriggerEngine* engine, uint32_t ms) {
+  return (size_t)((uint64_t)ms * engine->sampleRate / 1000);
+}
+
+// Returns the detector value when the sample fires the trigger, or a negative value
+static float trigger_detect(TriggerEngine* engine, int16_t sample) {
+  float magnitude = fabsf((float)sample);
+  float value = -1.0f;
+
+  switch (engine->config.mode) {
+    case TRIGGER_THRESHOLD:
+      if (magnitude >= engine->config.threshold) {
+        value = magnitude;
+      }
+      break;
+
+    case TRIGGER_SLOPE: {
+      float slope = fabsf((float)sample - (float)engine->last);
+      if (slope >= engine->config.threshold) {
+        value = slope;
+      }
+      break;
+    }
+
+    case TRIGGER_STA_LTA:
+      engine->sta += (magnitude - engine->sta) * engine->staAlpha;
+      engine->lta += (magnitude - engine->lta) * engine->ltaAlpha;
+      if (engine->warmupRemaining > 0) {
+        engine->warmupRemaining--;
+      } else if (engine->lta > 0 && engine->sta >= engine->config.threshold * engine->lta) {
+        value = engine->sta / engine->lta;
+      }
+      break;
+  }
+  engine->last = sample;
+  return value;
+}
+
+static void trigger_start_event(TriggerEngine* engine, float value, int64_t triggerUs) {
+  TriggerEvent* event;
+  if (xQueueReceive(engine->freeRecords, &event, 0) != pdTRUE) {
+    engine->stats.missed++;
+    engine->holdoffRemaining = trigger_ms_to_samples(engine, engine->config.holdoffMs);
+    return;
+  }
+
+  // Freeze the pre-trigger ring, oldest sample first
+  size_t pre = engine->ringFill;
+  size_t start = (engine->ringHead + engine->ringSize - pre) % engine->ringSize;
+  for (size_t i = 0; i < pre; i++) {
+    event->samples[i] = engine->ring[(start + i) % engine->ringSize];
+  }
+
+  event->id = engine->nextId++;
+  event->channel = engine->channel;
+  event->triggerUs = triggerUs;
+  event->sampleRate = engine->sampleRate;
+  event->mode = engine->config.mode;
+  event->triggerValue = value;
+  event->preSamples = pre;
+  event->count = pre;
+  event->peak = 0;
+  for (size_t i = 0; i < pre; i++) {
+    int16_t magnitude = abs(event->samples[i]);
+    if (magnitude > event->peak) {
+      event->peak = magnitude;
+    }
+  }
+
+  engine->active = event;
+  engine->postRemaining = trigger_ms_to_samples(engine, engine->config.postMs) + 1;  // + trigger sample
+  engine->stats.events++;
+}
+
+static void trigger_finish_event(TriggerEngine* engine) {
+  TriggerEvent* event = engine->active;
+  engine->active = nullptr;
+  engine->ringFill = 0;  // the next pre-trigger window starts after this event
+  engine->holdoffRemaining = trigger_ms_to_samples(engine, engine->config.holdoffMs);
+  if (xQueueSend(triggerShipQueue, &event, 0) != pdTRUE) {
+    engine->stats.missed++;
+    xQueueSend(engine->freeRecords, &event, 0);
+  }
+}
+
+// Post-trigger: record, detector frozen so the event does not inflate the LTA
+static void trigger_record(TriggerEngine* engine, int16_t sample) {
+  TriggerEvent* event = engine->active;
+  event->samples[event->count++] = sample;
+  int16_t magnitude = abs(sample);
+  if (magnitude > event->peak) {
+    event->peak = magnitude;
+  }
+  engine->last = sample;
+  if (engine->postRemaining-- <= 1) {
+    trigger_finish_event(engine);
+  }
+}
+
+void trigger_process(TriggerEngine* engine, const int16_t* samples, size_t count, int64_t blockUs) {
+  for (size_t i = 0; i < count; i++) {
+    int16_t sample = samples[i];
+
+    if (engine->active != nullptr) {
+      trigger_record(engine, sample);
+      continue;
+    }
+
+    float value = trigger_detect(engine, sample);
+    if (engine->holdoffRemaining > 0) {
+      engine->holdoffRemaining--;
+      value = -1.0f;
+    }
+
+    if (value >= 0) {
+      // Sample i ends (count - i) sample periods before the block does
+      trigger_start_event(engine, value, blockUs - (int64_t)(count - i) * 1000000 / engine->sampleRate);
+      if (engine->active != nullptr) {
+        trigger_record(engine, sample);  // the trigger sample opens the post-trigger part
+        continue;
+      }
+    }
+
+    engine->ring[engine->ringHead] = sample;
+    engine->ringHead = (engine->ringHead + 1) % engine->ringSize;
+    if (engine->ringFill < engine->ringSize) {
+      engine->ringFill++;
+    }
+  }
+}
+
+void trigger_consumer(const int16_t* samples, size_t count, int64_t blockUs, void* context) {
+  trigger_process((TriggerEngine*)context, samples, count, blockUs);
+}
+
+/******************************************************************
+ *                                                                *
+ *                           Shipping                             *
+ *                                                                *
+ ******************************************************************/
+
+void triggerShipTask(void* parameter) {
+  while (true) {
+    TriggerEvent* event;
+    if (xQueueReceive(triggerShipQueue, &event, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    // Held until its trigger stamp can be resolved; events meanwhile wait in the queue
+    // or, with every record in use, are counted as missed
+    while (!time_wall_valid()) {
+      vTaskDelay(1000 / portTICK_PERIOD_MS);
+    }
+    if (!publish_trigger_event(event)) {
+      Serial.printf("Trigger: event %lu on channel %d could not be published\n", event->id, event->channel);
+    }
+    xQueueSend(event->engine->freeRecords, &event, 0);
+  }
+}
+
+TriggerEngine* trigger_create(int channel, uint32_t sampleRate, const TriggerConfig* config) {
+  TriggerEngine* engine = (TriggerEngine*)calloc(1, sizeof(TriggerEngine));
+  if (engine == nullptr) {
+    return nullptr;
+  }
+  engine->config = *config;
+  engine->channel = channel;
+  engine->sampleRate = sampleRate;
+
+  engine->ringSize = max((size_t)1, trigger_ms_to_samples(engine, config->preMs));
+  size_t recordSize = engine->ringSize + trigger_ms_to_samples(engine, config->postMs) + 1;
+  engine->ring = (int16_t*)calloc(engine->ringSize, sizeof(int16_t));
+  engine->freeRecords = xQueueCreate(TRIGGER_EVENT_SLOTS, sizeof(TriggerEvent*));
+  if (engine->ring == nullptr || engine->freeRecords == NULL) {
+    Serial.println("Trigger: out of memory");
+    return nullptr;
+  }
+  for (int i = 0; i < TRIGGER_EVENT_SLOTS; i++) {
+    TriggerEvent* event = &engine->records[i];
+    event->engine = engine;
+    event->samples = (int16_t*)calloc(recordSize, sizeof(int16_t));
+    if (event->samples == nullptr) {
+      Serial.println("Trigger: out of memory");
+      return nullptr;
+    }
+    xQueueSend(engine->freeRecords, &event, 0);
+  }
+
+  float staSamples = max(1.0f, config->staMs * sampleRate / 1000.0f);
+  float ltaSamples = max(1.0f, config->ltaMs * sampleRate / 1000.0f);
+  engine->staAlpha = 1.0f / staSamples;
+  engine->ltaAlpha = 1.0f / ltaSamples;
+  engine->warmupRemaining = (uint32_t)ltaSamples;
+
+  if (triggerShipQueue == NULL) {
+    triggerShipQueue = xQueueCreate(TRIGGER_SHIP_QUEUE_LENGTH, sizeof(TriggerEvent*));
+    xTaskCreate(
+      triggerShipTask,      // Task function
+      "Trigger Ship",       // Name of the task (for debugging)
+      6144,                 // Stack size (in words, not bytes)
+      NULL,                 // Task input parameter
+      1,                    // Priority of the task
+      NULL                  // Task handle
+    );
+  }
+
+  Serial.printf("Trigger: channel %d armed, mode %d, threshold %.2f, %u ms pre / %u ms post\n",
+                channel, config->mode, config->threshold, config->preMs, config->postMs);
+  return engine;
+}
+
+void trigger_get_stats(TriggerEngine* engine, TriggerStats* stats) {
+  *stats = engine->stats;
+}
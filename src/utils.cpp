@@ -1,6 +1,7 @@
 #include "utils.h"
 #include "configuration.h"
-#include "esp_sntp.h"
+#include "rtc_drift.h"
+#include <sys/time.h>
 
 const int CS = 5; // SD Card chip select
 HardwareSerial VM(1); // UART port 1 on ESP32
@@ -127,23 +128,58 @@ void wifiKeepaliveTask(void *parameter) {
  *                                                                *
  ******************************************************************/
 
+// NTP synchronization is in time_service.cpp
 
-const char *ntpServers[] = {
-  "time.nist.gov",  // Add more NTP servers as needed
-  "pool.ntp.org",
-  "time.google.com",
-  "time.windows.com",
-};
-
-const int numNtpServers = sizeof(ntpServers) / sizeof(ntpServers[0]);
 RTC_DS1307 rtc;
 bool rtc_mounted = false;
 
+#define RTC_EDGE_POLL_MS 2          // RTC reads while waiting for its seconds to change
+
 DateTime tmToDateTime(struct tm timeinfo) {
   return DateTime(timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday, 
                   timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
 }
 
+// The DS1307 counts whole seconds. Polling for the moment its seconds change gives the
+// reading to within a few ms: returns the new RTC time and esp_timer_get_time() then.
+static bool rtc_read_edge(uint32_t* rtcSeconds, int64_t* monoUs) {
+  uint32_t first = rtc.now().unixtime();
+  int64_t deadline = esp_timer_get_time() + 1100000;
+  while (esp_timer_get_time() < deadline) {
+    vTaskDelay(RTC_EDGE_POLL_MS / portTICK_PERIOD_MS);
+    uint32_t seconds = rtc.now().unixtime();
+    if (seconds != first) {
+      *rtcSeconds = seconds;
+      *monoUs = esp_timer_get_time();
+      return true;
+    }
+  }
+  return false;  // oscillator stopped (CH bit set, or no backup battery)
+}
+
+// Wall time at monoUs including the part of an NTP correction adjtime() is still slewing
+// in: right after a sync the system clock can be up to TIME_STEP_THRESHOLD_MS behind
+// the time NTP gave, far more than the drift being measured
+static int64_t rtc_true_wall_us(int64_t monoUs) {
+  struct timeval pending = {0, 0};
+  adjtime(NULL, &pending);
+  return time_mono_to_wall_us(monoUs) + (int64_t)pending.tv_sec * 1000000 + pending.tv_usec;
+}
+
+// Writing the seconds register restarts the DS1307 divider, so setting it as true time
+// crosses a whole second aligns the two to within a tick
+static int64_t rtc_set_on_second() {
+  int64_t nowUs = rtc_true_wall_us(esp_timer_get_time());
+  int64_t second = nowUs / 1000000;
+  vTaskDelay((999 - (nowUs % 1000000) / 1000) / portTICK_PERIOD_MS);
+  do {
+    nowUs = rtc_true_wall_us(esp_timer_get_time());
+  } while (nowUs / 1000000 == second);
+  rtc.adjust(DateTime((uint32_t)(nowUs / 1000000)));
+  return nowUs / 1000000 * 1000000;
+}
+
+// The RTC keeps UTC; get_current_time() applies the zone
 void external_rtc_init(){
 
   if (! rtc.begin()) {
@@ -153,24 +189,30 @@ void external_rtc_init(){
   }
 
   rtc_mounted = true;
+  rtc_drift_load();
 
-  DateTime now = rtc.now();
   Serial.print("RTC time: ");
   Serial.println(get_external_rtc_current_time());
 
-  // Set the ESP32 system time to the RTC time
-  struct tm timeinfo;
-  timeinfo.tm_year = now.year() - 1900; // tm_year is year since 1900
-  timeinfo.tm_mon = now.month() - 1;    // tm_mon is 0-based
-  timeinfo.tm_mday = now.day();
-  timeinfo.tm_hour = now.hour();
-  timeinfo.tm_min = now.minute();
-  timeinfo.tm_sec = now.second();
-  time_t t = mktime(&timeinfo);
-  struct timeval now_tv = { .tv_sec = t };
+  uint32_t rtcSeconds;
+  int64_t edgeUs;
+  if (!rtc_read_edge(&rtcSeconds, &edgeUs)) {
+    Serial.println("RTC is not running, system time not set.");
+    return;
+  }
+
+  // Set the ESP32 system time to the RTC time, less the drift since it was last set
+  int64_t rtcUs = (int64_t)rtcSeconds * 1000000 + (esp_timer_get_time() - edgeUs);
+  int64_t trueUs = rtc_drift_compensate(rtcUs);
+  struct timeval now_tv = { .tv_sec = (time_t)(trueUs / 1000000), .tv_usec = (suseconds_t)(trueUs % 1000000) };
   settimeofday(&now_tv, NULL);
+  if (trueUs != rtcUs) {
+    Serial.printf("RTC drift compensation: %lld ms\n", (long long)((trueUs - rtcUs) / 1000));
+  }
 }
 
+// Called after NTP or a LoRa time sync has set the system clock. The RTC is only set when
+// the drift model asks for it, so it runs undisturbed long enough to measure its rate.
 void external_rtc_sync_ntp(){
 
   if(!rtc_mounted){
@@ -178,132 +220,32 @@ void external_rtc_sync_ntp(){
     return;
   }
 
-  // Synchronize DS1307 RTC with NTP time
-  struct tm timeinfo;
-  if (getLocalTime(&timeinfo)) {
-    DateTime ntpTime = tmToDateTime(timeinfo);
-    rtc.adjust(ntpTime);
-    Serial.println("DS1307 RTC synchronized with NTP time.");
-    DateTime now = rtc.now();
-    Serial.print("RTC time: ");
-    Serial.println(get_current_time(false));    return; // Exit the function if synchronization is successful
-  } else {
+  if (!time_wall_valid()) {
     Serial.println("Failed to get NTP Time for DS1307.");
     return;
   }
-}
-
-bool isDST() {
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
-    return false;
-  }
-
-  // Calculate the DST start and end dates
-  struct tm startDST, endDST;
-
-  // Start DST on the second Sunday in March at 2:00 AM
-  startDST = { 0, 0, 2, 0, 2, 0 };  // 2:00 AM on March 0 (March will be corrected)
-  startDST.tm_wday = 0;
-  startDST.tm_mday = 14 - ((startDST.tm_wday - 1) % 7); // Second Sunday in March
-  startDST.tm_year = timeinfo.tm_year;
-
-  // End DST on the first Sunday in November at 2:00 AM
-  endDST = { 0, 0, 2, 0, 10, 0 };  // 2:00 AM on November 0 (November will be corrected)
-  endDST.tm_wday = 0;
-  endDST.tm_mday = 7 - ((endDST.tm_wday - 1) % 7); // First Sunday in November
-  endDST.tm_year = timeinfo.tm_year;
-
-  time_t now = mktime(&timeinfo);
-  time_t start = mktime(&startDST);
-  time_t end = mktime(&endDST);
 
-  return now >= start && now < end;
-}
-
-void ntp_sync() {
-  const int standardOffset_sec = 0;
-  const int daylightOffset_sec = 3600;
-  const int maxAttempts = 5;  // Maximum number of attempts per server
-  long gmtOffset_sec = systemConfig.utcOffset * 3600;
-  long daylightOffset = isDST() ? daylightOffset_sec : standardOffset_sec;
-
-  // Attempt synchronization with each NTP server in the list
-  for (int i = 0; i < numNtpServers; i++) {
-    configTime(gmtOffset_sec, daylightOffset, ntpServers[i]);
-
-    bool syncSuccess = false;
-    for (int attempt = 0; attempt < maxAttempts; attempt++) {
-      vTaskDelay(2000 / portTICK_PERIOD_MS); // Delay for 2 seconds
-
-      // Check synchronization status
-      if (sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED) {
-        struct tm timeinfo;
-        if (getLocalTime(&timeinfo)) {
-          external_rtc_sync_ntp();
-          syncSuccess = true;
-          break; // Exit the retry loop if synchronization is successful
-        }
-      }
-    }
-
-    if (syncSuccess) {
-      return; // Exit the function if synchronization is successful
-    }
+  uint32_t rtcSeconds;
+  int64_t edgeUs;
+  bool running = rtc_read_edge(&rtcSeconds, &edgeUs);
+  if (running && !rtc_drift_observe((int64_t)rtcSeconds * 1000000, rtc_true_wall_us(edgeUs))) {
+    return;
   }
-  // If synchronization fails with all servers
-  Serial.println("Failed to synchronize with any NTP server.");
-}
-
-String get_current_time(bool getFilename) {
-  struct tm timeinfo;
 
-  if (getLocalTime(&timeinfo)) {
-    
-    const int standardOffset_hour = systemConfig.utcOffset;
-    const int daylightOffset_hour = standardOffset_hour + 1;
-    char buffer[30];
-    if (!getFilename) {
-      snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d%+03d:00", 
-                timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday, 
-                timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec,
-                (isDST() ? daylightOffset_hour : standardOffset_hour));
-    } else {
-      snprintf(buffer, sizeof(buffer), "%04d_%02d_%02d_%02d_%02d_%02d", 
-               timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday, 
-               timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-    }
-    return String(buffer);
-  } else {
-    Serial.println("Failed to get system time. Cannot get current time.");
-    return "error.";
-  }
+  rtc_drift_reference(rtc_set_on_second());
+  Serial.println("DS1307 RTC synchronized with NTP time.");
+  Serial.print("RTC time: ");
+  Serial.println(get_external_rtc_current_time());
 }
 
 String get_external_rtc_current_time(){
   DateTime now = rtc.now();
   char buffer[30];
-    snprintf(buffer, sizeof(buffer), "%04d/%02d/%02d %02d:%02d:%02d", 
+    snprintf(buffer, sizeof(buffer), "%04d/%02d/%02d %02d:%02d:%02d UTC", 
               now.year(), now.month(), now.day(), now.hour(), now.minute(), now.second());
   return String(buffer);
 }
 
-String convertTMtoString(time_t now){
-  char buffer[30];
-  struct tm timeinfo;
-  localtime_r(&now, &timeinfo);  // Convert time_t to struct tm in local time
-
-  const int standardOffset_hour = systemConfig.utcOffset;
-  const int daylightOffset_hour = standardOffset_hour + 1;
-
-  snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d%+03d:00", 
-            timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday, 
-            timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec,
-            (isDST() ? daylightOffset_hour : standardOffset_hour)
-);
-  return String(buffer);
-}
-
 /******************************************************************
  *                                                                *
  *                            SD Card                             *
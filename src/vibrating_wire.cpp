@@ -1,70 +1,392 @@
 #include "vibrating_wire.h"
+#include "esp_timer.h"
 
 extern HardwareSerial VM; // UART port 1 on ESP32
 
 const int MAX_COMMANDSIZE = 6;
 
-unsigned int crc16(unsigned char *dat, unsigned int len)
-{
-    unsigned int crc = 0xffff;
-    unsigned char i;
-    while (len != 0)
-    {
-        crc ^= *dat;
-        for (i = 0; i < 8; i++)
-        {
-            if ((crc & 0x0001) == 0)
-                crc = crc >> 1;
-            else
-            {
-                crc = crc >> 1;
-                crc ^= 0xa001;
-            }
-        }
-        len -= 1;
-        dat++;
+enum VM501Framing : uint8_t {
+  VM501_FRAME_ASCII,    // reply ends with '\n'
+  VM501_FRAME_MODBUS,   // reply length follows from its header
+};
+
+// Called once per transaction with the module still reserved; the handler copies what
+// it needs out of vm501.rx and then calls vm501_release()
+typedef void (*VM501Handler)(uint8_t result, void* context);
+
+// One outstanding transaction at a time; the module is a single point-to-point device
+static struct {
+  bool initialized;
+  bool busy;                    // reserved by a transaction, until released by its handler
+  bool pending;                 // waiting for the reply
+  VM501Framing framing;
+  uint8_t rx[VM501_MAX_RESPONSE];
+  size_t rxLen;
+  size_t responseLen;
+  VM501Handler handler;
+  void* context;
+  esp_timer_handle_t timer;
+} vm501;
+
+static portMUX_TYPE vm501Mux = portMUX_INITIALIZER_UNLOCKED;
+
+/******************************************************************
+ *                                                                *
+ *                        Transactions                            *
+ *                                                                *
+ ******************************************************************/
+
+static void vm501_release() {
+  portENTER_CRITICAL(&vm501Mux);
+  vm501.busy = false;
+  portEXIT_CRITICAL(&vm501Mux);
+}
+
+// First of RX completion and timeout wins
+static void vm501_finish(uint8_t result) {
+  portENTER_CRITICAL(&vm501Mux);
+  bool wasPending = vm501.pending;
+  vm501.pending = false;
+  portEXIT_CRITICAL(&vm501Mux);
+  if (!wasPending) {
+    return;
+  }
+  esp_timer_stop(vm501.timer);
+  vm501.handler(result, vm501.context);
+}
+
+// Reserve the module for one transaction; false if it is busy or not initialized
+static bool vm501_reserve() {
+  portENTER_CRITICAL(&vm501Mux);
+  bool available = vm501.initialized && !vm501.busy;
+  if (available) {
+    vm501.busy = true;
+  }
+  portEXIT_CRITICAL(&vm501Mux);
+  return available;
+}
+
+static void vm501_send(VM501Framing framing, const uint8_t* tx, size_t txLen, uint32_t timeoutMs,
+                       VM501Handler handler, void* context) {
+  // Drop late bytes of an earlier reply
+  while (VM.available() > 0) {
+    VM.read();
+  }
+  vm501.framing = framing;
+  vm501.rxLen = 0;
+  vm501.responseLen = 0;
+  vm501.handler = handler;
+  vm501.context = context;
+
+  portENTER_CRITICAL(&vm501Mux);
+  vm501.pending = true;
+  portEXIT_CRITICAL(&vm501Mux);
+
+  VM.write(tx, txLen);
+  esp_timer_start_once(vm501.timer, (uint64_t)timeoutMs * 1000ULL);
+}
+
+// Incremental parse: complete on the terminator or once the Modbus length is satisfied
+static void vm501_on_receive() {
+  uint8_t chunk[64];
+  while (VM.available() > 0) {
+    size_t n = VM.read(chunk, sizeof(chunk));
+
+    portENTER_CRITICAL(&vm501Mux);
+    bool pending = vm501.pending;
+    portEXIT_CRITICAL(&vm501Mux);
+    if (!pending) {
+      continue;  // nobody is waiting: line noise or a late reply
+    }
+
+    size_t space = sizeof(vm501.rx) - vm501.rxLen;
+    size_t start = vm501.rxLen;
+    memcpy(vm501.rx + vm501.rxLen, chunk, min(n, space));
+    vm501.rxLen += min(n, space);
+
+    if (vm501.framing == VM501_FRAME_ASCII) {
+      uint8_t* end = (uint8_t*)memchr(vm501.rx + start, '\n', vm501.rxLen - start);
+      if (end != nullptr) {
+        vm501.responseLen = end - vm501.rx;
+        vm501_finish(MODBUS_OK);
+      }
+    } else {
+      size_t expected = modbus_response_length(vm501.rx, vm501.rxLen);
+      if (expected > 0 && vm501.rxLen >= expected) {
+        vm501.responseLen = expected;
+        vm501_finish(MODBUS_OK);
+      }
     }
-    return crc;
+    if (vm501.rxLen == sizeof(vm501.rx) && vm501.responseLen == 0) {
+      vm501_finish(MODBUS_ERR_INVALID_FUNCTION);  // overlong reply, no terminator
+    }
+  }
+}
+
+static void vm501_timer_callback(void* arg) {
+  vm501_finish(MODBUS_ERR_RESPONSE_TIMEOUT);
+}
+
+void vm501_init() {
+  if (vm501.initialized) {
+    return;
+  }
+  VM.begin(VM501_BAUD, SERIAL_8N1, VM501_RX_PIN, VM501_TX_PIN); // Initialize UART port 1 with GPIO16 as RX and GPIO17 as TX
+
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = vm501_timer_callback;
+  timerArgs.dispatch_method = ESP_TIMER_TASK;
+  timerArgs.name = "vm501";
+  esp_timer_create(&timerArgs, &vm501.timer);
+
+  // Deliver bytes after two idle symbols instead of waiting for the FIFO threshold
+  VM.setRxTimeout(2);
+  VM.onReceive(vm501_on_receive, false);
+
+  vm501.initialized = true;
+}
+
+/******************************************************************
+ *                                                                *
+ *                          Readings                              *
+ *                                                                *
+ ******************************************************************/
+
+struct VM501ReadContext {
+  VM501Callback onComplete;
+  void* context;
+};
+
+static VM501ReadContext vm501ReadContext;
+
+static void vm501_read_handler(uint8_t result, void* context) {
+  VM501ReadContext* read = (VM501ReadContext*)context;
+  VM501Callback onComplete = read->onComplete;
+  void* userContext = read->context;
+
+  VM501Reading reading = {};
+  uint16_t regs[VM501_REG_DATA_COUNT];
+  if (result == MODBUS_OK) {
+    result = modbus_decode_read_response(vm501.rx, vm501.responseLen, VM501_SLAVE_ID,
+                                         MODBUS_FC_READ_HOLDING_REGISTERS, VM501_REG_DATA_COUNT, regs);
+  }
+  reading.result = result;
+  if (result == MODBUS_OK) {
+    reading.frequency = regs[VM501_OFFSET_FREQUENCY] * VM501_FREQUENCY_SCALE;
+    reading.temperature = (int16_t)regs[VM501_OFFSET_TEMPERATURE] * VM501_TEMPERATURE_SCALE;
+  } else {
+    reading.frequency = -9999.0f;
+    reading.temperature = -9999.0f;
+  }
+
+  // Free the module first so the callback can start the next reading
+  vm501_release();
+  onComplete(&reading, userContext);
+}
+
+bool vm501_read_async(VM501Callback onComplete, void* context) {
+  uint8_t frame[MODBUS_READ_REQUEST_SIZE];
+  size_t len = modbus_encode_read_request(frame, VM501_SLAVE_ID, MODBUS_FC_READ_HOLDING_REGISTERS,
+                                          VM501_REG_DATA_START, VM501_REG_DATA_COUNT);
+  if (!vm501_reserve()) {
+    return false;
+  }
+  // Only touched while the module is reserved
+  vm501ReadContext.onComplete = onComplete;
+  vm501ReadContext.context = context;
+  vm501_send(VM501_FRAME_MODBUS, frame, len, VM501_MODBUS_TIMEOUT_MS, vm501_read_handler, &vm501ReadContext);
+  return true;
+}
+
+struct VM501Waiter {
+  TaskHandle_t task;
+  VM501Reading* reading;
+};
+
+static void vm501_wake_reader(const VM501Reading* reading, void* context) {
+  VM501Waiter* waiter = (VM501Waiter*)context;
+  *waiter->reading = *reading;
+  xTaskNotifyGive(waiter->task);
+}
+
+bool vm501_read(VM501Reading* reading) {
+  VM501Waiter waiter = {xTaskGetCurrentTaskHandle(), reading};
+  if (!vm501_read_async(vm501_wake_reader, &waiter)) {
+    reading->result = MODBUS_ERR_RESPONSE_TIMEOUT;
+    reading->frequency = -9999.0f;
+    reading->temperature = -9999.0f;
+    return false;
+  }
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // the timer guarantees a completion
+  return reading->result == MODBUS_OK;
+}
+
+/******************************************************************
+ *                                                                *
+ *                      Multiplexed Sweep                         *
+ *                                                                *
+ ******************************************************************/
+
+static const uint8_t vwMuxSelectPins[4] = {VW_MUX_S0, VW_MUX_S1, VW_MUX_S2, VW_MUX_S3};
+
+void vw_mux_init() {
+  for (int i = 0; i < 4; i++) {
+    pinMode(vwMuxSelectPins[i], OUTPUT);
+    digitalWrite(vwMuxSelectPins[i], LOW);
+  }
+  pinMode(VW_MUX_EN, OUTPUT);
+  digitalWrite(VW_MUX_EN, HIGH);  // Start disconnected
+}
+
+void vw_mux_select(uint8_t muxChannel) {
+  for (int i = 0; i < 4; i++) {
+    digitalWrite(vwMuxSelectPins[i], (muxChannel >> i) & 1);
+  }
+  digitalWrite(VW_MUX_EN, LOW);
+}
+
+void vw_mux_disable() {
+  digitalWrite(VW_MUX_EN, HIGH);
+}
+
+struct VWSweepSlot {
+  TaskHandle_t task;
+  VM501Reading* reading;
+};
+
+static void vw_sweep_read_done(const VM501Reading* reading, void* context) {
+  VWSweepSlot* slot = (VWSweepSlot*)context;
+  *slot->reading = *reading;
+  xTaskNotifyGive(slot->task);
+}
+
+size_t vw_sweep(const uint8_t* muxChannels, size_t count, VM501Reading* readings,
+                const VWSweepTiming* timing) {
+  VWSweepTiming defaults = {VW_MUX_SETTLE_MS, VW_EXCITATION_MS};
+  if (timing == nullptr) {
+    timing = &defaults;
+  }
+
+  VWSweepSlot slot = {xTaskGetCurrentTaskHandle(), nullptr};
+  bool readPending = false;
+
+  for (size_t i = 0; i < count; i++) {
+    // Switch first: the previous gauge's register readout overlaps this settle time
+    vw_mux_select(muxChannels[i] % VW_MUX_CHANNELS);
+    vTaskDelay(pdMS_TO_TICKS(timing->settleMs + timing->excitationMs));
+
+    if (readPending) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // normally done long before this
+      readPending = false;
+    }
+
+    slot.reading = &readings[i];
+    readPending = vm501_read_async(vw_sweep_read_done, &slot);
+    if (!readPending) {
+      readings[i].result = MODBUS_ERR_RESPONSE_TIMEOUT;
+      readings[i].frequency = -9999.0f;
+      readings[i].temperature = -9999.0f;
+    }
+  }
+  if (readPending) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+  vw_mux_disable();
+
+  size_t good = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (readings[i].result == MODBUS_OK) {
+      good++;
+    }
+  }
+  return good;
+}
+
+/******************************************************************
+ *                                                                *
+ *                     Raw Commands (Console)                     *
+ *                                                                *
+ ******************************************************************/
+
+struct VM501RawWait {
+  TaskHandle_t task;
+  uint8_t result;
+};
+
+static void vm501_raw_handler(uint8_t result, void* context) {
+  VM501RawWait* wait = (VM501RawWait*)context;
+  wait->result = result;
+  xTaskNotifyGive(wait->task);  // the waiting task copies the reply, then releases
+}
+
+// Run a transaction and copy its reply; -1 on timeout or busy
+static int vm501_transact(VM501Framing framing, const uint8_t* tx, size_t txLen, uint32_t timeoutMs,
+                          uint8_t* reply, size_t maxLen) {
+  VM501RawWait wait = {xTaskGetCurrentTaskHandle(), MODBUS_ERR_RESPONSE_TIMEOUT};
+  if (!vm501_reserve()) {
+    return -1;
+  }
+  vm501_send(framing, tx, txLen, timeoutMs, vm501_raw_handler, &wait);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+  int len = -1;
+  if (wait.result == MODBUS_OK) {
+    len = (int)min(vm501.responseLen, maxLen);
+    memcpy(reply, vm501.rx, len);
+  }
+  vm501_release();
+  return len;
+}
+
+int vm501_command(const char* command, char* reply, size_t maxLen) {
+  size_t commandLen = strlen(command);
+  uint8_t tx[commandLen + 1];
+  memcpy(tx, command, commandLen);
+  if (commandLen == 0 || command[commandLen - 1] != '\n') {
+    tx[commandLen++] = '\n';
+  }
+
+  int len = vm501_transact(VM501_FRAME_ASCII, tx, commandLen, VM501_ASCII_TIMEOUT_MS,
+                           (uint8_t*)reply, maxLen - 1);
+  if (len < 0) {
+    reply[0] = '\0';
+    return -1;
+  }
+  while (len > 0 && reply[len - 1] == '\r') {
+    len--;
+  }
+  reply[len] = '\0';
+  return len;
+}
+
+int vm501_modbus(const uint8_t* frame, size_t len, uint8_t* reply, size_t maxLen) {
+  return vm501_transact(VM501_FRAME_MODBUS, frame, len, VM501_MODBUS_TIMEOUT_MS, reply, maxLen);
 }
 
 void parseCommand(const char* command) {
-    // Variables to store parsed values
-    char commandName[6];
-    uint8_t address;
-    uint8_t functionCode;
-    uint8_t startAddressHigh;
-    uint8_t startAddressLow;
-    uint8_t numRegistersHigh;
-    uint8_t numRegistersLow;
-    uint8_t crcHigh;
-    uint8_t crcLow;
-
-    uint8_t hexArray[MAX_COMMANDSIZE] = {};
+    uint8_t frame[MAX_COMMANDSIZE + 2] = {};
 
 // MODBUS 0x01 0x03 0x00 0x00 0x00 0x0A
-// MODBUS 0x01 0x03 0x00 0x27 0x00 0x01 GET Sensor Resistance 
+// MODBUS 0x01 0x03 0x00 0x27 0x00 0x01 GET Sensor Resistance
   if (strncmp(command, "MODBUS", 6) == 0) {
-    // Use sscanf to parse the command string
-    int result = sscanf(command, "%s 0x%2hhx 0x%2hhx 0x%2hhx 0x%2hhx 0x%2hhx 0x%2hhx",
-                        &commandName, 
-                        &hexArray[0], &hexArray[1], &hexArray[2], &hexArray[3], 
-                        &hexArray[4], &hexArray[5]);
-
-    // Check if all values were successfully parsed
-    if (result - 1 == MAX_COMMANDSIZE) {
-      unsigned int crc = crc16(hexArray, sizeof(hexArray));
-      uint8_t crcHighByte = (uint8_t)(crc >> 8);
-      uint8_t crcLowByte = (uint8_t)(crc & 0xFF);
-
-      VM.write(hexArray, sizeof(hexArray));
-      VM.write(crcLowByte);
-      VM.write(crcHighByte);
-
-      delay(1000);
+    // Six request bytes; the CRC is appended here
+    if (modbus_parse_hex_bytes(command + 6, frame, MAX_COMMANDSIZE) == MAX_COMMANDSIZE) {
+      size_t len = modbus_append_crc(frame, MAX_COMMANDSIZE);
+
+      uint8_t reply[VM501_MAX_RESPONSE];
+      int replyLen = vm501_modbus(frame, len, reply, sizeof(reply));
+      if (replyLen < 0) {
+        Serial.println("No reponse from VM501.");
+        return;
+      }
       Serial.printf("VM501:");
-      while (VM.available() > 0) {
-        uint8_t incomingByte = VM.read();
-        Serial.printf("0x%02x ", incomingByte);
+      for (int i = 0; i < replyLen; i++) {
+        Serial.printf("0x%02x ", reply[i]);
+      }
+      if (!modbus_check_crc(reply, replyLen)) {
+        Serial.printf("(CRC error)");
+      } else if (modbus_is_exception(reply, replyLen)) {
+        Serial.printf("(exception 0x%02x)", reply[2]);
       }
       Serial.printf("\n");
     }
@@ -73,15 +395,9 @@ void parseCommand(const char* command) {
     }
   }
   else if (strncmp(command, "$", 1) == 0){
-
-    VM.write(command);
-    VM.write("\n");
-
-    delay(3000);
-
-    if (VM.available() > 0) {
-      String receivedChar = VM.readString();
-      Serial.println(receivedChar);
+    char reply[VM501_MAX_RESPONSE];
+    if (vm501_command(command, reply, sizeof(reply)) >= 0) {
+      Serial.println(reply);
     }
     else{
       Serial.println("No reponse from VM501.");
@@ -92,17 +408,10 @@ void parseCommand(const char* command) {
   }
 }
 
-void vm501_init() {
-  VM.begin(9600, SERIAL_8N1, 16, 17); // Initialize UART port 1 with GPIO16 as RX and GPIO17 as TX
-}
-
 String readVM(){
-    const char * command = "$MSFT=3\n";
-    VM.write(command);
-    delay(500);
-    if (VM.available() > 0) {
-        String receivedChar = VM.readString();
-        return receivedChar;
+    char reply[VM501_MAX_RESPONSE];
+    if (vm501_command("$MSFT=3", reply, sizeof(reply)) > 0) {
+        return String(reply);
     }
     else{
         return "NaN";
@@ -126,7 +435,3 @@ void sendCommandVM501(void *parameter) {
         vTaskDelay(10 / portTICK_PERIOD_MS);
     }
 }
-
-
-
-
@@ -0,0 +1,270 @@
+// Host tests of the Modbus RTU codec: request encoding, response decoding, exception
+// frames, short and malformed frames, and the CRC.
+//
+//   pio test -e native
+
+#include <string.h>
+#include <unity.h>
+
+#include "modbus_codec.h"
+
+// Bit-at-a-time CRC-16/MODBUS, the reference the table-driven version must reproduce
+static uint16_t crc16_bitwise(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= *data++;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+  }
+  return crc;
+}
+
+// Response frame from its body (slave, function, payload) with a valid CRC
+static size_t make_frame(uint8_t* frame, const uint8_t* body, size_t len) {
+  memcpy(frame, body, len);
+  return modbus_append_crc(frame, len);
+}
+
+void setUp() {}
+void tearDown() {}
+
+/******************************************************************
+ *                                                                *
+ *                              CRC                               *
+ *                                                                *
+ ******************************************************************/
+
+static void test_crc_check_value() {
+  const char* check = "123456789";
+  TEST_ASSERT_EQUAL_HEX16(0x4B37, modbus_crc16((const uint8_t*)check, strlen(check)));
+  TEST_ASSERT_EQUAL_HEX16(0xFFFF, modbus_crc16(nullptr, 0));
+}
+
+static void test_crc_matches_bitwise() {
+  uint8_t data[300];
+  uint32_t seed = 1;
+  for (size_t i = 0; i < sizeof(data); i++) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = seed >> 16;
+  }
+  for (size_t len = 0; len <= sizeof(data); len++) {
+    TEST_ASSERT_EQUAL_HEX16(crc16_bitwise(data, len), modbus_crc16(data, len));
+  }
+}
+
+static void test_crc_append_and_check() {
+  uint8_t frame[8] = {0x11, 0x03, 0x00, 0x6B, 0x00, 0x03};
+  TEST_ASSERT_EQUAL(8, modbus_append_crc(frame, 6));
+  TEST_ASSERT_EQUAL_HEX8(0x76, frame[6]);  // low byte first
+  TEST_ASSERT_EQUAL_HEX8(0x87, frame[7]);
+  TEST_ASSERT_TRUE(modbus_check_crc(frame, 8));
+
+  for (size_t i = 0; i < 8; i++) {
+    for (int bit = 0; bit < 8; bit++) {
+      frame[i] ^= 1 << bit;
+      TEST_ASSERT_FALSE(modbus_check_crc(frame, 8));
+      frame[i] ^= 1 << bit;
+    }
+  }
+}
+
+static void test_crc_short_frames() {
+  const uint8_t frame[] = {0xFF, 0xFF, 0xFF};
+  TEST_ASSERT_FALSE(modbus_check_crc(frame, 0));
+  TEST_ASSERT_FALSE(modbus_check_crc(frame, 1));
+  TEST_ASSERT_FALSE(modbus_check_crc(frame, 2));  // the CRC of nothing is 0xFFFF
+}
+
+/******************************************************************
+ *                                                                *
+ *                            Requests                            *
+ *                                                                *
+ ******************************************************************/
+
+static void test_encode_read_request() {
+  uint8_t frame[MODBUS_READ_REQUEST_SIZE];
+  const uint8_t expected[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+  TEST_ASSERT_EQUAL(MODBUS_READ_REQUEST_SIZE,
+                    modbus_encode_read_request(frame, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 0x0000, 10));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame, sizeof(expected));
+}
+
+static void test_encode_big_endian_fields() {
+  uint8_t frame[MODBUS_READ_REQUEST_SIZE];
+  modbus_encode_read_request(frame, 0xF7, MODBUS_FC_READ_INPUT_REGISTERS, 0xE004, MODBUS_MAX_READ_REGISTERS);
+  TEST_ASSERT_EQUAL_HEX8(0xF7, frame[0]);
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_FC_READ_INPUT_REGISTERS, frame[1]);
+  TEST_ASSERT_EQUAL_HEX8(0xE0, frame[2]);
+  TEST_ASSERT_EQUAL_HEX8(0x04, frame[3]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, frame[4]);
+  TEST_ASSERT_EQUAL_HEX8(0x7D, frame[5]);
+  TEST_ASSERT_TRUE(modbus_check_crc(frame, sizeof(frame)));
+}
+
+/******************************************************************
+ *                                                                *
+ *                           Responses                            *
+ *                                                                *
+ ******************************************************************/
+
+static void test_decode_read_response() {
+  const uint8_t body[] = {0x01, 0x03, 0x04, 0x00, 0x0A, 0xE0, 0x04};
+  uint8_t frame[16];
+  size_t len = make_frame(frame, body, sizeof(body));
+  TEST_ASSERT_EQUAL(len, modbus_response_length(frame, len));
+
+  uint16_t out[2] = {0, 0};
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_OK, modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 2, out));
+  TEST_ASSERT_EQUAL_HEX16(0x000A, out[0]);
+  TEST_ASSERT_EQUAL_HEX16(0xE004, out[1]);
+  TEST_ASSERT_FALSE(modbus_is_exception(frame, len));
+}
+
+static void test_response_length_partial() {
+  const uint8_t read[] = {0x01, 0x03, 0x04};
+  TEST_ASSERT_EQUAL(0, modbus_response_length(read, 0));
+  TEST_ASSERT_EQUAL(0, modbus_response_length(read, 1));
+  TEST_ASSERT_EQUAL(0, modbus_response_length(read, 2));  // byte count not here yet
+  TEST_ASSERT_EQUAL(9, modbus_response_length(read, 3));
+
+  const uint8_t exception[] = {0x01, 0x83};
+  TEST_ASSERT_EQUAL(MODBUS_EXCEPTION_SIZE, modbus_response_length(exception, 2));
+}
+
+static void test_decode_exception() {
+  const uint8_t body[] = {0x01, 0x83, MODBUS_EX_ILLEGAL_DATA_ADDRESS};
+  uint8_t frame[8];
+  size_t len = make_frame(frame, body, sizeof(body));
+  TEST_ASSERT_EQUAL(MODBUS_EXCEPTION_SIZE, len);
+  TEST_ASSERT_EQUAL(MODBUS_EXCEPTION_SIZE, modbus_response_length(frame, 2));
+  TEST_ASSERT_TRUE(modbus_is_exception(frame, len));
+
+  uint16_t out = 0x5555;
+  uint8_t result = modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 1, &out);
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_EX_ILLEGAL_DATA_ADDRESS, result);
+  TEST_ASSERT_TRUE(modbus_result_is_exception(result));
+  TEST_ASSERT_EQUAL_HEX16(0x5555, out);
+}
+
+static void test_decode_exception_code_zero() {
+  const uint8_t body[] = {0x01, 0x83, 0x00};
+  uint8_t frame[8];
+  size_t len = make_frame(frame, body, sizeof(body));
+  uint16_t out;
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_ERR_INVALID_FUNCTION,
+                         modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 1, &out));
+}
+
+static void test_result_classification() {
+  TEST_ASSERT_FALSE(modbus_result_is_exception(MODBUS_OK));
+  TEST_ASSERT_TRUE(modbus_result_is_exception(MODBUS_EX_ILLEGAL_FUNCTION));
+  TEST_ASSERT_TRUE(modbus_result_is_exception(MODBUS_EX_SLAVE_DEVICE_FAILURE));
+  TEST_ASSERT_FALSE(modbus_result_is_exception(MODBUS_ERR_INVALID_SLAVE_ID));
+  TEST_ASSERT_FALSE(modbus_result_is_exception(MODBUS_ERR_RESPONSE_TIMEOUT));
+  TEST_ASSERT_FALSE(modbus_result_is_exception(MODBUS_ERR_INVALID_CRC));
+}
+
+static void test_decode_bad_crc() {
+  const uint8_t body[] = {0x01, 0x03, 0x02, 0x12, 0x34};
+  uint8_t frame[8];
+  size_t len = make_frame(frame, body, sizeof(body));
+  frame[3] ^= 0x01;
+
+  uint16_t out = 0x5555;
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_ERR_INVALID_CRC,
+                         modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 1, &out));
+  TEST_ASSERT_EQUAL_HEX16(0x5555, out);
+
+  // Corrupted exception frames are rejected before the exception code is trusted
+  const uint8_t exception[] = {0x01, 0x83, MODBUS_EX_ILLEGAL_DATA_ADDRESS};
+  len = make_frame(frame, exception, sizeof(exception));
+  frame[len - 1] ^= 0x80;
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_ERR_INVALID_CRC,
+                         modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 1, &out));
+}
+
+static void test_decode_short_frames() {
+  const uint8_t frame[] = {0x01, 0x03, 0x02, 0x12, 0x34};
+  uint16_t out;
+  for (size_t len = 0; len < sizeof(frame); len++) {
+    TEST_ASSERT_EQUAL_HEX8(MODBUS_ERR_INVALID_CRC,
+                           modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 1, &out));
+  }
+}
+
+static void test_decode_wrong_slave() {
+  const uint8_t body[] = {0x02, 0x03, 0x02, 0x12, 0x34};
+  uint8_t frame[8];
+  size_t len = make_frame(frame, body, sizeof(body));
+  uint16_t out;
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_ERR_INVALID_SLAVE_ID,
+                         modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 1, &out));
+}
+
+static void test_decode_mismatched_frames() {
+  uint8_t frame[16];
+  uint16_t out[2];
+
+  // Function code other than the one requested
+  const uint8_t function[] = {0x01, 0x04, 0x02, 0x12, 0x34};
+  size_t len = make_frame(frame, function, sizeof(function));
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_ERR_INVALID_FUNCTION,
+                         modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 1, out));
+
+  // Fewer registers than requested
+  const uint8_t fewer[] = {0x01, 0x03, 0x02, 0x12, 0x34};
+  len = make_frame(frame, fewer, sizeof(fewer));
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_ERR_INVALID_FUNCTION,
+                         modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 2, out));
+
+  // Odd byte count
+  const uint8_t odd[] = {0x01, 0x03, 0x03, 0x12, 0x34, 0x56};
+  len = make_frame(frame, odd, sizeof(odd));
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_ERR_INVALID_FUNCTION,
+                         modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 1, out));
+
+  // Byte count that disagrees with the frame length
+  const uint8_t longer[] = {0x01, 0x03, 0x02, 0x12, 0x34, 0x56, 0x78};
+  len = make_frame(frame, longer, sizeof(longer));
+  TEST_ASSERT_EQUAL_HEX8(MODBUS_ERR_INVALID_FUNCTION,
+                         modbus_decode_read_response(frame, len, 0x01, MODBUS_FC_READ_HOLDING_REGISTERS, 1, out));
+}
+
+/******************************************************************
+ *                                                                *
+ *                         Console Input                          *
+ *                                                                *
+ ******************************************************************/
+
+static void test_parse_hex_bytes() {
+  uint8_t out[8];
+  const uint8_t expected[] = {0x01, 0x03, 0x00, 0x27, 0x0A};
+  TEST_ASSERT_EQUAL(5, modbus_parse_hex_bytes(" 0x01 0X03\t00 27 a\r\n", out, sizeof(out)));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+  TEST_ASSERT_EQUAL(0, modbus_parse_hex_bytes("", out, sizeof(out)));
+  TEST_ASSERT_EQUAL(-1, modbus_parse_hex_bytes("01 0g", out, sizeof(out)));
+  TEST_ASSERT_EQUAL(-1, modbus_parse_hex_bytes("0123", out, sizeof(out)));
+  TEST_ASSERT_EQUAL(-1, modbus_parse_hex_bytes("01 02 03", out, 2));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc_check_value);
+  RUN_TEST(test_crc_matches_bitwise);
+  RUN_TEST(test_crc_append_and_check);
+  RUN_TEST(test_crc_short_frames);
+  RUN_TEST(test_encode_read_request);
+  RUN_TEST(test_encode_big_endian_fields);
+  RUN_TEST(test_decode_read_response);
+  RUN_TEST(test_response_length_partial);
+  RUN_TEST(test_decode_exception);
+  RUN_TEST(test_decode_exception_code_zero);
+  RUN_TEST(test_result_classification);
+  RUN_TEST(test_decode_bad_crc);
+  RUN_TEST(test_decode_short_frames);
+  RUN_TEST(test_decode_wrong_slave);
+  RUN_TEST(test_decode_mismatched_frames);
+  RUN_TEST(test_parse_hex_bytes);
+  return UNITY_END();
+}
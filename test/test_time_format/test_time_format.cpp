@@ -0,0 +1,142 @@
+// Host tests of the timestamp formatter: format_iso8601() against localtime_r() under the TZ
+// the time service sets, across the DST transitions and year boundaries.
+//
+//   pio test -e native
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "configuration.h"
+#include "utils.h"
+
+// The libc rendering of epoch in the current TZ, the reference format_iso8601() must reproduce
+static void reference_iso8601(time_t epoch, char* buffer, size_t size) {
+  struct tm local;
+  localtime_r(&epoch, &local);
+  size_t len = strftime(buffer, size, "%Y-%m-%dT%H:%M:%S", &local);
+  long offset = local.tm_gmtoff;
+  snprintf(buffer + len, size - len, "%c%02ld:%02ld", offset < 0 ? '-' : '+', labs(offset) / 3600,
+           labs(offset) / 60 % 60);
+}
+
+static void check_epoch(time_t epoch) {
+  char expected[TIME_ISO8601_SIZE + 8];
+  char actual[TIME_ISO8601_SIZE];
+  char label[48];
+  reference_iso8601(epoch, expected, sizeof(expected));
+  TEST_ASSERT_EQUAL(strlen(expected), format_iso8601(epoch, actual, sizeof(actual)));
+  snprintf(label, sizeof(label), "utcOffset %d, epoch %lld", systemConfig.utcOffset, (long long)epoch);
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(expected, actual, label);
+}
+
+// Every step seconds over [from, until), then backwards, so the cached window is both
+// extended forwards and replaced by an earlier one
+static void check_range(time_t from, time_t until, time_t step) {
+  for (time_t t = from; t < until; t += step) {
+    check_epoch(t);
+  }
+  for (time_t t = until - 1; t >= from; t -= step) {
+    check_epoch(t);
+  }
+}
+
+// Each second around every change of tm_isdst in [from, until)
+static void check_transitions(time_t from, time_t until) {
+  struct tm local;
+  localtime_r(&from, &local);
+  int dst = local.tm_isdst;
+  for (time_t t = from; t < until; t += 60) {
+    localtime_r(&t, &local);
+    if (local.tm_isdst != dst) {
+      dst = local.tm_isdst;
+      check_range(t - 3600 - 60, t + 3600 + 60, 1);
+    }
+  }
+}
+
+static time_t utc(int year, int month, int day, int hour) {
+  struct tm fields = {};
+  fields.tm_year = year - 1900;
+  fields.tm_mon = month - 1;
+  fields.tm_mday = day;
+  fields.tm_hour = hour;
+  return timegm(&fields);
+}
+
+static const int utcOffsets[] = {-5, -8, 2};
+
+void setUp() {}
+void tearDown() {}
+
+static void test_spring_forward() {
+  for (int utcOffset : utcOffsets) {
+    systemConfig.utcOffset = utcOffset;
+    time_format_set_zone(utcOffset);
+    for (int year = 2024; year <= 2026; year++) {
+      check_range(utc(year, 3, 1, 0), utc(year, 3, 20, 0), 900);
+      check_transitions(utc(year, 3, 1, 0), utc(year, 3, 20, 0));
+    }
+  }
+}
+
+static void test_fall_back() {
+  for (int utcOffset : utcOffsets) {
+    systemConfig.utcOffset = utcOffset;
+    time_format_set_zone(utcOffset);
+    for (int year = 2024; year <= 2026; year++) {
+      check_range(utc(year, 10, 25, 0), utc(year, 11, 12, 0), 900);
+      check_transitions(utc(year, 10, 25, 0), utc(year, 11, 12, 0));
+    }
+  }
+}
+
+// 2024-11-03 01:00 and 01:30 Eastern, in the repeated hour after the clocks go back
+static void test_fall_back_repeated_hour() {
+  systemConfig.utcOffset = -5;
+  time_format_set_zone(-5);
+  char actual[TIME_ISO8601_SIZE];
+  format_iso8601(1730611800, actual, sizeof(actual));
+  TEST_ASSERT_EQUAL_STRING("2024-11-03T01:30:00-04:00", actual);
+  format_iso8601(1730613600, actual, sizeof(actual));
+  TEST_ASSERT_EQUAL_STRING("2024-11-03T01:00:00-05:00", actual);
+  format_iso8601(1730615400, actual, sizeof(actual));
+  TEST_ASSERT_EQUAL_STRING("2024-11-03T01:30:00-05:00", actual);
+}
+
+static void test_year_boundaries() {
+  for (int utcOffset : utcOffsets) {
+    systemConfig.utcOffset = utcOffset;
+    time_format_set_zone(utcOffset);
+    for (int year = 2024; year <= 2027; year++) {
+      check_range(utc(year, 1, 1, 0) - 86400, utc(year, 1, 1, 0) + 86400, 60);
+    }
+  }
+}
+
+// A zone change must not keep formatting with the previous zone's cached window
+static void test_zone_change() {
+  systemConfig.utcOffset = -5;
+  time_format_set_zone(-5);
+  check_epoch(utc(2025, 7, 1, 12));
+  systemConfig.utcOffset = 2;
+  time_format_set_zone(2);
+  check_epoch(utc(2025, 7, 1, 12));
+}
+
+static void test_buffer_too_small() {
+  char buffer[TIME_ISO8601_SIZE - 1];
+  TEST_ASSERT_EQUAL(0, format_iso8601(utc(2025, 7, 1, 12), buffer, sizeof(buffer)));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_spring_forward);
+  RUN_TEST(test_fall_back);
+  RUN_TEST(test_fall_back_repeated_hour);
+  RUN_TEST(test_year_boundaries);
+  RUN_TEST(test_zone_change);
+  RUN_TEST(test_buffer_too_small);
+  return UNITY_END();
+}